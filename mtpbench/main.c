@@ -0,0 +1,517 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "../3rdparty/pstdint.h"
+#include "../plainmtp/utf8_wchar.c.h"
+#include "../plainmtp/device_stats.c.h"
+#include "../plainmtp/wpd_puid.c.h"
+#include "../plainmtp/object_queue.c.h"
+
+#define FORMAT_TEXT "text"
+#define FORMAT_JSON "json"
+
+/* The names are typical for the storages of phones and cameras, so they are mostly short and ASCII,
+  but the ones made by users are mixed with other scripts. All of them are encoded in UTF-8. */
+static const char* const filename_corpus[] = {
+  "IMG_20230102_123456.jpg",
+  "IMG_20230102_123501_HDR.jpg",
+  "VID_20230714_180233.mp4",
+  "PXL_20240301_091522817.NIGHT.jpg",
+  "DSC01234.JPG",
+  "DCIM",
+  "Camera",
+  "Screenshot_2023-11-05-22-14-09-871_com.android.chrome.jpg",
+  "WhatsApp Image 2024-02-11 at 14.33.07.jpeg",
+  "Android",
+  "com.google.android.apps.photos",
+  ".thumbnails",
+  "Download",
+  "Документы",
+  "Фото с дачи 2023.jpg",
+  "Договор аренды (подписанный).pdf",
+  "写真_2023年8月.jpg",
+  "会議の議事録.docx",
+  "새 폴더",
+  "Ελληνικά αρχεία.zip",
+  "résumé_final_v2.pdf",
+  "Café & Crème brûlée – recette.txt",
+  "party \xF0\x9F\x8E\x89\xF0\x9F\x8E\x82 2024.mp4",
+  "\xF0\x9F\x93\xB7 Holiday \xF0\x9F\x8C\xB4.heic",
+  "Music/Artist Name - Album Title (2019) [FLAC]/01 - Some Rather Long Track Title.flac",
+  "Podcasts/Episode 142 - Интервью с автором книги «Тишина».mp3"
+};
+
+#define CORPUS_SIZE (sizeof(filename_corpus) / sizeof(*filename_corpus))
+
+/* Roughly the number of objects in a camera folder of a phone, each of them gets an identifier. */
+#define OBJECT_COUNT 4096
+#define STORAGE_ID 0x00010001UL
+#define STORAGE_CAPACITY ((uint64_t)256 * 1000 * 1000 * 1000)
+#define VOLUME_STRING L"Internal shared storage"
+
+/* Every benchmark is sampled this many times, and the fastest and the median samples are reported.
+  The time is measured in microseconds, so a sample runs it repeatedly for at least this long. */
+#define SAMPLE_COUNT 9
+#define SAMPLE_TIME 20000
+
+/* Runs the benchmark once and returns the number of operations done, or 0 on failure. */
+typedef size_t (*benchmark_f)(void);
+
+typedef struct benchmark_s {
+  const char* name;
+  const char* unit;
+  benchmark_f run;
+} benchmark_s;
+
+/* The results are accumulated here, so the compiler can't throw away the work being measured. */
+static volatile unsigned long result_sink;
+
+/* The workloads are prepared once and shared by the benchmarks, which only read them. */
+static wchar_t* wide_corpus[CORPUS_SIZE];
+static wpd_guid_plain_i object_guids[OBJECT_COUNT];
+static wchar_t object_guid_strings[OBJECT_COUNT][WPD_GUID_STRING_SIZE];
+static wchar_t* storage_string;
+
+/* The byte-at-a-time decoder that was used before the validating one, kept here as a baseline. */
+static wchar_t* decode_utf8_baseline( const char* utf8_string, size_t* OUT_length ) {
+  const char* units;
+  wchar_t* result;
+  size_t length = 0, i;
+{
+  for (units = utf8_string; *units != '\0'; ++length) {
+    if ( (0xF8 & *units) == 0xF0 ) {
+      units += 4;
+    } else if ( (0xF0 & *units) == 0xE0 ) {
+      units += 3;
+    } else if ( (0xE0 & *units) == 0xC0 ) {
+      units += 2;
+    } else {
+      units += 1;
+    }
+  }
+
+  if (OUT_length != NULL) { *OUT_length = length; }
+
+  result = malloc( (length+1) * sizeof(*result) );
+  if (result == NULL) { return NULL; }
+
+  for (i = 0; i < length; ++i) {
+    units = utf8_string;
+
+    if ( (0xF8 & units[0]) == 0xF0 ) {
+      result[i] = (wchar_t)( (0x07 & units[0]) << 18 | (0x3F & units[1]) << 12
+        | (0x3F & units[2]) << 6 | (0x3F & units[3]) );
+      utf8_string += 4;
+    } else if ( (0xF0 & units[0]) == 0xE0 ) {
+      result[i] = (wchar_t)( (0x0F & units[0]) << 12 | (0x3F & units[1]) << 6
+        | (0x3F & units[2]) );
+      utf8_string += 3;
+    } else if ( (0xE0 & units[0]) == 0xC0 ) {
+      result[i] = (wchar_t)( (0x1F & units[0]) << 6 | (0x3F & units[1]) );
+      utf8_string += 2;
+    } else {
+      result[i] = (wchar_t)units[0];
+      utf8_string += 1;
+    }
+  }
+
+  result[length] = L'\0';
+  return result;
+}}
+
+/* The identifier codecs that were used before the table-driven ones, kept here as a baseline. */
+
+#define WPRINTF_MODIFIER_JOIN( Prefix, Literal ) Prefix ## Literal
+#define WPRINTF_MODIFIER_EXPAND( Literal ) WPRINTF_MODIFIER_JOIN( L, Literal )
+
+#define BASELINE_STORAGE_ID_PREFIX \
+  L"SID-{%" WPRINTF_MODIFIER_EXPAND( PRINTF_INT32_MODIFIER ) L"X,"
+#define BASELINE_GUID_FORMAT \
+  L"{%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X}"
+#define BASELINE_GUID_LIST \
+  X(0),X(1),X(2),X(3),  X(4),X(5),  X(6),X(7),  X(8),X(9),  X(10),X(11),X(12),X(13),X(14),X(15)
+
+static void write_guid_baseline( const wpd_guid_plain_i source, wchar_t* result ) {
+{
+# define X(i) (unsigned int)(source[i])
+  (void)swprintf( result, WPD_GUID_STRING_SIZE, BASELINE_GUID_FORMAT, BASELINE_GUID_LIST );
+# undef X
+}}
+
+static plainmtp_bool read_guid_baseline( wpd_guid_plain_i result, const wchar_t* source ) {
+  unsigned int values[16];
+  int filled;
+{
+# define X(i) &values[i]
+  filled = swscanf( source, BASELINE_GUID_FORMAT, BASELINE_GUID_LIST );
+# undef X
+  if (filled != 16) { return PLAINMTP_FALSE; }
+
+# define X(i) result[i] = (uint8_t)values[i]
+  (BASELINE_GUID_LIST);
+# undef X
+  return PLAINMTP_TRUE;
+}}
+
+static wchar_t* make_storage_id_baseline( uint32_t storage_id, uint64_t capacity,
+  const wchar_t* volume_string, size_t volume_string_length
+) {
+  size_t length_limit = 8 + 8 + 20 + 1;
+  wchar_t *buffer, *result;
+  int length;
+{
+  if (volume_string == NULL) {
+    volume_string = L"";
+  } else {
+    length_limit += (volume_string_length > 0) ? volume_string_length : 254;
+  }
+
+  buffer = malloc( length_limit * sizeof(*buffer) );
+  if (buffer == NULL) { return NULL; }
+
+  length = swprintf( buffer, length_limit,
+    BASELINE_STORAGE_ID_PREFIX L"%ls,%" WPRINTF_MODIFIER_EXPAND( PRINTF_INT64_MODIFIER ) L"u}",
+    storage_id, volume_string, capacity );
+
+  if (length > 0) {
+    result = realloc( buffer, (length+1) * sizeof(*buffer) );
+    return (result != NULL) ? result : buffer;
+  }
+
+  free( buffer );
+  return NULL;
+}}
+
+static plainmtp_bool parse_storage_id_baseline( const wchar_t* source,
+  uint32_t* OUT_storage_id
+) {
+{
+  return ( swscanf( source, BASELINE_STORAGE_ID_PREFIX, OUT_storage_id ) == 1 );
+}}
+
+/**************************************************************************************************/
+
+static size_t run_decoder( wchar_t* (*decoder)( const char* utf8_string, size_t* OUT_length ) ) {
+  wchar_t* result;
+  size_t length, round, i;
+{
+  for (round = 0; round < 20; ++round) {
+    for (i = 0; i < CORPUS_SIZE; ++i) {
+      result = decoder( filename_corpus[i], &length );
+      if (result == NULL) { return 0; }
+
+      result_sink += (unsigned long)length + (unsigned long)result[length / 2];
+      free( result );
+    }
+  }
+
+  return round * CORPUS_SIZE;
+}}
+
+static size_t bench_utf8_decode(void) {
+  return run_decoder( &PLAINMTP(make_wide_string_from_utf8) );
+}
+
+static size_t bench_utf8_decode_baseline(void) {
+  return run_decoder( &decode_utf8_baseline );
+}
+
+static size_t bench_utf8_encode(void) {
+  char* result;
+  size_t round, i;
+{
+  for (round = 0; round < 20; ++round) {
+    for (i = 0; i < CORPUS_SIZE; ++i) {
+      result = PLAINMTP(make_utf8_string( wide_corpus[i] ));
+      if (result == NULL) { return 0; }
+
+      result_sink += (unsigned char)result[0];
+      free( result );
+    }
+  }
+
+  return round * CORPUS_SIZE;
+}}
+
+static size_t bench_wpd_fallback_id(void) {
+  uint16_t name_units[8];
+  wpd_guid_plain_i guid;
+  size_t i;
+{
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    PLAINMTP(fold_wpd_object_name( name_units, wide_corpus[i % CORPUS_SIZE] ));
+    PLAINMTP(get_wpd_fallback_object_id( guid, name_units, (uint32_t)i + 1, 0, STORAGE_ID,
+      (uint32_t)(i * 7919) ));
+    result_sink += guid[i % sizeof(guid)];
+  }
+
+  return i;
+}}
+
+static size_t run_guid_writer( void (*writer)( const wpd_guid_plain_i source, wchar_t* result ) ) {
+  wchar_t result[WPD_GUID_STRING_SIZE];
+  size_t i;
+{
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    writer( object_guids[i], result );
+    result_sink += (unsigned long)result[i % (WPD_GUID_STRING_SIZE - 1)];
+  }
+
+  return i;
+}}
+
+static size_t bench_wpd_guid_write(void) {
+  return run_guid_writer( &PLAINMTP(write_wpd_plain_guid) );
+}
+
+static size_t bench_wpd_guid_write_baseline(void) {
+  return run_guid_writer( &write_guid_baseline );
+}
+
+static size_t run_guid_reader(
+  plainmtp_bool (*reader)( wpd_guid_plain_i result, const wchar_t* source )
+) {
+  wpd_guid_plain_i result;
+  size_t i;
+{
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    if (!reader( result, object_guid_strings[i] )) { return 0; }
+    result_sink += result[i % sizeof(result)];
+  }
+
+  return i;
+}}
+
+static size_t bench_wpd_guid_read(void) {
+  return run_guid_reader( &PLAINMTP(read_wpd_plain_guid) );
+}
+
+static size_t bench_wpd_guid_read_baseline(void) {
+  return run_guid_reader( &read_guid_baseline );
+}
+
+static size_t run_storage_id_maker( wchar_t* (*maker)( uint32_t storage_id, uint64_t capacity,
+  const wchar_t* volume_string, size_t volume_string_length )
+) {
+  wchar_t* result;
+  size_t i;
+{
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    result = maker( STORAGE_ID + (uint32_t)i, STORAGE_CAPACITY, VOLUME_STRING,
+      sizeof(VOLUME_STRING) / sizeof(wchar_t) - 1 );
+    if (result == NULL) { return 0; }
+
+    result_sink += (unsigned long)result[wcslen( result ) - 2];
+    free( result );
+  }
+
+  return i;
+}}
+
+static size_t bench_wpd_storage_id_make(void) {
+  return run_storage_id_maker( &PLAINMTP(make_wpd_storage_unique_id) );
+}
+
+static size_t bench_wpd_storage_id_make_baseline(void) {
+  return run_storage_id_maker( &make_storage_id_baseline );
+}
+
+static size_t run_storage_id_parser(
+  plainmtp_bool (*parser)( const wchar_t* source, uint32_t* OUT_storage_id )
+) {
+  uint32_t storage_id;
+  size_t i;
+{
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    if (!parser( storage_string, &storage_id )) { return 0; }
+    result_sink += storage_id;
+  }
+
+  return i;
+}}
+
+static size_t bench_wpd_storage_id_parse(void) {
+  return run_storage_id_parser( &PLAINMTP(parse_wpd_storage_unique_id) );
+}
+
+static size_t bench_wpd_storage_id_parse_baseline(void) {
+  return run_storage_id_parser( &parse_storage_id_baseline );
+}
+
+/* This walks a tree of folders breadth-first, the way the object lookup does it on the device:
+  every popped folder pushes its 8 subfolders until there are enough of them. An operation is
+  either a push or a pop. */
+static size_t bench_object_queue(void) {
+  object_queue_s *queue, *data;
+  object_queue_item_s item;
+  size_t pushed = 1, popped = 0, i;
+{
+  queue = PLAINMTP(object_queue_create(0));
+  if (queue == NULL) { return 0; }
+
+  data = PLAINMTP(object_queue_push( queue, STORAGE_ID, 0 ));
+  if (data == NULL) { goto failed; }
+  queue = data;
+
+  while (PLAINMTP(object_queue_pop( queue, &item ))) {
+    ++popped;
+    result_sink += item.object_handle;
+
+    for (i = 0; (i < 8) && (pushed < OBJECT_COUNT * 4); ++i) {
+      data = PLAINMTP(object_queue_push( queue, item.storage_id, (uint32_t)pushed++ ));
+      if (data == NULL) { goto failed; }
+      queue = data;
+    }
+  }
+
+  free( queue );
+  return pushed + popped;
+
+failed:
+  free( queue );
+  return 0;
+}}
+
+static const benchmark_s benchmarks[] = {
+  { "utf8.decode", "name", &bench_utf8_decode },
+  { "utf8.decode.baseline", "name", &bench_utf8_decode_baseline },
+  { "utf8.encode", "name", &bench_utf8_encode },
+  { "wpd.fallback_id", "id", &bench_wpd_fallback_id },
+  { "wpd.guid.write", "id", &bench_wpd_guid_write },
+  { "wpd.guid.write.baseline", "id", &bench_wpd_guid_write_baseline },
+  { "wpd.guid.read", "id", &bench_wpd_guid_read },
+  { "wpd.guid.read.baseline", "id", &bench_wpd_guid_read_baseline },
+  { "wpd.storage_id.make", "id", &bench_wpd_storage_id_make },
+  { "wpd.storage_id.make.baseline", "id", &bench_wpd_storage_id_make_baseline },
+  { "wpd.storage_id.parse", "id", &bench_wpd_storage_id_parse },
+  { "wpd.storage_id.parse.baseline", "id", &bench_wpd_storage_id_parse_baseline },
+  { "object_queue.push_pop", "item", &bench_object_queue }
+};
+
+#define BENCHMARK_COUNT (sizeof(benchmarks) / sizeof(*benchmarks))
+
+/**************************************************************************************************/
+
+static plainmtp_bool prepare_workloads(void) {
+  uint16_t name_units[8];
+  size_t i;
+{
+  for (i = 0; i < CORPUS_SIZE; ++i) {
+    wide_corpus[i] = PLAINMTP(make_wide_string_from_utf8( filename_corpus[i], NULL ));
+    if (wide_corpus[i] == NULL) { return PLAINMTP_FALSE; }
+  }
+
+  /* These are the identifiers that WPD would make up for the objects named like in the corpus. */
+  for (i = 0; i < OBJECT_COUNT; ++i) {
+    PLAINMTP(fold_wpd_object_name( name_units, wide_corpus[i % CORPUS_SIZE] ));
+    PLAINMTP(get_wpd_fallback_object_id( object_guids[i], name_units, (uint32_t)i + 1, 0,
+      STORAGE_ID, (uint32_t)(i * 7919) ));
+    PLAINMTP(write_wpd_plain_guid( object_guids[i], object_guid_strings[i] ));
+  }
+
+  storage_string = PLAINMTP(make_wpd_storage_unique_id( STORAGE_ID, STORAGE_CAPACITY, NULL, 0 ));
+  return (storage_string != NULL);
+}}
+
+static void release_workloads(void) {
+  size_t i;
+{
+  for (i = 0; i < CORPUS_SIZE; ++i) { free( wide_corpus[i] ); }
+  free( storage_string );
+}}
+
+static int compare_times( const void* left, const void* right ) {
+  const double left_time = *(const double*)left, right_time = *(const double*)right;
+{
+  return (left_time < right_time) ? -1 : (left_time > right_time);
+}}
+
+/* The results are in nanoseconds per operation. */
+static plainmtp_bool measure_benchmark( const benchmark_s* benchmark, double* OUT_fastest_time,
+  double* OUT_median_time
+) {
+  double times[SAMPLE_COUNT];
+  uint64_t start_time, elapsed_time;
+  size_t operations, count, i;
+{
+  for (i = 0; i < SAMPLE_COUNT; ++i) {
+    operations = 0;
+    start_time = PLAINMTP(get_monotonic_time());
+
+    do {
+      count = benchmark->run();
+      if (count == 0) { return PLAINMTP_FALSE; }
+
+      operations += count;
+      elapsed_time = PLAINMTP(get_monotonic_time()) - start_time;
+    } while (elapsed_time < SAMPLE_TIME);
+
+    times[i] = (double)elapsed_time * 1000.0 / operations;
+  }
+
+  qsort( times, SAMPLE_COUNT, sizeof(*times), &compare_times );
+
+  *OUT_fastest_time = times[0];
+  *OUT_median_time = times[SAMPLE_COUNT / 2];
+
+  return PLAINMTP_TRUE;
+}}
+
+/* usage: mtpbench {FORMAT {NAME_PREFIX}}
+  FORMAT is either "text" (the default) or "json", which is meant for tracking the results. Only
+  the benchmarks with the names that start with NAME_PREFIX are run, if it's given. */
+int main( int argc, char* argv[] ) {
+  const char* const format = (argc > 1) ? argv[1] : FORMAT_TEXT;
+  const char* const prefix = (argc > 2) ? argv[2] : "";
+  const plainmtp_bool is_json = (strcmp( format, FORMAT_JSON ) == 0);
+  double fastest_time, median_time;
+  size_t i;
+  int exit_code = EXIT_FAILURE;
+  const char* separator = "";
+{
+  if ( !is_json && (strcmp( format, FORMAT_TEXT ) != 0) ) {
+    fputs( "usage: mtpbench {text|json {NAME_PREFIX}}\n", stderr );
+    return EXIT_FAILURE;
+  }
+
+  if (!prepare_workloads()) {
+    fputs( "failed to prepare the workloads\n", stderr );
+    goto cleanup;
+  }
+
+  if (is_json) {
+    printf( "{\"samples\": %d, \"benchmarks\": [", SAMPLE_COUNT );
+  } else {
+    printf( "%-32s %12s %12s\n", "benchmark", "fastest", "median" );
+  }
+
+  for (i = 0; i < BENCHMARK_COUNT; ++i) {
+    if (strncmp( benchmarks[i].name, prefix, strlen( prefix ) ) != 0) { continue; }
+
+    if (!measure_benchmark( &benchmarks[i], &fastest_time, &median_time )) {
+      fprintf( stderr, "benchmark %s has failed\n", benchmarks[i].name );
+      goto cleanup;
+    }
+
+    if (is_json) {
+      printf( "%s\n  {\"name\": \"%s\", \"unit\": \"%s\", \"fastest_ns\": %.2f, "
+        "\"median_ns\": %.2f}", separator, benchmarks[i].name, benchmarks[i].unit,
+        fastest_time, median_time );
+      separator = ",";
+    } else {
+      printf( "%-32s %9.1f ns %9.1f ns  per %s\n", benchmarks[i].name, fastest_time,
+        median_time, benchmarks[i].unit );
+    }
+
+    fflush( stdout );
+  }
+
+  if (is_json) { puts( "\n]}" ); }
+  exit_code = EXIT_SUCCESS;
+
+cleanup:
+  release_workloads();
+  return exit_code;
+}}
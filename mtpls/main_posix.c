@@ -12,10 +12,10 @@ FILE* _wfopen( const wchar_t* filename, const wchar_t* mode ) {
   FILE* result = NULL;
   char *mbs_filename, *mbs_mode;
 {
-  mbs_filename = PLAINMTP(make_multibyte_string( filename ));
+  mbs_filename = PLAINMTP(make_utf8_string( filename ));
   if (mbs_filename == NULL) { return NULL; }
 
-  mbs_mode = PLAINMTP(make_multibyte_string( mode ));
+  mbs_mode = PLAINMTP(make_utf8_string( mode ));
   if (mbs_mode != NULL) {
     result = fopen( mbs_filename, mbs_mode );
     free( mbs_mode );
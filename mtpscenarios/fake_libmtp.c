@@ -0,0 +1,515 @@
+/* This is an in-memory replacement for the part of libmtp that plainmtp uses, so the scenarios are
+  run through the libmtp implementation of plainmtp without any hardware. It is linked instead of
+  libmtp itself, and emulates a single device. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libmtp.h>
+
+#include "fake_libmtp.c.h"
+
+/* The data is exchanged by chunks of this size, like libmtp does it by USB transfers. */
+#define CHUNK_SIZE (1024 * 1024)
+
+typedef struct fake_object_s {
+  uint32_t parent;
+  uint32_t first_child;
+  uint32_t last_child;
+  uint32_t next_sibling;
+  char* name;
+  uint64_t size;
+  plainmtp_bool is_folder;
+} fake_object_s;
+
+/* The handle of an object is its index, and the one with the handle 0 is the pseudo-folder that
+  holds the top-level objects of the storage, the same way as PTP does it. */
+static fake_object_s* objects = NULL;
+static uint32_t object_count = 0, object_capacity = 0;
+
+static unsigned char* chunk_data = NULL;
+static fake_counters_s counters;
+static plainmtp_bool has_partial64 = PLAINMTP_FALSE;
+
+static char* copy_string( const char* source ) {
+  char* result;
+{
+  result = malloc( strlen( source ) + 1 );
+  return (result != NULL) ? strcpy( result, source ) : NULL;
+}}
+
+static uint32_t add_object( uint32_t parent, const char* name, uint64_t size,
+  plainmtp_bool is_folder
+) {
+  fake_object_s *object, *data;
+  uint32_t capacity;
+{
+  if (object_count == object_capacity) {
+    capacity = (object_capacity > 0) ? object_capacity * 2 : 1024;
+    data = realloc( objects, capacity * sizeof(*objects) );
+    if (data == NULL) { return 0; }
+
+    objects = data;
+    object_capacity = capacity;
+  }
+
+  object = &objects[object_count];
+  object->name = copy_string( name );
+  if (object->name == NULL) { return 0; }
+
+  object->parent = parent;
+  object->first_child = 0;
+  object->last_child = 0;
+  object->next_sibling = 0;
+  object->size = size;
+  object->is_folder = is_folder;
+
+  /* The root pseudo-folder is its own parent. */
+  if (object_count != parent) {
+    if (objects[parent].last_child == 0) {
+      objects[parent].first_child = object_count;
+    } else {
+      objects[objects[parent].last_child].next_sibling = object_count;
+    }
+
+    objects[parent].last_child = object_count;
+  }
+
+  return object_count++;
+}}
+
+static plainmtp_bool add_numbered_objects( uint32_t parent, const char* format, unsigned long count,
+  uint64_t size
+) {
+  char name[64];
+  unsigned long i;
+{
+  for (i = 0; i < count; ++i) {
+    sprintf( name, format, i );
+    if (add_object( parent, name, size, PLAINMTP_FALSE ) == 0) { return PLAINMTP_FALSE; }
+  }
+
+  return PLAINMTP_TRUE;
+}}
+
+static uint32_t add_folder( uint32_t parent, const char* name ) {
+  return add_object( parent, name, 0, PLAINMTP_TRUE );
+}
+
+static plainmtp_bool is_object( uint32_t handle ) {
+  return (handle != 0) && (handle < object_count);
+}
+
+static LIBMTP_file_t* make_file( uint32_t handle ) {
+  LIBMTP_file_t* result;
+{
+  result = calloc( 1, sizeof(*result) );
+  if (result == NULL) { return NULL; }
+
+  result->filename = copy_string( objects[handle].name );
+  if (result->filename == NULL) {
+    free( result );
+    return NULL;
+  }
+
+  result->item_id = handle;
+  result->parent_id = objects[handle].parent;
+  result->storage_id = FAKE_STORAGE_ID;
+  result->filesize = objects[handle].size;
+  result->modificationdate = 1700000000;
+  result->filetype = objects[handle].is_folder ? LIBMTP_FILETYPE_FOLDER : LIBMTP_FILETYPE_UNKNOWN;
+
+  return result;
+}}
+
+/**************************************************************************************************/
+
+plainmtp_bool fake_device_create(void) {
+  uint32_t folder, level;
+  char name[16];
+  unsigned long i;
+{
+  chunk_data = malloc( CHUNK_SIZE );
+  if (chunk_data == NULL) { return PLAINMTP_FALSE; }
+
+  for (i = 0; i < CHUNK_SIZE; ++i) { chunk_data[i] = (unsigned char)(i * 31 + 7); }
+
+  if (add_folder( 0, "" ) != 0) { goto failed; }
+
+  folder = add_folder( add_folder( 0, "DCIM" ), "Camera" );
+  if ( (folder == 0)
+    || !add_numbered_objects( folder, "IMG_20240101_%06lu.jpg", FAKE_CAMERA_COUNT, 3500000 )
+  ) {
+    goto failed;
+  }
+
+  folder = add_folder( 0, "Download" );
+  if ( (folder == 0)
+    || !add_numbered_objects( folder, "document_%05lu.pdf", FAKE_DOWNLOAD_COUNT,
+      FAKE_DOWNLOAD_SIZE )
+  ) {
+    goto failed;
+  }
+
+  level = add_folder( 0, "Documents" );
+  for (i = 0; (level != 0) && (i < FAKE_DEEP_DEPTH); ++i) {
+    if (!add_numbered_objects( level, "note_%02lu.txt", FAKE_DEEP_SIBLINGS, 1024 )) {
+      goto failed;
+    }
+
+    sprintf( name, "level_%02lu", i );
+    level = add_folder( level, name );
+  }
+
+  if ( (level == 0)
+    || !add_numbered_objects( level, "note_%02lu.txt", FAKE_DEEP_SIBLINGS, 1024 )
+  ) {
+    goto failed;
+  }
+
+  folder = add_folder( 0, "Movies" );
+  if ( (folder == 0)
+    || (add_object( folder, "holiday.mp4", FAKE_MOVIE_SIZE, PLAINMTP_FALSE ) == 0)
+  ) {
+    goto failed;
+  }
+
+  folder = add_folder( 0, "Upload" );
+  if ( (folder == 0) || !add_numbered_objects( folder, "album_%02lu", FAKE_ALBUM_COUNT, 0 ) ) {
+    goto failed;
+  }
+
+  /* The albums were added as files to reuse the numbering. */
+  for (i = objects[folder].first_child; i != 0; i = objects[i].next_sibling) {
+    objects[i].is_folder = PLAINMTP_TRUE;
+  }
+
+  has_partial64 = PLAINMTP_FALSE;
+  fake_device_reset_counters();
+  return PLAINMTP_TRUE;
+
+failed:
+  fake_device_destroy();
+  return PLAINMTP_FALSE;
+}}
+
+void fake_device_destroy(void) {
+  uint32_t i;
+{
+  for (i = 0; i < object_count; ++i) { free( objects[i].name ); }
+  free( objects );
+  free( chunk_data );
+
+  objects = NULL;
+  object_count = object_capacity = 0;
+  chunk_data = NULL;
+}}
+
+void fake_device_get_counters( fake_counters_s* OUT_counters ) {
+{
+  *OUT_counters = counters;
+}}
+
+void fake_device_reset_counters(void) {
+{
+  counters.transactions = 0;
+  counters.bytes_received = 0;
+  counters.bytes_transferred = 0;
+}}
+
+void fake_device_set_partial64( plainmtp_bool is_supported ) {
+{
+  has_partial64 = is_supported;
+}}
+
+/**************************************************************************************************/
+
+void LIBMTP_Init(void) {}
+
+void LIBMTP_FreeMemory( void* memory ) {
+{
+  free( memory );
+}}
+
+LIBMTP_error_number_t LIBMTP_Detect_Raw_Devices( LIBMTP_raw_device_t** devices,
+  int* numdevs
+) {
+{
+  *devices = calloc( 1, sizeof(**devices) );
+  if (*devices == NULL) { return LIBMTP_ERROR_MEMORY_ALLOCATION; }
+
+  (*devices)->device_entry.vendor = "Fake";
+  (*devices)->device_entry.vendor_id = 0x18D1;
+  (*devices)->device_entry.product = "Emulated MTP device";
+  (*devices)->device_entry.product_id = 0x4EE1;
+  (*devices)->bus_location = 1;
+  (*devices)->devnum = 2;
+
+  *numdevs = 1;
+  return LIBMTP_ERROR_NONE;
+}}
+
+/* Opening a session takes OpenSession and GetDeviceInfo, and libmtp also queries the storages, so
+  they're already filled when the device is returned. */
+LIBMTP_mtpdevice_t* LIBMTP_Open_Raw_Device_Uncached( LIBMTP_raw_device_t* rawdevice ) {
+  LIBMTP_mtpdevice_t* device;
+{
+  device = calloc( 1, sizeof(*device) );
+  if (device == NULL) { return NULL; }
+
+  counters.transactions += 2;
+
+  if (LIBMTP_Get_Storage( device, LIBMTP_STORAGE_SORTBY_NOTSORTED ) != 0) {
+    free( device );
+    return NULL;
+  }
+
+  return device;
+  (void)rawdevice;
+}}
+
+LIBMTP_mtpdevice_t* LIBMTP_Open_Raw_Device( LIBMTP_raw_device_t* rawdevice ) {
+  return LIBMTP_Open_Raw_Device_Uncached( rawdevice );
+}
+
+static void free_storage( LIBMTP_mtpdevice_t* device ) {
+{
+  if (device->storage == NULL) { return; }
+
+  free( device->storage->StorageDescription );
+  free( device->storage->VolumeIdentifier );
+  free( device->storage );
+  device->storage = NULL;
+}}
+
+void LIBMTP_Release_Device( LIBMTP_mtpdevice_t* device ) {
+{
+  ++counters.transactions;
+  free_storage( device );
+  free( device );
+}}
+
+/* The strings are from the device information, except the friendly name, which is a property. */
+char* LIBMTP_Get_Friendlyname( LIBMTP_mtpdevice_t* device ) {
+{
+  ++counters.transactions;
+  return copy_string( "Fake Phone" );
+  (void)device;
+}}
+
+char* LIBMTP_Get_Modelname( LIBMTP_mtpdevice_t* device ) {
+{
+  return copy_string( "Emulated MTP device" );
+  (void)device;
+}}
+
+char* LIBMTP_Get_Manufacturername( LIBMTP_mtpdevice_t* device ) {
+{
+  return copy_string( "plainmtp" );
+  (void)device;
+}}
+
+char* LIBMTP_Get_Serialnumber( LIBMTP_mtpdevice_t* device ) {
+{
+  return copy_string( "0123456789ABCDEF" );
+  (void)device;
+}}
+
+char* LIBMTP_Get_Deviceversion( LIBMTP_mtpdevice_t* device ) {
+{
+  return copy_string( "1.0" );
+  (void)device;
+}}
+
+int LIBMTP_Check_Capability( LIBMTP_mtpdevice_t* device, LIBMTP_devicecap_t cap ) {
+{
+  return (cap == LIBMTP_DEVICECAP_GetPartialObject);
+  (void)device;
+}}
+
+void LIBMTP_Clear_Errorstack( LIBMTP_mtpdevice_t* device ) {
+{
+  (void)device;
+}}
+
+LIBMTP_error_t* LIBMTP_Get_Errorstack( LIBMTP_mtpdevice_t* device ) {
+{
+  return NULL;
+  (void)device;
+}}
+
+/* GetStorageIDs, then GetStorageInfo for the only storage. */
+int LIBMTP_Get_Storage( LIBMTP_mtpdevice_t* device, int const sortby ) {
+  LIBMTP_devicestorage_t* storage;
+{
+  counters.transactions += 2;
+  free_storage( device );
+
+  storage = calloc( 1, sizeof(*storage) );
+  if (storage == NULL) { return -1; }
+
+  storage->id = FAKE_STORAGE_ID;
+  storage->StorageType = 0x0003;  /* Fixed RAM. */
+  storage->FilesystemType = 0x0002;  /* Generic hierarchical. */
+  storage->MaxCapacity = (uint64_t)128 << 30;
+  storage->FreeSpaceInBytes = (uint64_t)37 << 30;
+  storage->FreeSpaceInObjects = 0xFFFFFFFFUL;
+  storage->StorageDescription = copy_string( FAKE_STORAGE_NAME );
+
+  device->storage = storage;
+  return 0;
+  (void)sortby;
+}}
+
+void LIBMTP_destroy_file_t( LIBMTP_file_t* file ) {
+{
+  if (file == NULL) { return; }
+
+  free( file->filename );
+  free( file );
+}}
+
+/* GetObjectInfo for the object. */
+LIBMTP_file_t* LIBMTP_Get_Filemetadata( LIBMTP_mtpdevice_t* device, uint32_t const fileid ) {
+{
+  ++counters.transactions;
+  return is_object( fileid ) ? make_file( fileid ) : NULL;
+  (void)device;
+}}
+
+/* GetObjectHandles, then GetObjectInfo for every child, since libmtp gets all of them in the
+  uncached mode. */
+LIBMTP_file_t* LIBMTP_Get_Files_And_Folders( LIBMTP_mtpdevice_t* device, uint32_t const storage,
+  uint32_t const parent
+) {
+  LIBMTP_file_t *result = NULL, *file;
+  LIBMTP_file_t** link = &result;
+  uint32_t folder, i;
+{
+  ++counters.transactions;
+
+  folder = (parent == LIBMTP_FILES_AND_FOLDERS_ROOT) ? 0 : parent;
+  if ( ( (storage != 0) && (storage != FAKE_STORAGE_ID) )
+    || ( (folder != 0) && (!is_object( folder ) || !objects[folder].is_folder) )
+  ) {
+    return NULL;
+  }
+
+  for (i = objects[folder].first_child; i != 0; i = objects[i].next_sibling) {
+    ++counters.transactions;
+
+    file = make_file( i );
+    if (file == NULL) { break; }
+
+    *link = file;
+    link = &file->next;
+  }
+
+  return result;
+  (void)device;
+}}
+
+/* GetObject, which has a single data phase. */
+int LIBMTP_Get_File_To_Handler( LIBMTP_mtpdevice_t* device, uint32_t const id,
+  MTPDataPutFunc put_func, void* priv, LIBMTP_progressfunc_t const callback,
+  void const* const data
+) {
+  uint64_t left;
+  uint32_t size, processed;
+{
+  ++counters.transactions;
+  if ( !is_object( id ) || objects[id].is_folder ) { return -1; }
+
+  for (left = objects[id].size; left > 0; left -= size) {
+    size = (left < CHUNK_SIZE) ? (uint32_t)left : CHUNK_SIZE;
+
+    if (put_func( NULL, priv, size, chunk_data, &processed ) != LIBMTP_HANDLER_RETURN_OK) {
+      return -1;
+    }
+
+    counters.bytes_received += size;
+  }
+
+  return 0;
+  (void)device; (void)callback; (void)data;
+}}
+
+/* GetPartialObject64 if the device supports it, GetPartialObject otherwise. In the latter case,
+  libmtp refuses the offsets that don't fit in 32 bits without making any transaction. */
+int LIBMTP_GetPartialObject( LIBMTP_mtpdevice_t* device, uint32_t const id,
+  uint64_t offset, uint32_t maxbytes, unsigned char** data, unsigned int* size
+) {
+  uint64_t left;
+  uint32_t i, position, part;
+{
+  if ( !has_partial64 && (offset > 0xFFFFFFFFUL) ) { return -1; }
+
+  ++counters.transactions;
+  if ( !is_object( id ) || objects[id].is_folder || (offset > objects[id].size) ) { return -1; }
+
+  left = objects[id].size - offset;
+  *size = (left < maxbytes) ? (unsigned int)left : maxbytes;
+
+  *data = malloc( (*size > 0) ? *size : 1 );
+  if (*data == NULL) { return -1; }
+
+  /* The data repeats with the period of a chunk, so it's copied by the runs within one. */
+  for (i = 0; i < *size; i += part) {
+    position = (uint32_t)( (offset + i) % CHUNK_SIZE );
+    part = CHUNK_SIZE - position;
+    if (part > *size - i) { part = *size - i; }
+
+    memcpy( *data + i, chunk_data + position, part );
+  }
+
+  counters.bytes_received += *size;
+  return 0;
+  (void)device;
+}}
+
+int LIBMTP_Get_Thumbnail( LIBMTP_mtpdevice_t* device, uint32_t const id, unsigned char** data,
+  unsigned int* size
+) {
+{
+  /* None of the objects has a thumbnail. */
+  ++counters.transactions;
+  return -1;
+  (void)device; (void)id; (void)data; (void)size;
+}}
+
+/* SendObjectInfo, then SendObject, which has a single data phase. */
+int LIBMTP_Send_File_From_Handler( LIBMTP_mtpdevice_t* device, MTPDataGetFunc get_func,
+  void* priv, LIBMTP_file_t* const filedata, LIBMTP_progressfunc_t const callback,
+  void const* const data
+) {
+  uint64_t left;
+  uint32_t size, folder, handle, processed;
+{
+  counters.transactions += 2;
+
+  folder = (filedata->parent_id == LIBMTP_FILES_AND_FOLDERS_ROOT) ? 0 : filedata->parent_id;
+  if ( (folder != 0) && (!is_object( folder ) || !objects[folder].is_folder) ) { return -1; }
+
+  for (left = filedata->filesize; left > 0; left -= size) {
+    size = (left < CHUNK_SIZE) ? (uint32_t)left : CHUNK_SIZE;
+
+    if ( (get_func( NULL, priv, size, chunk_data, &processed ) != LIBMTP_HANDLER_RETURN_OK)
+      || (processed != size)
+    ) {
+      return -1;
+    }
+
+    counters.bytes_transferred += size;
+  }
+
+  handle = add_object( folder, filedata->filename, filedata->filesize, PLAINMTP_FALSE );
+  if (handle == 0) { return -1; }
+
+  filedata->item_id = handle;
+  filedata->parent_id = folder;
+  filedata->storage_id = FAKE_STORAGE_ID;
+
+  return 0;
+  (void)device; (void)callback; (void)data;
+}}
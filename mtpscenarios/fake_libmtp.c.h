@@ -0,0 +1,48 @@
+#ifndef ZZ_MTPSCENARIOS_FAKE_LIBMTP_C_IG
+#define ZZ_MTPSCENARIOS_FAKE_LIBMTP_C_IG
+
+#include "../plainmtp/plainmtp.h"
+
+/* The emulated device has a single storage with the following layout, where the counts and sizes
+  are the ones of a typical phone that has been in use for a few years:
+
+    Internal shared storage
+      DCIM\Camera\          - FAKE_CAMERA_COUNT photos (never received, so they have no data)
+      Download\             - FAKE_DOWNLOAD_COUNT small files of FAKE_DOWNLOAD_SIZE bytes
+      Documents\level_00\level_01\...\level_NN\   - FAKE_DEEP_DEPTH levels, each of which also
+                                                    has FAKE_DEEP_SIBLINGS files
+      Movies\holiday.mp4    - a single file of FAKE_MOVIE_SIZE bytes, which reaches past 4 GiB
+      Upload\album_NN\      - FAKE_ALBUM_COUNT empty folders */
+
+#define FAKE_STORAGE_ID 0x00010001UL
+#define FAKE_STORAGE_NAME "Internal shared storage"
+
+#define FAKE_CAMERA_COUNT 100000
+#define FAKE_DOWNLOAD_COUNT 10000
+#define FAKE_DOWNLOAD_SIZE 16384
+#define FAKE_DEEP_DEPTH 12
+#define FAKE_DEEP_SIBLINGS 31
+#define FAKE_MOVIE_SIZE ((uint64_t)5 << 30)
+#define FAKE_ALBUM_COUNT 16
+
+/* The operations of libmtp are counted as the PTP transactions they make with a real device in the
+  uncached mode, and the data phases are counted in bytes. */
+typedef struct fake_counters_s {
+  unsigned long transactions;
+  uint64_t bytes_received;
+  uint64_t bytes_transferred;
+} fake_counters_s;
+
+extern plainmtp_bool fake_device_create(void);
+extern void fake_device_destroy(void);
+
+extern void fake_device_get_counters( fake_counters_s* OUT_counters );
+extern void fake_device_reset_counters(void);
+
+/* The device supports GetPartialObject with 32-bit offsets only, unless GetPartialObject64 is
+  enabled with this. Either way, the capability is reported as GetPartialObject, as libmtp does. */
+extern void fake_device_set_partial64( plainmtp_bool is_supported );
+
+#else
+#error ZZ_MTPSCENARIOS_FAKE_LIBMTP_C_IG
+#endif
@@ -0,0 +1,503 @@
+/* NB: Every scenario is run in a child process made with fork(), so the peak memory usage that is
+  taken with getrusage() is its own. These are POSIX extensions to the standard C library. */
+#define _XOPEN_SOURCE 500
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../3rdparty/pstdint.h"
+#include "../plainmtp/plainmtp.h"
+#include "../plainmtp/device_stats.c.h"
+#include "fake_libmtp.c.h"
+
+#define FORMAT_TEXT "text"
+#define FORMAT_JSON "json"
+
+/* The latency model of the device: every transaction takes this many microseconds to go back and
+  forth, and the data is exchanged at this rate. These are typical for USB 2.0 phones. */
+#define DEFAULT_LATENCY 1000
+#define DEFAULT_BANDWIDTH 30
+
+#define PATH_DELIMITER (L'\\')
+#define STORAGE_PATH L"Internal shared storage"
+
+#define SWITCH_COUNT 1000
+#define PATH_COUNT 1000
+
+/* The uploaded tree has this many files in each of the FAKE_ALBUM_COUNT folders. */
+#define UPLOAD_FILE_COUNT 64
+#define UPLOAD_FILE_SIZE 262144
+
+/* The data is received and transferred by chunks of this size. */
+#define EXCHANGE_SIZE (1024 * 1024)
+
+/* Runs the scenario on the started device and returns the number of operations done, or 0 on
+  failure. The measurement starts with begin_measurement(), so the preparations are not counted. */
+typedef unsigned long (*scenario_f)
+  ( struct plainmtp_device_s* device, struct plainmtp_cursor_s* root );
+
+typedef struct scenario_s {
+  const char* name;
+  const char* unit;
+  scenario_f run;
+} scenario_s;
+
+/* This is passed from the child process that has run the scenario, so it must be plain data. The
+  times are in microseconds, and the memory usage is in kibibytes. */
+typedef struct outcome_s {
+  unsigned long operations;
+  uint64_t wall_time;
+  uint64_t user_time;
+  uint64_t system_time;
+  long setup_rss;
+  long peak_rss;
+  fake_counters_s counters;
+} outcome_s;
+
+static uint64_t start_time;
+static struct rusage start_usage;
+static long setup_rss;
+
+static unsigned char exchange_buffer[EXCHANGE_SIZE];
+
+static void begin_measurement(void) {
+{
+  (void)getrusage( RUSAGE_SELF, &start_usage );
+  setup_rss = start_usage.ru_maxrss;
+
+  fake_device_reset_counters();
+  start_time = PLAINMTP(get_monotonic_time());
+}}
+
+static uint64_t get_elapsed_time( const struct timeval* start, const struct timeval* end ) {
+  return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000 + end->tv_usec - start->tv_usec;
+}
+
+static void end_measurement( outcome_s* outcome ) {
+  struct rusage usage;
+{
+  outcome->wall_time = PLAINMTP(get_monotonic_time()) - start_time;
+  fake_device_get_counters( &outcome->counters );
+
+  (void)getrusage( RUSAGE_SELF, &usage );
+  outcome->user_time = get_elapsed_time( &start_usage.ru_utime, &usage.ru_utime );
+  outcome->system_time = get_elapsed_time( &start_usage.ru_stime, &usage.ru_stime );
+
+  /* NB: Linux reports it in kibibytes, while some other systems do it in bytes. */
+  outcome->setup_rss = setup_rss;
+  outcome->peak_rss = usage.ru_maxrss;
+}}
+
+/* The same lookup as the one of mtpls. */
+static plainmtp_bool seek_object( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* name, size_t length
+) {
+  plainmtp_cursor_s* const image = (plainmtp_cursor_s*)cursor;
+{
+  while (plainmtp_cursor_select( cursor, device )) {
+    if (image->name == NULL) { continue; }
+
+    /* BEWARE: Short-circuit evaluation matters here! */
+    /* NB: wcsncmp() must be checked first to guarantee minimum length of the string. */
+    if ( (wcsncmp( name, image->name, length ) == 0) && (image->name[length] == L'\0') ) {
+      return !plainmtp_cursor_select( cursor, NULL );
+    }
+  }
+
+  return PLAINMTP_FALSE;
+}}
+
+static plainmtp_bool seek_path( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* path
+) {
+  size_t length = 0;
+{
+  while (path[length] != L'\0') {
+    if (path[length] == PATH_DELIMITER) {
+      if (!seek_object( cursor, device, path, length )) { return PLAINMTP_FALSE; }
+      path += length + 1;
+      length = 0;
+    } else {
+      ++length;
+    }
+  }
+
+  return seek_object( cursor, device, path, length );
+}}
+
+/* Accepts the data in both modes, and only counts it. */
+static void* CB_consume_data( void* data, size_t size, void* custom_state ) {
+{
+  if (size == 0) { return NULL; }
+  if (data == NULL) { return exchange_buffer; }
+
+  *(uint64_t*)custom_state += size;
+  return data;
+}}
+
+/* Provides the data in both modes, and counts it. */
+static void* CB_produce_data( void* data, size_t size, void* custom_state ) {
+{
+  if (size == 0) { return NULL; }
+  if (data == NULL) { data = exchange_buffer; }
+
+  memset( data, 0xA5, size );
+  *(uint64_t*)custom_state += size;
+  return data;
+}}
+
+/**************************************************************************************************/
+
+static unsigned long scenario_list( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  unsigned long count = 0;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\DCIM\\Camera" )) { return 0; }
+
+  begin_measurement();
+  while (plainmtp_cursor_select( root, device )) { ++count; }
+
+  return (count == FAKE_CAMERA_COUNT) ? count : 0;
+}}
+
+static unsigned long scenario_switch( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  plainmtp_cursor_s* const image = (plainmtp_cursor_s*)root;
+  wchar_t* ids[SWITCH_COUNT];
+  unsigned long count = 0, position = 0, i = 0;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\Download" )) { return 0; }
+
+  /* The IDs are spread evenly over the folder. */
+  while ( (count < SWITCH_COUNT) && plainmtp_cursor_select( root, device ) ) {
+    if (position++ % (FAKE_DOWNLOAD_COUNT / SWITCH_COUNT) != 0) { continue; }
+
+    ids[count] = malloc( (wcslen( image->id ) + 1) * sizeof(wchar_t) );
+    if (ids[count] == NULL) { goto cleanup; }
+
+    wcscpy( ids[count++], image->id );
+  }
+
+  (void)plainmtp_cursor_return( root, device );
+  if (count != SWITCH_COUNT) { goto cleanup; }
+
+  begin_measurement();
+  for (i = 0; i < SWITCH_COUNT; ++i) {
+    if (plainmtp_cursor_switch( root, ids[i], device ) == NULL) { break; }
+  }
+
+cleanup:
+  while (count > 0) { free( ids[--count] ); }
+  return (i == SWITCH_COUNT) ? i : 0;
+}}
+
+static unsigned long scenario_paths( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  wchar_t path[FAKE_DEEP_DEPTH * 10 + 64];
+  size_t length;
+  struct plainmtp_cursor_s* cursor;
+  unsigned long i;
+{
+  length = swprintf( path, sizeof(path) / sizeof(*path), STORAGE_PATH L"\\Documents" );
+  for (i = 0; i < FAKE_DEEP_DEPTH; ++i) {
+    length += swprintf( path + length, sizeof(path) / sizeof(*path) - length, L"\\level_%02lu",
+      i );
+  }
+
+  cursor = plainmtp_cursor_assign( NULL, root );
+  if (cursor == NULL) { return 0; }
+
+  begin_measurement();
+  for (i = 0; i < PATH_COUNT; ++i) {
+    (void)swprintf( path + length, sizeof(path) / sizeof(*path) - length, L"\\note_%02lu.txt",
+      i % FAKE_DEEP_SIBLINGS );
+
+    if ( (plainmtp_cursor_assign( cursor, root ) == NULL) || !seek_path( cursor, device, path ) ) {
+      break;
+    }
+  }
+
+  (void)plainmtp_cursor_assign( cursor, NULL );
+  return (i == PATH_COUNT) ? i : 0;
+}}
+
+static unsigned long scenario_pull_small( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  plainmtp_cursor_s* const image = (plainmtp_cursor_s*)root;
+  unsigned long count = 0;
+  uint64_t size;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\Download" )) { return 0; }
+
+  begin_measurement();
+  while (plainmtp_cursor_select( root, device )) {
+    size = 0;
+    if ( !plainmtp_cursor_receive( root, device, EXCHANGE_SIZE, &CB_consume_data, &size )
+      || (size != image->size)
+    ) {
+      return 0;
+    }
+
+    ++count;
+  }
+
+  return (count == FAKE_DOWNLOAD_COUNT) ? count : 0;
+}}
+
+static unsigned long scenario_pull_large( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  uint64_t size = 0;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\Movies\\holiday.mp4" )) { return 0; }
+
+  begin_measurement();
+  if (!plainmtp_cursor_receive( root, device, EXCHANGE_SIZE, &CB_consume_data, &size )) {
+    return 0;
+  }
+
+  return (size == FAKE_MOVIE_SIZE) ? 1 : 0;
+}}
+
+/* The movie is received through a queue, which executes it in segments when the device allows
+  that. Without GetPartialObject64, the segments would fail beyond 4 GiB, so it's received whole. */
+static unsigned long receive_large_queued( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root, plainmtp_bool has_partial64
+) {
+  struct plainmtp_queue_s* queue;
+  plainmtp_job_s job;
+  uint64_t size = 0;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\Movies\\holiday.mp4" )) { return 0; }
+  fake_device_set_partial64( has_partial64 );
+
+  queue = plainmtp_queue_create( device );
+  if (queue == NULL) { return 0; }
+
+  memset( &job, 0, sizeof(job) );
+  job.target.cursor = root;
+  job.chunk_limit = EXCHANGE_SIZE;
+  job.callback = &CB_consume_data;
+  job.custom_state = &size;
+
+  begin_measurement();
+  if (plainmtp_queue_push( queue, &job )) { (void)plainmtp_queue_run( queue, 0 ); }
+
+  plainmtp_queue_destroy( queue );
+  return (size == FAKE_MOVIE_SIZE) ? 1 : 0;
+}}
+
+static unsigned long scenario_pull_large_queue( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+{
+  return receive_large_queued( device, root, PLAINMTP_TRUE );
+}}
+
+static unsigned long scenario_pull_large_queue32( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+{
+  return receive_large_queued( device, root, PLAINMTP_FALSE );
+}}
+
+/* The folders of the tree exist already, since the API can't create them. */
+static unsigned long scenario_upload( struct plainmtp_device_s* device,
+  struct plainmtp_cursor_s* root
+) {
+  struct plainmtp_cursor_s* albums[FAKE_ALBUM_COUNT];
+  wchar_t name[32];
+  unsigned long count = 0, i = 0, j;
+  uint64_t size;
+{
+  if (!seek_path( root, device, STORAGE_PATH L"\\Upload" )) { return 0; }
+
+  while ( (count < FAKE_ALBUM_COUNT) && plainmtp_cursor_select( root, device ) ) {
+    albums[count] = plainmtp_cursor_assign( NULL, root );
+    if (albums[count] == NULL) { goto cleanup; }
+    ++count;
+  }
+
+  (void)plainmtp_cursor_return( root, device );
+  if (count != FAKE_ALBUM_COUNT) { goto cleanup; }
+
+  begin_measurement();
+  for (i = 0; i < FAKE_ALBUM_COUNT; ++i) {
+    for (j = 0; j < UPLOAD_FILE_COUNT; ++j) {
+      (void)swprintf( name, sizeof(name) / sizeof(*name), L"IMG_%04lu.jpg", j );
+
+      size = 0;
+      if ( !plainmtp_cursor_transfer( albums[i], device, name, UPLOAD_FILE_SIZE,
+          UPLOAD_FILE_SIZE, &CB_produce_data, &size, NULL )
+        || (size != UPLOAD_FILE_SIZE)
+      ) {
+        goto cleanup;
+      }
+    }
+  }
+
+cleanup:
+  while (count > 0) { (void)plainmtp_cursor_assign( albums[--count], NULL ); }
+  return (i == FAKE_ALBUM_COUNT) ? i * UPLOAD_FILE_COUNT : 0;
+}}
+
+static const scenario_s scenarios[] = {
+  { "list.camera", "entry", &scenario_list },
+  { "switch.download", "id", &scenario_switch },
+  { "paths.documents", "path", &scenario_paths },
+  { "pull.small", "file", &scenario_pull_small },
+  { "pull.large", "file", &scenario_pull_large },
+  { "pull.large.queue", "file", &scenario_pull_large_queue },
+  { "pull.large.queue32", "file", &scenario_pull_large_queue32 },
+  { "upload.tree", "file", &scenario_upload }
+};
+
+#define SCENARIO_COUNT (sizeof(scenarios) / sizeof(*scenarios))
+
+/**************************************************************************************************/
+
+/* This is done by the child process. */
+static plainmtp_bool perform_scenario( const scenario_s* scenario, outcome_s* OUT_outcome ) {
+  struct plainmtp_context_s* context = NULL;
+  struct plainmtp_device_s* device = NULL;
+  struct plainmtp_cursor_s* root = NULL;
+{
+  OUT_outcome->operations = 0;
+  if (!fake_device_create()) { return PLAINMTP_FALSE; }
+
+  context = plainmtp_startup();
+  if (context == NULL) { goto cleanup; }
+
+  device = plainmtp_device_start( context, 0, PLAINMTP_FALSE );
+  if (device == NULL) { goto cleanup; }
+
+  root = plainmtp_cursor_switch( NULL, NULL, device );
+  if (root == NULL) { goto cleanup; }
+
+  OUT_outcome->operations = scenario->run( device, root );
+  end_measurement( OUT_outcome );
+
+cleanup:
+  if (root != NULL) { (void)plainmtp_cursor_assign( root, NULL ); }
+  if (device != NULL) { plainmtp_device_finish( device ); }
+  if (context != NULL) { plainmtp_shutdown( context ); }
+
+  fake_device_destroy();
+  return (OUT_outcome->operations != 0);
+}}
+
+static plainmtp_bool run_scenario( const scenario_s* scenario, outcome_s* OUT_outcome ) {
+  int pipe_ends[2], status;
+  size_t offset = 0;
+  ssize_t count;
+  pid_t child;
+{
+  if (pipe( pipe_ends ) != 0) { return PLAINMTP_FALSE; }
+
+  fflush( stdout );
+  child = fork();
+
+  if (child == 0) {
+    close( pipe_ends[0] );
+    if (perform_scenario( scenario, OUT_outcome )) {
+      (void)write( pipe_ends[1], OUT_outcome, sizeof(*OUT_outcome) );
+    }
+    _exit( EXIT_SUCCESS );
+  }
+
+  close( pipe_ends[1] );
+
+  while ( (child > 0) && (offset < sizeof(*OUT_outcome)) ) {
+    count = read( pipe_ends[0], (char*)OUT_outcome + offset, sizeof(*OUT_outcome) - offset );
+    if (count <= 0) { break; }
+    offset += count;
+  }
+
+  close( pipe_ends[0] );
+  if (child > 0) { (void)waitpid( child, &status, 0 ); }
+
+  return (offset == sizeof(*OUT_outcome));
+}}
+
+/* The device time is modeled after the transactions and the data that went through the device. */
+static uint64_t get_device_time( const fake_counters_s* counters, unsigned long latency,
+  unsigned long bandwidth
+) {
+  const uint64_t bytes = counters->bytes_received + counters->bytes_transferred;
+{
+  return (uint64_t)counters->transactions * latency + bytes / bandwidth * 1000000 / 1048576;
+}}
+
+/* usage: mtpscenarios {FORMAT {NAME_PREFIX {LATENCY_US {MIB_PER_SECOND}}}}
+  FORMAT is either "text" (the default) or "json", which is meant for tracking the results. Only
+  the scenarios with the names that start with NAME_PREFIX are run, if it's given. The rest of the
+  arguments set the latency model of the device that the modeled device time is derived from. */
+int main( int argc, char* argv[] ) {
+  const char* const format = (argc > 1) ? argv[1] : FORMAT_TEXT;
+  const char* const prefix = (argc > 2) ? argv[2] : "";
+  const unsigned long latency = (argc > 3) ? strtoul( argv[3], NULL, 10 ) : DEFAULT_LATENCY;
+  const unsigned long bandwidth = (argc > 4) ? strtoul( argv[4], NULL, 10 ) : DEFAULT_BANDWIDTH;
+  const plainmtp_bool is_json = (strcmp( format, FORMAT_JSON ) == 0);
+  outcome_s outcome;
+  uint64_t bytes, device_time;
+  size_t i;
+  const char* separator = "";
+{
+  if ( (!is_json && (strcmp( format, FORMAT_TEXT ) != 0)) || (bandwidth == 0) ) {
+    fputs( "usage: mtpscenarios {text|json {NAME_PREFIX {LATENCY_US {MIB_PER_SECOND}}}}\n",
+      stderr );
+    return EXIT_FAILURE;
+  }
+
+  if (is_json) {
+    printf( "{\"latency_us\": %lu, \"mib_per_second\": %lu, \"scenarios\": [", latency,
+      bandwidth );
+  } else {
+    printf( "%-18s %7s %10s %10s %10s %8s %12s %10s\n", "scenario", "count", "wall ms",
+      "cpu ms", "trips", "MiB", "device s", "peak KiB" );
+  }
+
+  for (i = 0; i < SCENARIO_COUNT; ++i) {
+    if (strncmp( scenarios[i].name, prefix, strlen( prefix ) ) != 0) { continue; }
+
+    if (!run_scenario( &scenarios[i], &outcome )) {
+      fprintf( stderr, "scenario %s has failed\n", scenarios[i].name );
+      return EXIT_FAILURE;
+    }
+
+    bytes = outcome.counters.bytes_received + outcome.counters.bytes_transferred;
+    device_time = get_device_time( &outcome.counters, latency, bandwidth );
+
+    if (is_json) {
+      printf( "%s\n  {\"name\": \"%s\", \"unit\": \"%s\", \"operations\": %lu, "
+        "\"wall_us\": %"PRINTF_INT64_MODIFIER"u, \"user_us\": %"PRINTF_INT64_MODIFIER"u, "
+        "\"system_us\": %"PRINTF_INT64_MODIFIER"u, \"round_trips\": %lu, "
+        "\"bytes\": %"PRINTF_INT64_MODIFIER"u, \"device_us\": %"PRINTF_INT64_MODIFIER"u, "
+        "\"setup_rss_kib\": %ld, \"peak_rss_kib\": %ld}", separator, scenarios[i].name,
+        scenarios[i].unit, outcome.operations, outcome.wall_time, outcome.user_time,
+        outcome.system_time, outcome.counters.transactions, bytes, device_time,
+        outcome.setup_rss, outcome.peak_rss );
+      separator = ",";
+    } else {
+      printf( "%-18s %7lu %10.1f %10.1f %10lu %8.1f %12.1f %10ld\n", scenarios[i].name,
+        outcome.operations, outcome.wall_time / 1000.0,
+        (outcome.user_time + outcome.system_time) / 1000.0, outcome.counters.transactions,
+        bytes / 1048576.0, device_time / 1000000.0, outcome.peak_rss );
+    }
+  }
+
+  if (is_json) { puts( "\n]}" ); }
+  return EXIT_SUCCESS;
+}}
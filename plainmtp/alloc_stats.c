@@ -0,0 +1,341 @@
+#include "alloc_stats.h.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* NB: The functions of the module are the only ones that use the standard memory management
+  directly, but they're the ones the macros redirect it to. */
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  #undef malloc
+  #undef calloc
+  #undef realloc
+  #undef free
+#endif
+
+#define alloc_accounting ZZ_PLAINMTP(alloc_accounting)
+PLAINMTP_INTERNAL alloc_accounting_s alloc_accounting;
+
+#define add_allocation ZZ_PLAINMTP(add_allocation)
+PLAINMTP_INTERNAL void add_allocation( plainmtp_alloc_stats_s* stats, size_t size ) {
+{
+  stats->count += 1;
+  stats->bytes += size;
+  stats->live_bytes += size;
+  if (stats->live_bytes > stats->peak_bytes) { stats->peak_bytes = stats->live_bytes; }
+}}
+
+/* Returns the slot that contains the pointer, or the empty one where it has to be placed. */
+#define find_alloc_slot ZZ_PLAINMTP(find_alloc_slot)
+PLAINMTP_INTERNAL alloc_entry_s* find_alloc_slot( alloc_entry_s* entries, size_t capacity,
+  const void* pointer
+) {
+  size_t index = ALLOC_TABLE_HASH( pointer, capacity - 1 );
+{
+  while ( (entries[index].pointer != NULL) && (entries[index].pointer != pointer) ) {
+    index = (index + 1) & (capacity - 1);
+  }
+
+  return &entries[index];
+}}
+
+#define grow_alloc_table ZZ_PLAINMTP(grow_alloc_table)
+PLAINMTP_INTERNAL plainmtp_bool grow_alloc_table(void) {
+  alloc_entry_s* entries;
+  size_t capacity;
+  size_t i;
+{
+  capacity = (alloc_accounting.capacity != 0)
+    ? alloc_accounting.capacity * 2 : ALLOC_TABLE_INITIAL_CAPACITY;
+
+  entries = calloc( capacity, sizeof(*entries) );
+  if (entries == NULL) { return PLAINMTP_FALSE; }
+
+  for (i = 0; i < alloc_accounting.capacity; ++i) {
+    if (alloc_accounting.entries[i].pointer == NULL) { continue; }
+    *find_alloc_slot( entries, capacity, alloc_accounting.entries[i].pointer )
+      = alloc_accounting.entries[i];
+  }
+
+  free( alloc_accounting.entries );
+  alloc_accounting.entries = entries;
+  alloc_accounting.capacity = capacity;
+
+  return PLAINMTP_TRUE;
+}}
+
+/* Returns the size of the allocation, or 0 if it's unknown. */
+#define forget_allocation ZZ_PLAINMTP(forget_allocation)
+PLAINMTP_INTERNAL size_t forget_allocation( void* pointer ) {
+  alloc_entry_s* slot;
+  size_t mask = alloc_accounting.capacity - 1;
+  size_t empty, index, home, size;
+{
+  if (alloc_accounting.capacity == 0) { return 0; }
+
+  /* The memory that wasn't allocated by the library, e.g. the strings of libmtp, is not there. */
+  slot = find_alloc_slot( alloc_accounting.entries, alloc_accounting.capacity, pointer );
+  if (slot->pointer == NULL) { return 0; }
+
+  size = slot->size;
+  slot->total->live_bytes -= slot->size;
+  if (slot->record != NULL) { slot->record->live_bytes -= slot->size; }
+
+  /* Shift the entries of the probe sequence back, so it has no gaps without tombstones. */
+  empty = (size_t)(slot - alloc_accounting.entries);
+  index = empty;
+
+  for (;;) {
+    index = (index + 1) & mask;
+    if (alloc_accounting.entries[index].pointer == NULL) { break; }
+
+    home = ALLOC_TABLE_HASH( alloc_accounting.entries[index].pointer, mask );
+    if ( ((index - home) & mask) >= ((index - empty) & mask) ) {
+      alloc_accounting.entries[empty] = alloc_accounting.entries[index];
+      empty = index;
+    }
+  }
+
+  alloc_accounting.entries[empty].pointer = NULL;
+  alloc_accounting.count -= 1;
+
+  return size;
+}}
+
+#define remember_allocation ZZ_PLAINMTP(remember_allocation)
+PLAINMTP_INTERNAL void remember_allocation( void* pointer, size_t size ) {
+  alloc_scope_s* scope;
+  alloc_entry_s* slot;
+{
+  /* An allocation that was freed outside of the library can be at the same address. */
+  (void)forget_allocation( pointer );
+
+  if ( (alloc_accounting.count + 1) * 2 > alloc_accounting.capacity ) {
+    if (!grow_alloc_table()) { return; }
+  }
+
+  slot = find_alloc_slot( alloc_accounting.entries, alloc_accounting.capacity, pointer );
+  scope = PLAINMTP(thread_local_get( alloc_accounting.current_scope ));
+
+  slot->pointer = pointer;
+  slot->size = size;
+  slot->total = (scope != NULL) ? &scope->total : &alloc_accounting.outside;
+  slot->record = ( (scope != NULL) && (scope->record != NULL) ) ? &scope->record->stats : NULL;
+  alloc_accounting.count += 1;
+
+  add_allocation( slot->total, size );
+  if (slot->record != NULL) { add_allocation( slot->record, size ); }
+}}
+
+/**************************************************************************************************/
+
+#define start_alloc_accounting PLAINMTP(start_alloc_accounting)
+plainmtp_bool start_alloc_accounting(void) {
+  mutex_s* lock;
+  thread_local_s* current_scope;
+{
+  if (alloc_accounting.user_count != 0) {
+    alloc_accounting.user_count += 1;
+    return PLAINMTP_TRUE;
+  }
+
+  lock = PLAINMTP(mutex_create());
+  if (lock == NULL) { return PLAINMTP_FALSE; }
+
+  current_scope = PLAINMTP(thread_local_create());
+  if (current_scope == NULL) {
+    PLAINMTP(mutex_destroy( lock ));
+    return PLAINMTP_FALSE;
+  }
+
+  memset( &alloc_accounting, 0, sizeof(alloc_accounting) );
+  alloc_accounting.user_count = 1;
+  alloc_accounting.current_scope = current_scope;
+  alloc_accounting.lock = lock;
+
+  return PLAINMTP_TRUE;
+}}
+
+#define finish_alloc_accounting PLAINMTP(finish_alloc_accounting)
+void finish_alloc_accounting(void) {
+  mutex_s* lock = alloc_accounting.lock;
+{
+  if (alloc_accounting.user_count == 0) { return; }
+  if (--alloc_accounting.user_count != 0) { return; }
+
+  /* The memory of the primitives is freed with the accounting already stopped. */
+  alloc_accounting.lock = NULL;
+  PLAINMTP(thread_local_destroy( alloc_accounting.current_scope ));
+  PLAINMTP(mutex_destroy( lock ));
+
+  free( alloc_accounting.entries );
+  memset( &alloc_accounting, 0, sizeof(alloc_accounting) );
+}}
+
+#define enter_alloc_scope PLAINMTP(enter_alloc_scope)
+void enter_alloc_scope( alloc_scope_s* scope, const char* api_name ) {
+  size_t i;
+{
+  if (alloc_accounting.lock == NULL) { return; }
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+
+  if (scope->depth++ == 0) {
+    scope->outer = PLAINMTP(thread_local_get( alloc_accounting.current_scope ));
+    (void)PLAINMTP(thread_local_set( alloc_accounting.current_scope, scope ));
+
+    for (i = 0; i < scope->record_count; ++i) {
+      if (strcmp( scope->records[i].api_name, api_name ) == 0) { break; }
+    }
+
+    if ( (i == scope->record_count) && (i < ALLOC_SCOPE_RECORD_COUNT) ) {
+      memset( &scope->records[i], 0, sizeof(scope->records[i]) );
+      scope->records[i].api_name = api_name;
+      scope->record_count += 1;
+    }
+
+    scope->record = (i < scope->record_count) ? &scope->records[i] : NULL;
+  }
+
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+}}
+
+#define leave_alloc_scope PLAINMTP(leave_alloc_scope)
+void leave_alloc_scope( alloc_scope_s* scope ) {
+{
+  if (alloc_accounting.lock == NULL) { return; }
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+
+  if (--scope->depth == 0) {
+    (void)PLAINMTP(thread_local_set( alloc_accounting.current_scope, scope->outer ));
+    scope->outer = NULL;
+    scope->record = NULL;
+  }
+
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+}}
+
+#define reset_alloc_scope PLAINMTP(reset_alloc_scope)
+void reset_alloc_scope( alloc_scope_s* scope ) {
+  size_t i;
+{
+  if (alloc_accounting.lock == NULL) {
+    memset( scope, 0, sizeof(*scope) );
+    return;
+  }
+
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+
+  for (i = 0; i < alloc_accounting.capacity; ++i) {
+    if (alloc_accounting.entries[i].pointer == NULL) { continue; }
+    if (alloc_accounting.entries[i].total != &scope->total) { continue; }
+
+    alloc_accounting.entries[i].total = &alloc_accounting.detached;
+    alloc_accounting.entries[i].record = NULL;
+  }
+
+  memset( scope, 0, sizeof(*scope) );
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+}}
+
+#define get_alloc_stats PLAINMTP(get_alloc_stats)
+plainmtp_bool get_alloc_stats( alloc_scope_s* scope, const char* api_name,
+  plainmtp_alloc_stats_s* OUT_stats
+) {
+  plainmtp_bool result = PLAINMTP_TRUE;
+  size_t i;
+{
+  if (alloc_accounting.lock == NULL) { return PLAINMTP_FALSE; }
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+
+  if (scope == NULL) {
+    *OUT_stats = alloc_accounting.outside;
+  } else if (api_name == NULL) {
+    *OUT_stats = scope->total;
+  } else {
+    for (i = 0; i < scope->record_count; ++i) {
+      if (strcmp( scope->records[i].api_name, api_name ) == 0) { break; }
+    }
+
+    result = (i < scope->record_count);
+    if (result) { *OUT_stats = scope->records[i].stats; }
+  }
+
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+  return result;
+}}
+
+/**************************************************************************************************/
+
+/* NB: The accounting is updated before the memory is freed, so another thread can't receive the
+  same address in the meantime. A reallocation is done under the lock for the same reason. */
+
+#define account_allocation PLAINMTP(account_allocation)
+void account_allocation( void* pointer, size_t size ) {
+{
+  if ( (pointer == NULL) || (alloc_accounting.lock == NULL) ) { return; }
+
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+  remember_allocation( pointer, size );
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+}}
+
+#define account_deallocation PLAINMTP(account_deallocation)
+void account_deallocation( void* pointer ) {
+{
+  if ( (pointer == NULL) || (alloc_accounting.lock == NULL) ) { return; }
+
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+  (void)forget_allocation( pointer );
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+}}
+
+#define accounted_malloc PLAINMTP(accounted_malloc)
+void* accounted_malloc( size_t size ) {
+  void* result;
+{
+  result = malloc( size );
+  account_allocation( result, size );
+  return result;
+}}
+
+#define accounted_calloc PLAINMTP(accounted_calloc)
+void* accounted_calloc( size_t count, size_t size ) {
+  void* result;
+{
+  result = calloc( count, size );
+  account_allocation( result, count * size );
+  return result;
+}}
+
+#define accounted_realloc PLAINMTP(accounted_realloc)
+void* accounted_realloc( void* pointer, size_t size ) {
+  void* result;
+  size_t original_size;
+{
+  if (alloc_accounting.lock == NULL) { return realloc( pointer, size ); }
+  PLAINMTP(mutex_lock( alloc_accounting.lock ));
+
+  original_size = (pointer != NULL) ? forget_allocation( pointer ) : 0;
+  result = realloc( pointer, size );
+
+  /* The original block is intact on failure, unless it was a request to free it. Then it's
+    accounted anew, which is inexact, but only when out of memory. */
+  if (result != NULL) {
+    remember_allocation( result, size );
+  } else if ( (original_size != 0) && (size != 0) ) {
+    remember_allocation( pointer, original_size );
+  }
+
+  PLAINMTP(mutex_unlock( alloc_accounting.lock ));
+  return result;
+}}
+
+#define accounted_free PLAINMTP(accounted_free)
+void accounted_free( void* pointer ) {
+{
+  account_deallocation( pointer );
+  free( pointer );
+}}
+
+#ifdef PP_PLAINMTP_ALLOC_STATS_C_EX
+#include PP_PLAINMTP_ALLOC_STATS_C_EX
+#endif
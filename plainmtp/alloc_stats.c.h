@@ -0,0 +1,49 @@
+#ifndef ZZ_PLAINMTP_ALLOC_STATS_C_IG
+#define ZZ_PLAINMTP_ALLOC_STATS_C_IG
+#include "common.i.h"
+
+#include "plainmtp.h"
+
+#define ALLOC_SCOPE_RECORD_COUNT 16
+
+typedef struct ZZ_PLAINMTP(alloc_record_s) {
+  const char* api_name;
+  plainmtp_alloc_stats_s stats;
+} alloc_record_s;
+
+/* The allocations made while the scope is entered by the current thread are attributed to it and
+  to the record of the API call that has entered it. A zero-initialized scope is a valid one. */
+typedef struct ZZ_PLAINMTP(alloc_scope_s) {
+  plainmtp_alloc_stats_s total;
+  alloc_record_s records[ALLOC_SCOPE_RECORD_COUNT];
+  size_t record_count;
+
+  alloc_record_s* record;  /* NULL if the API call didn't fit into the records. */
+  size_t depth;
+  struct ZZ_PLAINMTP(alloc_scope_s)* outer;  /* The one the thread has entered before. */
+} alloc_scope_s;
+
+/* NB: Both must not be called concurrently with each other. The accounting lasts from the first
+  start to the matching number of finishes, and the allocations outside of it aren't accounted. */
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(start_alloc_accounting(void));
+PLAINMTP_EXTERN void PLAINMTP(finish_alloc_accounting(void));
+
+PLAINMTP_EXTERN void PLAINMTP(enter_alloc_scope( alloc_scope_s* scope, const char* api_name ));
+PLAINMTP_EXTERN void PLAINMTP(leave_alloc_scope( alloc_scope_s* scope ));
+
+/* The allocations of the scope that are still alive are forgotten and the scope is zeroed, so it
+  can be reused or freed. It may contain garbage before that. */
+PLAINMTP_EXTERN void PLAINMTP(reset_alloc_scope( alloc_scope_s* scope ));
+
+/* These account the memory that is managed by other means than the standard functions, e.g. by
+  the allocators of the system. The latter must be called before the memory is freed. */
+PLAINMTP_EXTERN void PLAINMTP(account_allocation( void* pointer, size_t size ));
+PLAINMTP_EXTERN void PLAINMTP(account_deallocation( void* pointer ));
+
+/* If 'scope' is NULL, the allocations made outside of any scope are reported. */
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(get_alloc_stats( alloc_scope_s* scope,
+  const char* api_name, plainmtp_alloc_stats_s* OUT_stats ));
+
+#else
+#error ZZ_PLAINMTP_ALLOC_STATS_C_IG
+#endif
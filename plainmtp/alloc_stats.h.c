@@ -0,0 +1,54 @@
+#include "alloc_stats.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include "threads.c.h"
+
+/* The table of the live allocations grows when it becomes half full, which keeps the probe
+  sequences of the open addressing short. */
+#define ALLOC_TABLE_INITIAL_CAPACITY 1024
+#define ALLOC_TABLE_HASH( Pointer, Mask ) \
+  ( ( (size_t)((uintptr_t)(Pointer) >> 4) * 2654435761UL ) & (Mask) )
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+/* An allocation of the library that is still alive, along with the statistics it's accounted in. */
+typedef struct ZZ_PLAINMTP(alloc_entry_s) {
+  void* pointer;  /* NULL if the slot is empty. */
+  size_t size;
+  plainmtp_alloc_stats_s* total;
+  plainmtp_alloc_stats_s* record;  /* NULL if there's none. */
+} alloc_entry_s;
+
+typedef struct ZZ_PLAINMTP(alloc_accounting_s) {
+  size_t user_count;
+
+  /* NULL if the accounting isn't started. Guards everything else, including all the scopes. */
+  mutex_s* lock;
+  thread_local_s* current_scope;
+
+  alloc_entry_s* entries;
+  size_t capacity;  /* A power of two, or 0 if there's no table yet. */
+  size_t count;
+
+  plainmtp_alloc_stats_s outside;  /* The allocations made outside of any scope. */
+  plainmtp_alloc_stats_s detached;  /* Sink for the ones that outlive their scopes. */
+} alloc_accounting_s;
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN alloc_accounting_s ZZ_PLAINMTP(alloc_accounting);
+
+PLAINMTP_EXTERN void ZZ_PLAINMTP(add_allocation( plainmtp_alloc_stats_s* stats, size_t size ));
+PLAINMTP_EXTERN alloc_entry_s* ZZ_PLAINMTP(find_alloc_slot( alloc_entry_s* entries,
+  size_t capacity, const void* pointer ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(grow_alloc_table(void));
+PLAINMTP_EXTERN size_t ZZ_PLAINMTP(forget_allocation( void* pointer ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(remember_allocation( void* pointer, size_t size ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
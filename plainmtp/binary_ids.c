@@ -0,0 +1,57 @@
+#include "binary_ids.h.c"
+
+#include <string.h>
+#include <assert.h>
+
+plainmtp_bool plainmtp_binary_id_parse( plainmtp_binary_id_s* OUT_binary_id,
+  const wchar_t* entity_id
+) {
+{
+  assert( OUT_binary_id != NULL );
+  assert( entity_id != NULL );
+
+  /* NB: The storage IDs are in the '{...}' form as well, but they have a prefix and don't match. */
+  if ( PLAINMTP(read_wpd_plain_guid( OUT_binary_id->bytes, entity_id )) ) {
+    return PLAINMTP_TRUE;
+  }
+
+  memset( OUT_binary_id->bytes, 0, sizeof(OUT_binary_id->bytes) );
+  return PLAINMTP_FALSE;
+}}
+
+void plainmtp_binary_id_format( const plainmtp_binary_id_s* binary_id, wchar_t* OUT_string ) {
+{
+  assert( binary_id != NULL );
+  assert( OUT_string != NULL );
+
+  PLAINMTP(write_wpd_plain_guid( binary_id->bytes, OUT_string ));
+}}
+
+int plainmtp_binary_id_compare( const plainmtp_binary_id_s* left,
+  const plainmtp_binary_id_s* right
+) {
+{
+  assert( left != NULL );
+  assert( right != NULL );
+
+  return memcmp( left->bytes, right->bytes, sizeof(left->bytes) );
+}}
+
+size_t plainmtp_binary_id_hash( const plainmtp_binary_id_s* binary_id ) {
+  /* This is the 32-bit FNV-1a: http://www.isthe.com/chongo/tech/comp/fnv/index.html */
+  uint32_t result = UINT32_C(2166136261);
+  size_t i;
+{
+  assert( binary_id != NULL );
+
+  for (i = 0; i < sizeof(binary_id->bytes); ++i) {
+    result ^= binary_id->bytes[i];
+    result *= UINT32_C(16777619);
+  }
+
+  return (size_t)result;
+}}
+
+#ifdef PP_PLAINMTP_BINARY_IDS_C_EX
+#include PP_PLAINMTP_BINARY_IDS_C_EX
+#endif
@@ -0,0 +1,4 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+#include "wpd_puid.c.h"
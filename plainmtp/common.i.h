@@ -36,4 +36,23 @@ typedef enum {
   ZZ_PLAINMTP_SUBCLASS, ( ZZ_PLAINMTP_TAG_NAME__## Specifier, Super_Field ) \
 )
 
+/**************************************************************************************************/
+
+/* NB: In this mode, the memory management of the library goes through the functions that account
+  it. The standard header is included first, so the later inclusions don't see the macros. */
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  #include <stddef.h>
+  #include <stdlib.h>
+
+  PLAINMTP_EXTERN void* PLAINMTP(accounted_malloc( size_t size ));
+  PLAINMTP_EXTERN void* PLAINMTP(accounted_calloc( size_t count, size_t size ));
+  PLAINMTP_EXTERN void* PLAINMTP(accounted_realloc( void* pointer, size_t size ));
+  PLAINMTP_EXTERN void PLAINMTP(accounted_free( void* pointer ));
+
+  #define malloc( Size ) PLAINMTP(accounted_malloc( Size ))
+  #define calloc( Count, Size ) PLAINMTP(accounted_calloc( Count, Size ))
+  #define realloc( Pointer, Size ) PLAINMTP(accounted_realloc( Pointer, Size ))
+  #define free( Pointer ) PLAINMTP(accounted_free( Pointer ))
+#endif
+
 #endif /* ZZ_PLAINMTP_COMMON_H_IG */
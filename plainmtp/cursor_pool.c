@@ -0,0 +1,92 @@
+#include "cursor_pool.h.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define cursor_pool_start PLAINMTP(cursor_pool_start)
+plainmtp_bool cursor_pool_start( cursor_pool_s* pool, size_t cursor_size ) {
+{
+  pool->free_blocks = NULL;
+  pool->block_size = cursor_size + CURSOR_POOL_STRING_LIMIT * sizeof(wchar_t);
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  /* The cursors can be disposed from any thread, without locking the device they belong to. */
+  pool->lock = PLAINMTP(mutex_create());
+  if (pool->lock == NULL) { return PLAINMTP_FALSE; }
+#endif
+
+  return PLAINMTP_TRUE;
+}}
+
+#define cursor_pool_finish PLAINMTP(cursor_pool_finish)
+void cursor_pool_finish( cursor_pool_s* pool ) {
+  void* block;
+{
+  while (pool->free_blocks != NULL) {
+    block = pool->free_blocks;
+    pool->free_blocks = *(void**)block;
+    free( block );
+  }
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  PLAINMTP(mutex_destroy( pool->lock ));
+#endif
+}}
+
+#define take_pooled_cursor PLAINMTP(take_pooled_cursor)
+void* take_pooled_cursor( cursor_pool_s* pool ) {
+  void* result;
+{
+  LOCK_POOL(pool);
+
+  result = pool->free_blocks;
+  if (result != NULL) { pool->free_blocks = *(void**)result; }
+
+  UNLOCK_POOL(pool);
+
+  return (result != NULL) ? result : malloc( pool->block_size );
+}}
+
+#define keep_pooled_cursor PLAINMTP(keep_pooled_cursor)
+void keep_pooled_cursor( cursor_pool_s* pool, void* cursor ) {
+{
+  LOCK_POOL(pool);
+
+  *(void**)cursor = pool->free_blocks;
+  pool->free_blocks = cursor;
+
+  UNLOCK_POOL(pool);
+}}
+
+#define fit_pooled_strings PLAINMTP(fit_pooled_strings)
+plainmtp_bool fit_pooled_strings( const zz_plainmtp_cursor_s* entity ) {
+  size_t length = wcslen( entity->id ) + 1;
+{
+  if (entity->name != NULL) { length += wcslen( entity->name ) + 1; }
+
+  if (entity->name_u8 != NULL) {
+    length += (strlen( entity->name_u8 ) + sizeof(wchar_t)) / sizeof(wchar_t);
+  }
+
+  return (length <= CURSOR_POOL_STRING_LIMIT);
+}}
+
+#define copy_pooled_strings PLAINMTP(copy_pooled_strings)
+void copy_pooled_strings( wchar_t* storage, zz_plainmtp_cursor_s* entity ) {
+{
+  entity->id = wcscpy( storage, entity->id );
+  storage += wcslen( storage ) + 1;
+
+  if (entity->name != NULL) {
+    entity->name = wcscpy( storage, entity->name );
+    storage += wcslen( storage ) + 1;
+  }
+
+  if (entity->name_u8 != NULL) {
+    entity->name_u8 = strcpy( (char*)storage, entity->name_u8 );
+  }
+}}
+
+#ifdef PP_PLAINMTP_CURSOR_POOL_C_EX
+#include PP_PLAINMTP_CURSOR_POOL_C_EX
+#endif
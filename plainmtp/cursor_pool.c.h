@@ -0,0 +1,39 @@
+#ifndef ZZ_PLAINMTP_CURSOR_POOL_C_IG
+#define ZZ_PLAINMTP_CURSOR_POOL_C_IG
+#include "common.i.h"
+
+#include <wchar.h>
+
+#include "plainmtp.h"
+
+/* Number of characters that can be stored right after a pooled cursor, including the terminators
+  of all the strings. It's enough for the GUID-based IDs and the most of file names. */
+#define CURSOR_POOL_STRING_LIMIT 128
+
+/* Memory blocks of the disposed cursors, each large enough for a cursor of the backend followed by
+  the storage for the strings of its entity. The blocks are kept until the pool is finished. */
+typedef struct ZZ_PLAINMTP(cursor_pool_s) {
+  void* free_blocks;  /* Chained through the first pointer of each block. */
+  size_t block_size;
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  struct ZZ_PLAINMTP(mutex_s)* lock;  /* See threads.c.h */
+#endif
+} cursor_pool_s;
+
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(cursor_pool_start( cursor_pool_s* pool,
+  size_t cursor_size ));
+PLAINMTP_EXTERN void PLAINMTP(cursor_pool_finish( cursor_pool_s* pool ));
+
+PLAINMTP_EXTERN void* PLAINMTP(take_pooled_cursor( cursor_pool_s* pool ));
+PLAINMTP_EXTERN void PLAINMTP(keep_pooled_cursor( cursor_pool_s* pool, void* cursor ));
+
+/* The strings are copied into the storage only if all of them fit there, which is checked before
+  the storage is touched. The entity is changed to refer to the copies then. */
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(fit_pooled_strings( const zz_plainmtp_cursor_s* entity ));
+PLAINMTP_EXTERN void PLAINMTP(copy_pooled_strings( wchar_t* storage,
+  zz_plainmtp_cursor_s* entity ));
+
+#else
+#error ZZ_PLAINMTP_CURSOR_POOL_C_IG
+#endif
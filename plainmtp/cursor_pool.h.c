@@ -0,0 +1,19 @@
+#include "cursor_pool.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include "threads.c.h"
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  #define LOCK_POOL( Pool ) PLAINMTP(mutex_lock( (Pool)->lock ))
+  #define UNLOCK_POOL( Pool ) PLAINMTP(mutex_unlock( (Pool)->lock ))
+#else
+  #define LOCK_POOL( Pool ) ((void)0)
+  #define UNLOCK_POOL( Pool ) ((void)0)
+#endif
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
@@ -0,0 +1,28 @@
+#ifndef ZZ_PLAINMTP_DATA_DIGEST_C_IG
+#define ZZ_PLAINMTP_DATA_DIGEST_C_IG
+#include "common.i.h"
+
+#include "plainmtp.h"
+
+typedef struct ZZ_PLAINMTP(digest_state_s) {
+  plainmtp_digest_e algorithm;
+  uint64_t length;
+
+  union {
+    uint32_t crc32c;
+
+    struct {
+      uint32_t hash[8];
+      uint8_t block[64];
+    } sha256;
+  } value;
+} digest_state_s;
+
+PLAINMTP_EXTERN void PLAINMTP(digest_start( digest_state_s* state, plainmtp_digest_e algorithm ));
+PLAINMTP_EXTERN void PLAINMTP(digest_update( digest_state_s* state, const void* data,
+  size_t size ));
+PLAINMTP_EXTERN void PLAINMTP(digest_finish( digest_state_s* state, plainmtp_digest_s* result ));
+
+#else
+#error ZZ_PLAINMTP_DATA_DIGEST_C_IG
+#endif
@@ -0,0 +1,54 @@
+#include "data_digest.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+/* The hardware CRC32C instructions are used only if the compiler targets them anyway, since C95
+  doesn't provide any portable way to perform the runtime CPU feature detection. */
+#if defined(__SSE4_2__)
+  #include <nmmintrin.h>
+  #define CRC32C_HARDWARE_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+  #include <arm_acle.h>
+  #define CRC32C_HARDWARE_ARMV8
+#endif
+
+/* Reversed representation of the Castagnoli polynomial 0x1EDC6F41. */
+#define CRC32C_POLYNOMIAL (0x82F63B78)
+
+#define ROTATE_RIGHT_32( Value, Count ) \
+  ( ( (Value) >> (Count) ) | ( (Value) << (32 - (Count)) ) )
+
+#define SHA256_CH( X, Y, Z ) ( ((X) & (Y)) ^ (~(X) & (Z)) )
+#define SHA256_MAJ( X, Y, Z ) ( ((X) & (Y)) ^ ((X) & (Z)) ^ ((Y) & (Z)) )
+#define SHA256_EP0( X ) \
+  ( ROTATE_RIGHT_32(X, 2) ^ ROTATE_RIGHT_32(X, 13) ^ ROTATE_RIGHT_32(X, 22) )
+#define SHA256_EP1( X ) \
+  ( ROTATE_RIGHT_32(X, 6) ^ ROTATE_RIGHT_32(X, 11) ^ ROTATE_RIGHT_32(X, 25) )
+#define SHA256_SIG0( X ) ( ROTATE_RIGHT_32(X, 7) ^ ROTATE_RIGHT_32(X, 18) ^ ((X) >> 3) )
+#define SHA256_SIG1( X ) ( ROTATE_RIGHT_32(X, 17) ^ ROTATE_RIGHT_32(X, 19) ^ ((X) >> 10) )
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+enum {
+  DIGEST_SIZE_CRC32C = 4,
+  DIGEST_SIZE_SHA256 = 32,
+  SHA256_BLOCK_SIZE = 64
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN const uint32_t ZZ_PLAINMTP(sha256_round_constants[64]);
+#if !defined(CRC32C_HARDWARE_SSE42) && !defined(CRC32C_HARDWARE_ARMV8)
+PLAINMTP_EXTERN const uint32_t ZZ_PLAINMTP(crc32c_tables[8][256]);
+#endif
+
+PLAINMTP_EXTERN uint32_t ZZ_PLAINMTP(crc32c_update( uint32_t crc, const uint8_t* data,
+  size_t size ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(sha256_transform( uint32_t hash[8], const uint8_t* block ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
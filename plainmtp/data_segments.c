@@ -0,0 +1,137 @@
+#include "data_segments.h.c"
+
+#define segments_start PLAINMTP(segments_start)
+void segments_start( segmented_receive_s* state, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state, plainmtp_digest_e algorithm
+) {
+{
+  state->chunk_limit = chunk_limit;
+  state->callback = callback;
+  state->custom_state = custom_state;
+  state->offset = 0;
+  state->initial_buffer = NULL;
+  state->buffer = NULL;
+  state->is_final_due = (callback != NULL);
+  state->is_aborted = PLAINMTP_FALSE;
+  state->is_unranged = PLAINMTP_FALSE;
+
+  PLAINMTP(digest_start( &state->digest, algorithm ));
+}}
+
+#define CB_segment_exchange ZZ_PLAINMTP(cb_segment_exchange)
+PLAINMTP_INTERNAL void* CB_segment_exchange( void* data, size_t size, void* custom_state ) {
+  segmented_receive_s* state = custom_state;
+  void* result;
+{
+  /* The final call of the segment is not passed to the user's callback. */
+  if (size == 0) { return NULL; }
+
+  if (data == NULL) {
+    if (state->buffer == NULL) {
+      state->buffer = state->callback( NULL, size, state->custom_state );
+      state->initial_buffer = state->buffer;
+
+      if (state->buffer == NULL) {
+        state->is_final_due = PLAINMTP_FALSE;
+        state->is_aborted = PLAINMTP_TRUE;
+      }
+    }
+
+    return state->buffer;
+  }
+
+  PLAINMTP(digest_update( &state->digest, data, size ));
+  state->offset += size;
+
+  result = state->callback( data, size, state->custom_state );
+  if (result == NULL) {
+    state->is_aborted = PLAINMTP_TRUE;
+  } else {
+    state->buffer = result;
+  }
+
+  return result;
+}}
+
+#define segments_finish PLAINMTP(segments_finish)
+void segments_finish( segmented_receive_s* state ) {
+{
+  if (state->is_final_due) {
+    (void)state->callback( state->initial_buffer, 0, state->custom_state );
+    state->is_final_due = PLAINMTP_FALSE;
+  }
+}}
+
+#define CB_discard_data ZZ_PLAINMTP(cb_discard_data)
+PLAINMTP_INTERNAL void* CB_discard_data( void* data, size_t size, void* custom_state ) {
+{
+  if (size == 0) { return NULL; }
+  return (data != NULL) ? data : custom_state;
+}}
+
+/* NB: A device that supports partial receiving only with 32-bit offsets fails the segments beyond
+  4 GiB, when it's too late to receive the object as a whole. So the support of larger offsets is
+  checked by receiving the last byte of such an object, which libmtp refuses right away without a
+  transaction if the device lacks it, as there's no other way to find this out with its API. */
+#define check_segment_offsets ZZ_PLAINMTP(check_segment_offsets)
+PLAINMTP_INTERNAL plainmtp_bool check_segment_offsets( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t segment_size
+) {
+  const uint64_t size = ((plainmtp_cursor_s*)cursor)->size;
+  uint8_t byte;
+{
+  if ( (size <= SEGMENT_OFFSET_LIMIT) || (size <= segment_size) ) { return PLAINMTP_TRUE; }
+  if (size == PLAINMTP_SIZE_UNKNOWN) { return PLAINMTP_FALSE; }
+
+  return plainmtp_cursor_receive_range( cursor, device, size - 1, 1, 1, &CB_discard_data, &byte );
+}}
+
+#define receive_whole_object ZZ_PLAINMTP(receive_whole_object)
+PLAINMTP_INTERNAL plainmtp_3val receive_whole_object( segmented_receive_s* state,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, plainmtp_digest_s* digest
+) {
+  plainmtp_bool success;
+{
+  success = plainmtp_cursor_receive_digest( cursor, device, state->chunk_limit, state->callback,
+    state->custom_state, digest );
+
+  state->is_final_due = PLAINMTP_FALSE;
+  return success ? PLAINMTP_GOOD : PLAINMTP_BAD;
+}}
+
+#define segments_receive PLAINMTP(segments_receive)
+plainmtp_3val segments_receive( segmented_receive_s* state, struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t segment_size, plainmtp_digest_s* digest
+) {
+  const uint64_t offset = state->offset;
+  plainmtp_3val result;
+  plainmtp_bool success;
+{
+  if ( (offset == 0) && !check_segment_offsets( cursor, device, segment_size ) ) {
+    return receive_whole_object( state, cursor, device, digest );
+  }
+
+  success = plainmtp_cursor_receive_range( cursor, device, offset, segment_size,
+    state->chunk_limit, &CB_segment_exchange, state );
+
+  if ( !success && !state->is_aborted && (offset == 0) && (state->buffer == NULL) ) {
+    /* The callback wasn't called yet, so it's still possible to receive the object as a whole,
+      which is the only way if the device doesn't support partial receiving. */
+    result = receive_whole_object( state, cursor, device, digest );
+
+    state->is_unranged = (result == PLAINMTP_GOOD);
+    return result;
+  }
+
+  success = success && !state->is_aborted;
+  if (success && (state->offset - offset == segment_size)) { return PLAINMTP_NONE; }
+
+  segments_finish( state );
+  if (digest != NULL) { PLAINMTP(digest_finish( &state->digest, digest )); }
+
+  return success ? PLAINMTP_GOOD : PLAINMTP_BAD;
+}}
+
+#ifdef PP_PLAINMTP_DATA_SEGMENTS_C_EX
+#include PP_PLAINMTP_DATA_SEGMENTS_C_EX
+#endif
@@ -0,0 +1,46 @@
+#ifndef ZZ_PLAINMTP_DATA_SEGMENTS_C_IG
+#define ZZ_PLAINMTP_DATA_SEGMENTS_C_IG
+#include "common.i.h"
+
+#include "plainmtp.h"
+#include "data_digest.c.h"
+
+/* State of an object being received in segments, so other operations can be performed on the device
+  in between. The user's callback sees the segments as a single data exchange. */
+typedef struct ZZ_PLAINMTP(segmented_receive_s) {
+  size_t chunk_limit;
+  plainmtp_data_f callback;
+  void* custom_state;
+
+  /* Amount of the object data that has been received so far. */
+  uint64_t offset;
+  digest_state_s digest;
+
+  /* The exchange buffers of the callback in "active" mode are requested only once per object. */
+  void* initial_buffer;
+  void* buffer;
+
+  /* The final call of the callback is made when all the segments are received. */
+  plainmtp_bool is_final_due;
+  plainmtp_bool is_aborted;
+
+  /* Set when a segment has failed while receiving of the whole object has succeeded. */
+  plainmtp_bool is_unranged;
+} segmented_receive_s;
+
+PLAINMTP_EXTERN void PLAINMTP(segments_start( segmented_receive_s* state, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, plainmtp_digest_e algorithm ));
+
+/* Returns PLAINMTP_NONE if there are more segments to receive. Otherwise, the callback has got its
+  final call, and the digest is filled if it's not NULL. If the first segment fails before the
+  callback is called, the object is received as a whole instead. */
+PLAINMTP_EXTERN plainmtp_3val PLAINMTP(segments_receive( segmented_receive_s* state,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, size_t segment_size,
+  plainmtp_digest_s* digest ));
+
+/* Makes the final call of the callback if it's still due, e.g. for an abandoned receive. */
+PLAINMTP_EXTERN void PLAINMTP(segments_finish( segmented_receive_s* state ));
+
+#else
+#error ZZ_PLAINMTP_DATA_SEGMENTS_C_IG
+#endif
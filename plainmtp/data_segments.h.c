@@ -0,0 +1,25 @@
+#include "data_segments.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+/* Devices that support partial receiving at all support it at the offsets below this one, while the
+  larger offsets need the GetPartialObject64 operation of Android. */
+#define SEGMENT_OFFSET_LIMIT ((uint64_t)1 << 32)
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_segment_exchange( void* data, size_t size,
+  void* custom_state ));
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_discard_data( void* data, size_t size, void* custom_state ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(check_segment_offsets( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t segment_size ));
+PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(receive_whole_object( segmented_receive_s* state,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device,
+  plainmtp_digest_s* digest ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -0,0 +1,142 @@
+#include "data_steps.h.c"
+
+#include <stdlib.h>
+#include <wchar.h>
+#include <assert.h>
+
+#define begin_exchange ZZ_PLAINMTP(begin_exchange)
+PLAINMTP_INTERNAL struct plainmtp_exchange_s* begin_exchange( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* name, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  struct plainmtp_exchange_s* exchange;
+  size_t length = (name != NULL) ? wcslen( name ) + 1 : 0;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+
+  exchange = malloc( sizeof(*exchange) + length * sizeof(wchar_t) );
+  if (exchange == NULL) { return NULL; }
+
+  exchange->cursor = plainmtp_cursor_assign( NULL, cursor );
+  if (exchange->cursor == NULL) {
+    free( exchange );
+    return NULL;
+  }
+
+  exchange->name = NULL;
+  if (name != NULL) { exchange->name = wcscpy( (wchar_t*)(exchange + 1), name ); }
+
+  exchange->device = device;
+  exchange->size = 0;
+  PLAINMTP(segments_start( &exchange->segments, chunk_limit, callback, custom_state,
+    PLAINMTP_DIGEST_NONE ));
+  exchange->status = PLAINMTP_NONE;
+  exchange->object = NULL;
+
+  return exchange;
+}}
+
+#define finish_exchange ZZ_PLAINMTP(finish_exchange)
+PLAINMTP_INTERNAL void finish_exchange( struct plainmtp_exchange_s* exchange,
+  plainmtp_bool success
+) {
+{
+  PLAINMTP(segments_finish( &exchange->segments ));
+
+  exchange->status = success ? PLAINMTP_GOOD : PLAINMTP_BAD;
+}}
+
+#define receive_exchange_step ZZ_PLAINMTP(receive_exchange_step)
+PLAINMTP_INTERNAL plainmtp_bool receive_exchange_step( struct plainmtp_exchange_s* exchange,
+  size_t step_size
+) {
+  plainmtp_3val status;
+{
+  status = PLAINMTP(segments_receive( &exchange->segments, exchange->cursor, exchange->device,
+    step_size, NULL ));
+
+  if (status == PLAINMTP_NONE) { return PLAINMTP_TRUE; }
+
+  exchange->status = status;
+  return PLAINMTP_FALSE;
+}}
+
+/**************************************************************************************************/
+
+struct plainmtp_exchange_s* plainmtp_exchange_begin_receive( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state
+) {
+{
+  assert( callback != NULL );
+
+  return begin_exchange( cursor, device, NULL, chunk_limit, callback, custom_state );
+}}
+
+struct plainmtp_exchange_s* plainmtp_exchange_begin_transfer( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  struct plainmtp_exchange_s* exchange;
+{
+  assert( name != NULL );
+  assert( (callback != NULL) || (size == 0) );
+
+  exchange = begin_exchange( parent, device, name, chunk_limit, callback, custom_state );
+  if (exchange != NULL) { exchange->size = size; }
+
+  return exchange;
+}}
+
+plainmtp_bool plainmtp_exchange_step( struct plainmtp_exchange_s* exchange, size_t step_size ) {
+  plainmtp_bool success;
+{
+  assert( exchange != NULL );
+  assert( step_size != 0 );
+
+  if (exchange->status != PLAINMTP_NONE) { return PLAINMTP_FALSE; }
+
+  if (exchange->name == NULL) { return receive_exchange_step( exchange, step_size ); }
+
+  /* The transfer makes the final call of the callback by itself. */
+  success = plainmtp_cursor_transfer( exchange->cursor, exchange->device, exchange->name,
+    exchange->size, exchange->segments.chunk_limit, exchange->segments.callback,
+    exchange->segments.custom_state, &exchange->object );
+
+  exchange->segments.is_final_due = PLAINMTP_FALSE;
+  finish_exchange( exchange, success );
+  return PLAINMTP_FALSE;
+}}
+
+plainmtp_bool plainmtp_exchange_end( struct plainmtp_exchange_s* exchange,
+  struct plainmtp_cursor_s** SET_cursor
+) {
+  plainmtp_bool result;
+{
+  assert( exchange != NULL );
+
+  /* An unfinished exchange is aborted, but the callback still gets its final call. */
+  if (exchange->status == PLAINMTP_NONE) { finish_exchange( exchange, PLAINMTP_FALSE ); }
+  result = (exchange->status == PLAINMTP_GOOD);
+
+  if ( (SET_cursor != NULL) && (exchange->object != NULL) ) {
+    if (*SET_cursor == NULL) {
+      *SET_cursor = exchange->object;
+      exchange->object = NULL;
+    } else if (plainmtp_cursor_assign( *SET_cursor, exchange->object ) == NULL) {
+      (void)plainmtp_cursor_assign( *SET_cursor, NULL );
+      *SET_cursor = NULL;
+    }
+  }
+
+  if (exchange->object != NULL) { (void)plainmtp_cursor_assign( exchange->object, NULL ); }
+  (void)plainmtp_cursor_assign( exchange->cursor, NULL );
+  free( exchange );
+
+  return result;
+}}
+
+#ifdef PP_PLAINMTP_DATA_STEPS_C_EX
+#include PP_PLAINMTP_DATA_STEPS_C_EX
+#endif
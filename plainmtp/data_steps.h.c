@@ -0,0 +1,39 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+#include "data_segments.c.h"
+
+struct plainmtp_exchange_s {
+  struct plainmtp_device_s* device;
+
+  /* The object to be received, or the parent entity of the object to be transferred. */
+  struct plainmtp_cursor_s* cursor;
+
+  /* If NULL, this is a receiving exchange. The name is stored in the same memory block right after
+    the exchange. */
+  wchar_t* name;
+  uint64_t size;
+
+  /* The steps of a receiving exchange are its segments. A transferring one keeps the callback here
+    as well, so it still gets its final call if the exchange ends before the transfer. */
+  segmented_receive_s segments;
+
+  /* PLAINMTP_NONE while the exchange is in progress. */
+  plainmtp_3val status;
+
+  /* The transferred object. */
+  struct plainmtp_cursor_s* object;
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN struct plainmtp_exchange_s* ZZ_PLAINMTP(begin_exchange(
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, const wchar_t* name,
+  size_t chunk_limit, plainmtp_data_f callback, void* custom_state ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(finish_exchange( struct plainmtp_exchange_s* exchange,
+  plainmtp_bool success ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(receive_exchange_step(
+  struct plainmtp_exchange_s* exchange, size_t step_size ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -0,0 +1,45 @@
+#include "device_filters.c.h"
+
+#include <wchar.h>
+
+#define match_device_filters PLAINMTP(match_device_filters)
+plainmtp_3val match_device_filters( const plainmtp_startup_s* options,
+  const plainmtp_filter_s* device, plainmtp_bool has_location
+) {
+  const plainmtp_filter_s* filter;
+  plainmtp_3val result = PLAINMTP_BAD;
+  size_t i;
+{
+  if ( (options == NULL) || (options->filter_count == 0) ) { return PLAINMTP_GOOD; }
+
+  for (i = 0; i < options->filter_count; ++i) {
+    filter = &options->filters[i];
+
+    if ( (filter->vendor_id != 0) && (filter->vendor_id != device->vendor_id) ) { continue; }
+    if ( (filter->product_id != 0) && (filter->product_id != device->product_id) ) { continue; }
+
+    if (has_location) {
+      if ( (filter->bus_location != 0) && (filter->bus_location != device->bus_location) ) {
+        continue;
+      }
+
+      if ( (filter->device_number != 0) && (filter->device_number != device->device_number) ) {
+        continue;
+      }
+    }
+
+    if (filter->serial_number == NULL) { return PLAINMTP_GOOD; }
+
+    if (device->serial_number == NULL) {
+      result = PLAINMTP_NONE;
+    } else if (wcscmp( filter->serial_number, device->serial_number ) == 0) {
+      return PLAINMTP_GOOD;
+    }
+  }
+
+  return result;
+}}
+
+#ifdef PP_PLAINMTP_DEVICE_FILTERS_C_EX
+#include PP_PLAINMTP_DEVICE_FILTERS_C_EX
+#endif
@@ -0,0 +1,14 @@
+#ifndef ZZ_PLAINMTP_DEVICE_FILTERS_C_IG
+#define ZZ_PLAINMTP_DEVICE_FILTERS_C_IG
+#include "common.i.h"
+
+#include "plainmtp.h"
+
+/* The device is described with the filter structure itself, where the serial number is NULL if
+  it's not known yet. Returns PLAINMTP_NONE if the result depends on the serial number then. */
+PLAINMTP_EXTERN plainmtp_3val PLAINMTP(match_device_filters( const plainmtp_startup_s* options,
+  const plainmtp_filter_s* device, plainmtp_bool has_location ));
+
+#else
+#error ZZ_PLAINMTP_DEVICE_FILTERS_C_IG
+#endif
@@ -0,0 +1,232 @@
+/* NB: clock_gettime() is not a part of the C standard, so it has to be requested explicitly. */
+#ifndef _WIN32
+  #define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "device_stats.c.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "host_files.c.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <Windows.h>
+#else
+  #include <time.h>
+#endif
+
+#define get_monotonic_time PLAINMTP(get_monotonic_time)
+uint64_t get_monotonic_time(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER frequency = {0};
+  LARGE_INTEGER counter;
+#else
+  struct timespec counter;
+#endif
+{
+#ifdef _WIN32
+  /* The frequency is fixed at system boot, so it's enough to query it only once. */
+  if (frequency.QuadPart == 0) { (void)QueryPerformanceFrequency( &frequency ); }
+  (void)QueryPerformanceCounter( &counter );
+
+  /* Split the conversion to avoid overflow of the intermediate product. */
+  return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000
+    + (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+  if (clock_gettime( CLOCK_MONOTONIC, &counter ) != 0) { return 0; }
+  return (uint64_t)counter.tv_sec * 1000000 + (uint64_t)(counter.tv_nsec / 1000);
+#endif
+}}
+
+#define account_operation PLAINMTP(account_operation)
+void account_operation( plainmtp_stats_s* stats, plainmtp_operation_e kind,
+  uint64_t elapsed_time, plainmtp_bool success
+) {
+  uint64_t bucket_limit = 10;
+  size_t bucket = 0;
+{
+  ++stats->operations[kind].count;
+  if (!success) { ++stats->operations[kind].failures; }
+
+  stats->operations[kind].total_time += elapsed_time;
+  if (stats->operations[kind].peak_time < elapsed_time) {
+    stats->operations[kind].peak_time = elapsed_time;
+  }
+
+  while ( (bucket < PLAINMTP_STATS_HISTOGRAM_SIZE-1) && (elapsed_time >= bucket_limit) ) {
+    bucket_limit *= 10;
+    ++bucket;
+  }
+
+  ++stats->operations[kind].histogram[bucket];
+}}
+
+#define account_data_exchange PLAINMTP(account_data_exchange)
+void account_data_exchange( plainmtp_stats_s* stats, plainmtp_operation_e kind,
+  uint64_t start_time, uint64_t callback_time, uint64_t bytes, plainmtp_bool success
+) {
+  const uint64_t elapsed_time = get_monotonic_time() - start_time;
+{
+  account_operation( stats, kind, elapsed_time, success );
+
+  if (kind == PLAINMTP_OPERATION_RECEIVE) {
+    stats->bytes_received += bytes;
+  } else {
+    stats->bytes_transferred += bytes;
+  }
+
+  /* The clock is monotonic, but still may be too coarse to measure very quick callbacks. */
+  if (callback_time > elapsed_time) { callback_time = elapsed_time; }
+
+  stats->callback_time += callback_time;
+  stats->device_time += elapsed_time - callback_time;
+}}
+
+#define trace_device_call PLAINMTP(trace_device_call)
+uint64_t trace_device_call( plainmtp_stats_s* stats, device_trace_s* trace, const char* name,
+  uint64_t start_time, plainmtp_bool success
+) {
+  const uint64_t elapsed_time = get_monotonic_time() - start_time;
+  trace_event_s* event;
+{
+  ++stats->round_trips;
+  if (trace->events == NULL) { return elapsed_time; }
+
+  if (trace->count == trace->capacity) {
+    ++trace->dropped_count;
+    return elapsed_time;
+  }
+
+  event = &trace->events[trace->count++];
+  event->name = name;
+  event->api_name = (trace->api_depth > 0) ? trace->api_name : NULL;
+  event->start_time = start_time;
+  event->elapsed_time = elapsed_time;
+  event->success = success;
+  event->is_api_call = PLAINMTP_FALSE;
+
+  return elapsed_time;
+}}
+
+#define account_device_call PLAINMTP(account_device_call)
+void account_device_call( plainmtp_stats_s* stats, device_trace_s* trace,
+  plainmtp_operation_e kind, const char* name, uint64_t start_time, plainmtp_bool success
+) {
+{
+  account_operation( stats, kind, trace_device_call( stats, trace, name, start_time, success ),
+    success );
+}}
+
+#define enter_api_call PLAINMTP(enter_api_call)
+void enter_api_call( device_trace_s* trace, const char* name ) {
+{
+  if (trace->api_depth++ > 0) { return; }
+
+  trace->api_name = name;
+  trace->api_start_time = get_monotonic_time();
+}}
+
+#define leave_api_call PLAINMTP(leave_api_call)
+void leave_api_call( device_trace_s* trace ) {
+  trace_event_s* event;
+{
+  if ( (--trace->api_depth > 0) || (trace->events == NULL) ) { return; }
+
+  if (trace->count == trace->capacity) {
+    ++trace->dropped_count;
+    return;
+  }
+
+  event = &trace->events[trace->count++];
+  event->name = trace->api_name;
+  event->api_name = NULL;
+  event->start_time = trace->api_start_time;
+  event->elapsed_time = get_monotonic_time() - trace->api_start_time;
+  event->success = PLAINMTP_TRUE;
+  event->is_api_call = PLAINMTP_TRUE;
+}}
+
+#define start_device_trace PLAINMTP(start_device_trace)
+plainmtp_bool start_device_trace( device_trace_s* trace, size_t capacity ) {
+  trace_event_s* events;
+{
+  if ( (capacity == 0) || (capacity > (size_t)-1 / sizeof(*events)) ) { return PLAINMTP_FALSE; }
+
+  events = malloc( capacity * sizeof(*events) );
+  if (events == NULL) { return PLAINMTP_FALSE; }
+
+  free( trace->events );
+  trace->events = events;
+  trace->count = 0;
+  trace->capacity = capacity;
+  trace->dropped_count = 0;
+  trace->origin_time = get_monotonic_time();
+
+  return PLAINMTP_TRUE;
+}}
+
+/* The events are written in the Chrome trace event format, as the "complete" ones on a single
+  thread, so the calls to the underlying library are nested in the API calls that have made them.
+  The timestamps are in microseconds since the start of the recording, just as the format wants. */
+#define write_device_trace PLAINMTP(write_device_trace)
+plainmtp_bool write_device_trace( const device_trace_s* trace, FILE* file ) {
+  const trace_event_s* event;
+  size_t i;
+{
+  if (fputs( "{\"traceEvents\": [", file ) < 0) { return PLAINMTP_FALSE; }
+
+  for (i = 0; i < trace->count; ++i) {
+    event = &trace->events[i];
+
+    if ( fprintf( file, "%s\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+        "\"tid\": 1, \"ts\": %"PRINTF_INT64_MODIFIER"u, \"dur\": %"PRINTF_INT64_MODIFIER"u",
+        (i > 0) ? "," : "", event->name, event->is_api_call ? "api" : "device",
+        event->start_time - trace->origin_time, event->elapsed_time ) < 0
+    ) {
+      return PLAINMTP_FALSE;
+    }
+
+    if (!event->is_api_call) {
+      if ( fprintf( file, ", \"args\": {\"api\": \"%s\", \"success\": %s}",
+          (event->api_name != NULL) ? event->api_name : "", event->success ? "true" : "false"
+        ) < 0
+      ) {
+        return PLAINMTP_FALSE;
+      }
+    }
+
+    if (fputc( '}', file ) == EOF) { return PLAINMTP_FALSE; }
+  }
+
+  return fprintf( file, "\n], \"otherData\": {\"dropped_events\": %lu}}\n",
+    (unsigned long)trace->dropped_count ) >= 0;
+}}
+
+#define stop_device_trace PLAINMTP(stop_device_trace)
+plainmtp_bool stop_device_trace( device_trace_s* trace, const wchar_t* path ) {
+  plainmtp_bool result = PLAINMTP_TRUE;
+  FILE* file;
+{
+  if (path != NULL) {
+    file = (trace->events != NULL) ? PLAINMTP(open_host_file( path, PLAINMTP_TRUE )) : NULL;
+    result = (file != NULL) && write_device_trace( trace, file );
+
+    if ( (file != NULL) && ( (fclose( file ) != 0) || !result ) ) {
+      PLAINMTP(remove_host_file( path ));
+      result = PLAINMTP_FALSE;
+    }
+  }
+
+  free( trace->events );
+  trace->events = NULL;
+  trace->count = 0;
+  trace->capacity = 0;
+
+  return result;
+}}
+
+#ifdef PP_PLAINMTP_DEVICE_STATS_C_EX
+#include PP_PLAINMTP_DEVICE_STATS_C_EX
+#endif
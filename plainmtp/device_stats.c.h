@@ -0,0 +1,63 @@
+#ifndef ZZ_PLAINMTP_DEVICE_STATS_C_IG
+#define ZZ_PLAINMTP_DEVICE_STATS_C_IG
+#include "common.i.h"
+
+#include <stdio.h>
+#include <wchar.h>
+
+#include "plainmtp.h"
+
+/* A call to the underlying library that communicates with the device, or a span of the API call
+  that has made such calls. */
+typedef struct ZZ_PLAINMTP(trace_event_s) {
+  const char* name;
+  const char* api_name;  /* The API call that has made it, or NULL if there was none. */
+  uint64_t start_time;
+  uint64_t elapsed_time;
+  plainmtp_bool success;
+  plainmtp_bool is_api_call;
+} trace_event_s;
+
+/* Events are recorded only while there's a buffer for them, which is never reallocated, so the
+  ones beyond its capacity are dropped. Nested API calls are attributed to the outermost one. A
+  zero-initialized trace doesn't record anything. */
+typedef struct ZZ_PLAINMTP(device_trace_s) {
+  trace_event_s* events;
+  size_t count;
+  size_t capacity;
+  uint32_t dropped_count;
+  uint64_t origin_time;
+
+  const char* api_name;
+  uint64_t api_start_time;
+  size_t api_depth;
+} device_trace_s;
+
+PLAINMTP_EXTERN uint64_t PLAINMTP(get_monotonic_time(void));
+PLAINMTP_EXTERN void PLAINMTP(account_operation( plainmtp_stats_s* stats,
+  plainmtp_operation_e kind, uint64_t elapsed_time, plainmtp_bool success ));
+PLAINMTP_EXTERN void PLAINMTP(account_data_exchange( plainmtp_stats_s* stats,
+  plainmtp_operation_e kind, uint64_t start_time, uint64_t callback_time, uint64_t bytes,
+  plainmtp_bool success ));
+
+/* Both account a single call to the underlying library that communicates with the device, the
+  former when it's a data exchange that is accounted by account_data_exchange() anyway. It returns
+  the time elapsed since the start of the call. */
+PLAINMTP_EXTERN uint64_t PLAINMTP(trace_device_call( plainmtp_stats_s* stats, device_trace_s* trace,
+  const char* name, uint64_t start_time, plainmtp_bool success ));
+PLAINMTP_EXTERN void PLAINMTP(account_device_call( plainmtp_stats_s* stats, device_trace_s* trace,
+  plainmtp_operation_e kind, const char* name, uint64_t start_time, plainmtp_bool success ));
+
+PLAINMTP_EXTERN void PLAINMTP(enter_api_call( device_trace_s* trace, const char* name ));
+PLAINMTP_EXTERN void PLAINMTP(leave_api_call( device_trace_s* trace ));
+
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(start_device_trace( device_trace_s* trace,
+  size_t capacity ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(write_device_trace( const device_trace_s* trace,
+  FILE* file ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(stop_device_trace( device_trace_s* trace,
+  const wchar_t* path ));
+
+#else
+#error ZZ_PLAINMTP_DEVICE_STATS_C_IG
+#endif
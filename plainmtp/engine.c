@@ -0,0 +1,373 @@
+#include "engine.h.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define insert_pending_job ZZ_PLAINMTP(insert_pending_job)
+PLAINMTP_INTERNAL void insert_pending_job( struct plainmtp_engine_s* engine,
+  pending_job_s* node
+) {
+  pending_job_s** link = &engine->first;
+{
+  /* Jobs with the same priority are executed in the order they were enqueued. */
+  while ( (*link != NULL) && ((*link)->copy->priority >= node->copy->priority) ) {
+    link = &(*link)->next;
+  }
+
+  node->next = *link;
+  *link = node;
+
+  ++engine->jobs_pending;
+  if (node->device_index != PLAINMTP_ANY_DEVICE) {
+    ++engine->workers[node->device_index].jobs_pending;
+  }
+}}
+
+/* If 'is_preempting' is set, only a job with a higher priority than the given one is taken. */
+#define take_pending_job ZZ_PLAINMTP(take_pending_job)
+PLAINMTP_INTERNAL pending_job_s* take_pending_job( struct plainmtp_engine_s* engine,
+  size_t device_index, plainmtp_bool is_preempting, int priority
+) {
+  pending_job_s **link = &engine->first, *node;
+{
+  while (*link != NULL) {
+    node = *link;
+    if ( is_preempting && (node->copy->priority <= priority) ) { break; }
+
+    if ( (node->device_index == device_index) || (node->device_index == PLAINMTP_ANY_DEVICE) ) {
+      *link = node->next;
+
+      --engine->jobs_pending;
+      if (node->device_index != PLAINMTP_ANY_DEVICE) {
+        --engine->workers[device_index].jobs_pending;
+      }
+
+      return node;
+    }
+
+    link = &node->next;
+  }
+
+  return NULL;
+}}
+
+#define take_orphaned_jobs ZZ_PLAINMTP(take_orphaned_jobs)
+PLAINMTP_INTERNAL pending_job_s* take_orphaned_jobs( struct plainmtp_engine_s* engine ) {
+  pending_job_s **link = &engine->first, *node, *result = NULL;
+  plainmtp_bool has_workers = PLAINMTP_FALSE;
+  size_t i;
+{
+  for (i = 0; i < engine->worker_count; ++i) {
+    if (WORKER_IS_ALIVE( &engine->workers[i] )) { has_workers = PLAINMTP_TRUE; }
+  }
+
+  /* Jobs for any device are orphaned only if there are no workers left to execute them at all. */
+  while (*link != NULL) {
+    node = *link;
+
+    if ( (node->device_index == PLAINMTP_ANY_DEVICE) ? !has_workers
+      : !WORKER_IS_ALIVE( &engine->workers[node->device_index] )
+    ) {
+      *link = node->next;
+
+      --engine->jobs_pending;
+      if (node->device_index != PLAINMTP_ANY_DEVICE) {
+        --engine->workers[node->device_index].jobs_pending;
+      }
+
+      node->next = result;
+      result = node;
+      continue;
+    }
+
+    link = &node->next;
+  }
+
+  return result;
+}}
+
+#define discard_pending_jobs ZZ_PLAINMTP(discard_pending_jobs)
+PLAINMTP_INTERNAL void discard_pending_jobs( pending_job_s* chain ) {
+  pending_job_s* node;
+{
+  while (chain != NULL) {
+    node = chain;
+    chain = node->next;
+
+    PLAINMTP(discard_job_copy( node->copy ));
+    free( node );
+  }
+}}
+
+#define CB_run_worker ZZ_PLAINMTP(cb_run_worker)
+PLAINMTP_INTERNAL void CB_run_worker( void* argument ) {
+  engine_worker_s* worker = argument;
+  struct plainmtp_engine_s* engine = worker->engine;
+  const size_t index = (size_t)(worker - engine->workers);
+  pending_job_s* node = NULL;
+  plainmtp_stats_s stats;
+  size_t jobs_queued, jobs_left;
+  int priority;
+{
+  /* NB: Sessions are established by the workers themselves, as this is the longest part of the
+    startup, and so it's performed for all the devices in parallel. */
+  worker->device = plainmtp_device_start( engine->context, worker->endpoint_index,
+    engine->read_only );
+  worker->queue = (worker->device != NULL) ? plainmtp_queue_create( worker->device ) : NULL;
+
+  if ( (worker->queue == NULL) && (worker->device != NULL) ) {
+    plainmtp_device_finish( worker->device );
+  }
+
+  PLAINMTP(mutex_lock( engine->lock ));
+
+  if (worker->queue == NULL) {
+    worker->state = WORKER_FAILED;
+    node = take_orphaned_jobs( engine );
+    PLAINMTP(condition_broadcast( engine->idle_signal ));
+    PLAINMTP(mutex_unlock( engine->lock ));
+
+    discard_pending_jobs( node );
+    return;
+  }
+
+  worker->state = WORKER_READY;
+
+  for (;;) {
+    while ( !engine->is_stopping
+      && ( (node = take_pending_job( engine, index, PLAINMTP_FALSE, 0 )) == NULL )
+    ) {
+      PLAINMTP(condition_wait( engine->job_signal, engine->lock ));
+    }
+
+    if (engine->is_stopping) { break; }
+
+    worker->is_busy = PLAINMTP_TRUE;
+    ++engine->jobs_running;
+    priority = node->copy->priority;
+    jobs_queued = 1;
+    PLAINMTP(mutex_unlock( engine->lock ));
+
+    PLAINMTP(adopt_job_copy( worker->queue, node->copy ));
+    free( node );
+
+    while (plainmtp_queue_run( worker->queue, 1 ) != 0) {
+      plainmtp_device_get_stats( worker->device, &stats );
+      jobs_left = PLAINMTP(count_queued_jobs( worker->queue ));
+
+      PLAINMTP(mutex_lock( engine->lock ));
+      worker->bytes_received = stats.bytes_received;
+      worker->bytes_transferred = stats.bytes_transferred;
+      engine->jobs_running -= jobs_queued - jobs_left;
+      worker->jobs_finished += jobs_queued - jobs_left;
+      jobs_queued = jobs_left;
+
+      /* Jobs with a higher priority that were pushed meanwhile are executed before the rest of the
+        current one, rather than after it's completed. The others remain pending, so jobs for any
+        device can still be taken by the workers that become idle. */
+      while ( (node = take_pending_job( engine, index, PLAINMTP_TRUE, priority )) != NULL ) {
+        ++engine->jobs_running;
+        ++jobs_queued;
+        PLAINMTP(adopt_job_copy( worker->queue, node->copy ));
+        free( node );
+      }
+
+      PLAINMTP(mutex_unlock( engine->lock ));
+    }
+
+    PLAINMTP(mutex_lock( engine->lock ));
+    worker->is_busy = PLAINMTP_FALSE;
+    PLAINMTP(condition_broadcast( engine->idle_signal ));
+  }
+
+  PLAINMTP(mutex_unlock( engine->lock ));
+
+  plainmtp_queue_destroy( worker->queue );
+  plainmtp_device_finish( worker->device );
+}}
+
+/**************************************************************************************************/
+
+struct plainmtp_engine_s* plainmtp_engine_create( struct plainmtp_context_s* context,
+  const size_t* endpoint_indices, size_t endpoint_count, plainmtp_bool read_only
+) {
+  plainmtp_context_s* const registry = (plainmtp_context_s*)context;
+  struct plainmtp_engine_s* engine;
+  engine_worker_s* worker;
+  size_t i;
+{
+  assert( context != NULL );
+
+  if (endpoint_indices == NULL) { endpoint_count = registry->endpoints.count; }
+
+  engine = malloc( sizeof(*engine) + endpoint_count * sizeof(*worker) );
+  if (engine == NULL) { goto failed; }
+
+  engine->lock = PLAINMTP(mutex_create());
+  if (engine->lock == NULL) { goto failed_lock; }
+
+  engine->job_signal = PLAINMTP(condition_create());
+  if (engine->job_signal == NULL) { goto failed_job_signal; }
+
+  engine->idle_signal = PLAINMTP(condition_create());
+  if (engine->idle_signal == NULL) { goto failed_idle_signal; }
+
+  engine->context = context;
+  engine->read_only = read_only;
+  engine->first = NULL;
+  engine->jobs_pending = 0;
+  engine->jobs_running = 0;
+  engine->is_stopping = PLAINMTP_FALSE;
+  engine->worker_count = endpoint_count;
+  engine->workers = (engine_worker_s*)(engine + 1);
+
+  for (i = 0; i < endpoint_count; ++i) {
+    worker = &engine->workers[i];
+    memset( worker, 0, sizeof(*worker) );
+
+    worker->engine = engine;
+    worker->endpoint_index = (endpoint_indices != NULL) ? endpoint_indices[i] : i;
+    worker->state = WORKER_STARTING;
+    assert( worker->endpoint_index < registry->endpoints.count );
+  }
+
+  /* The workers are started only after all of them are set up, as they access each other. */
+  PLAINMTP(mutex_lock( engine->lock ));
+
+  for (i = 0; i < endpoint_count; ++i) {
+    worker = &engine->workers[i];
+    worker->thread = PLAINMTP(thread_start( &CB_run_worker, worker ));
+    if (worker->thread == NULL) { worker->state = WORKER_FAILED; }
+  }
+
+  PLAINMTP(mutex_unlock( engine->lock ));
+  return engine;
+
+failed_idle_signal:
+  PLAINMTP(condition_destroy( engine->job_signal ));
+failed_job_signal:
+  PLAINMTP(mutex_destroy( engine->lock ));
+failed_lock:
+  free( engine );
+failed:
+  return NULL;
+}}
+
+void plainmtp_engine_destroy( struct plainmtp_engine_s* engine ) {
+  size_t i;
+{
+  assert( engine != NULL );
+
+  PLAINMTP(mutex_lock( engine->lock ));
+  engine->is_stopping = PLAINMTP_TRUE;
+  PLAINMTP(condition_broadcast( engine->job_signal ));
+  PLAINMTP(mutex_unlock( engine->lock ));
+
+  for (i = 0; i < engine->worker_count; ++i) {
+    if (engine->workers[i].thread != NULL) { PLAINMTP(thread_join( engine->workers[i].thread )); }
+  }
+
+  /* There are no workers anymore, so there's no need to lock. */
+  discard_pending_jobs( engine->first );
+
+  PLAINMTP(condition_destroy( engine->idle_signal ));
+  PLAINMTP(condition_destroy( engine->job_signal ));
+  PLAINMTP(mutex_destroy( engine->lock ));
+  free( engine );
+}}
+
+plainmtp_bool plainmtp_engine_push( struct plainmtp_engine_s* engine, const plainmtp_job_s* job,
+  size_t device_index
+) {
+  pending_job_s* node;
+  plainmtp_bool result = PLAINMTP_FALSE;
+  size_t i;
+{
+  assert( engine != NULL );
+  assert( job != NULL );
+  assert( (device_index == PLAINMTP_ANY_DEVICE) || (device_index < engine->worker_count) );
+  assert( (job->target.cursor == NULL) || (device_index != PLAINMTP_ANY_DEVICE) );
+
+  node = malloc( sizeof(*node) );
+  if (node == NULL) { return PLAINMTP_FALSE; }
+
+  node->device_index = device_index;
+  node->copy = NULL;
+
+  PLAINMTP(mutex_lock( engine->lock ));
+
+  if (device_index != PLAINMTP_ANY_DEVICE) {
+    result = WORKER_IS_ALIVE( &engine->workers[device_index] );
+  } else {
+    for (i = 0; i < engine->worker_count; ++i) {
+      if (WORKER_IS_ALIVE( &engine->workers[i] )) { result = PLAINMTP_TRUE; }
+    }
+  }
+
+  /* The job is copied under the lock, so the worker can't fail in the meantime. */
+  if (result) {
+    node->copy = PLAINMTP(make_job_copy( job ));
+    result = (node->copy != NULL);
+  }
+
+  if (result) {
+    insert_pending_job( engine, node );
+    PLAINMTP(condition_broadcast( engine->job_signal ));
+  }
+
+  PLAINMTP(mutex_unlock( engine->lock ));
+
+  if (!result) { free( node ); }
+  return result;
+}}
+
+void plainmtp_engine_wait( struct plainmtp_engine_s* engine ) {
+{
+  assert( engine != NULL );
+
+  PLAINMTP(mutex_lock( engine->lock ));
+
+  while ( (engine->first != NULL) || (engine->jobs_running != 0) ) {
+    PLAINMTP(condition_wait( engine->idle_signal, engine->lock ));
+  }
+
+  PLAINMTP(mutex_unlock( engine->lock ));
+}}
+
+void plainmtp_engine_get_progress( struct plainmtp_engine_s* engine, size_t device_index,
+  plainmtp_progress_s* OUT_progress
+) {
+  engine_worker_s* worker;
+  size_t i;
+{
+  assert( engine != NULL );
+  assert( (device_index == PLAINMTP_ANY_DEVICE) || (device_index < engine->worker_count) );
+  assert( OUT_progress != NULL );
+
+  memset( OUT_progress, 0, sizeof(*OUT_progress) );
+
+  PLAINMTP(mutex_lock( engine->lock ));
+
+  for (i = 0; i < engine->worker_count; ++i) {
+    if ( (device_index != PLAINMTP_ANY_DEVICE) && (device_index != i) ) { continue; }
+    worker = &engine->workers[i];
+
+    if (worker->state == WORKER_READY) { ++OUT_progress->devices_ready; }
+    if (worker->state == WORKER_FAILED) { ++OUT_progress->devices_failed; }
+    if (worker->is_busy) { ++OUT_progress->jobs_running; }
+
+    OUT_progress->jobs_pending += worker->jobs_pending;
+    OUT_progress->jobs_finished += worker->jobs_finished;
+    OUT_progress->bytes_received += worker->bytes_received;
+    OUT_progress->bytes_transferred += worker->bytes_transferred;
+  }
+
+  if (device_index == PLAINMTP_ANY_DEVICE) { OUT_progress->jobs_pending = engine->jobs_pending; }
+
+  PLAINMTP(mutex_unlock( engine->lock ));
+}}
+
+#ifdef PP_PLAINMTP_ENGINE_C_EX
+#include PP_PLAINMTP_ENGINE_C_EX
+#endif
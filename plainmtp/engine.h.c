@@ -0,0 +1,88 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include "threads.c.h"
+#include "job_queue.c.h"
+
+#define WORKER_IS_ALIVE( Worker ) \
+  ( (Worker)->state != WORKER_FAILED )
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+typedef enum ZZ_PLAINMTP(worker_state_e) {
+  WORKER_STARTING,
+  WORKER_READY,
+  WORKER_FAILED
+} worker_state_e;
+
+typedef struct ZZ_PLAINMTP(pending_job_s) {
+  plainmtp_job_s* copy;
+
+  /* Position of the worker the job is targeted to, or PLAINMTP_ANY_DEVICE. */
+  size_t device_index;
+
+  struct ZZ_PLAINMTP(pending_job_s)* next;
+} pending_job_s;
+
+typedef struct ZZ_PLAINMTP(engine_worker_s) {
+  struct plainmtp_engine_s* engine;
+  size_t endpoint_index;
+  thread_s* thread;
+
+  /* These are used only by the worker thread itself, so they're not protected by the lock. */
+  struct plainmtp_device_s* device;
+  struct plainmtp_queue_s* queue;
+
+  worker_state_e state;
+  plainmtp_bool is_busy;
+
+  /* Jobs targeted to this worker only, so they aren't included in the ones for any device. */
+  size_t jobs_pending;
+  size_t jobs_finished;
+
+  /* Copied from the device statistics after each step, as the device is used by the worker only. */
+  uint64_t bytes_received;
+  uint64_t bytes_transferred;
+} engine_worker_s;
+
+struct plainmtp_engine_s {
+  struct plainmtp_context_s* context;
+  plainmtp_bool read_only;
+
+  /* Protects everything below, except for the fields of the workers that are noted otherwise. */
+  mutex_s* lock;
+
+  /* Signaled when there's a new job or the engine is stopping, and when a job is finished. */
+  condition_s* job_signal;
+  condition_s* idle_signal;
+
+  /* Jobs sorted by their priorities. */
+  pending_job_s* first;
+  size_t jobs_pending;
+  size_t jobs_running;
+
+  plainmtp_bool is_stopping;
+
+  size_t worker_count;
+  engine_worker_s* workers;  /* Stored in the same memory block right after the engine. */
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN void ZZ_PLAINMTP(insert_pending_job( struct plainmtp_engine_s* engine,
+  pending_job_s* node ));
+PLAINMTP_EXTERN pending_job_s* ZZ_PLAINMTP(take_pending_job( struct plainmtp_engine_s* engine,
+  size_t device_index, plainmtp_bool is_preempting, int priority ));
+PLAINMTP_EXTERN pending_job_s* ZZ_PLAINMTP(take_orphaned_jobs(
+  struct plainmtp_engine_s* engine ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(discard_pending_jobs( pending_job_s* chain ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(cb_run_worker( void* argument ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
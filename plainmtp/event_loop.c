@@ -0,0 +1,356 @@
+/* NB: The pipe is set up with fcntl(), which is a POSIX extension to the standard C library. */
+#ifndef _WIN32
+  #define _XOPEN_SOURCE 500
+#endif
+
+#include "event_loop.h.c"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#ifndef _WIN32
+  #include <unistd.h>
+  #include <fcntl.h>
+#endif
+
+#define open_signal ZZ_PLAINMTP(open_signal)
+PLAINMTP_INTERNAL plainmtp_bool open_signal( struct plainmtp_events_s* events ) {
+#ifndef _WIN32
+  int i;
+#endif
+{
+#ifdef _WIN32
+  events->handle = CreateEventW( NULL, TRUE, FALSE, NULL );
+  return (events->handle != NULL);
+#else
+  if (pipe( events->pipe_fds ) != 0) { return PLAINMTP_FALSE; }
+
+  /* The pipe never holds more than a single byte, but the loop must never block on reading it. */
+  for (i = 0; i < 2; ++i) {
+    if ( (fcntl( events->pipe_fds[i], F_SETFL, O_NONBLOCK ) == -1)
+      || (fcntl( events->pipe_fds[i], F_SETFD, FD_CLOEXEC ) == -1)
+    ) {
+      (void)close( events->pipe_fds[0] );
+      (void)close( events->pipe_fds[1] );
+      return PLAINMTP_FALSE;
+    }
+  }
+
+  return PLAINMTP_TRUE;
+#endif
+}}
+
+#define close_signal ZZ_PLAINMTP(close_signal)
+PLAINMTP_INTERNAL void close_signal( struct plainmtp_events_s* events ) {
+{
+#ifdef _WIN32
+  (void)CloseHandle( events->handle );
+#else
+  (void)close( events->pipe_fds[0] );
+  (void)close( events->pipe_fds[1] );
+#endif
+}}
+
+#define raise_signal ZZ_PLAINMTP(raise_signal)
+PLAINMTP_INTERNAL void raise_signal( struct plainmtp_events_s* events ) {
+#ifndef _WIN32
+  static const char token = 0;
+#endif
+{
+  if (events->is_signaled) { return; }
+  events->is_signaled = PLAINMTP_TRUE;
+
+#ifdef _WIN32
+  (void)SetEvent( events->handle );
+#else
+  (void)write( events->pipe_fds[1], &token, sizeof(token) );
+#endif
+}}
+
+#define clear_signal ZZ_PLAINMTP(clear_signal)
+PLAINMTP_INTERNAL void clear_signal( struct plainmtp_events_s* events ) {
+#ifndef _WIN32
+  char token;
+#endif
+{
+  if (!events->is_signaled) { return; }
+  events->is_signaled = PLAINMTP_FALSE;
+
+#ifdef _WIN32
+  (void)ResetEvent( events->handle );
+#else
+  while (read( events->pipe_fds[0], &token, sizeof(token) ) > 0) {}
+#endif
+}}
+
+#define post_completion ZZ_PLAINMTP(post_completion)
+PLAINMTP_INTERNAL void post_completion( struct plainmtp_events_s* events, completion_s* node ) {
+{
+  node->next = NULL;
+
+  PLAINMTP(mutex_lock( events->lock ));
+
+  if (events->first == NULL) {
+    events->first = node;
+  } else {
+    events->last->next = node;
+  }
+
+  events->last = node;
+  raise_signal( events );
+
+  PLAINMTP(mutex_unlock( events->lock ));
+}}
+
+#define CB_forward_data ZZ_PLAINMTP(cb_forward_data)
+PLAINMTP_INTERNAL void* CB_forward_data( void* data, size_t size, void* custom_state ) {
+  async_request_s* request = custom_state;
+{
+  return request->callback( data, size, request->final.custom_state );
+}}
+
+#define CB_resolve_target ZZ_PLAINMTP(cb_resolve_target)
+PLAINMTP_INTERNAL plainmtp_bool CB_resolve_target( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device
+) {
+{
+  /* The target is already resolved by the queue, and the cursor is reported when it's done. */
+  return PLAINMTP_TRUE;
+  (void)job; (void)cursor; (void)device;
+}}
+
+#define CB_select_children ZZ_PLAINMTP(cb_select_children)
+PLAINMTP_INTERNAL plainmtp_bool CB_select_children( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device
+) {
+  async_request_s* request = job->custom_state;
+  completion_s* node;
+{
+  while (plainmtp_cursor_select( cursor, device )) {
+    node = malloc( sizeof(*node) );
+    if (node != NULL) {
+      node->cursor = plainmtp_cursor_assign( NULL, cursor );
+      if (node->cursor == NULL) { free( node ); node = NULL; }
+    }
+
+    if (node == NULL) {
+      (void)plainmtp_cursor_return( cursor, device );
+      return PLAINMTP_FALSE;
+    }
+
+    node->complete = request->final.complete;
+    node->custom_state = request->final.custom_state;
+    node->success = PLAINMTP_TRUE;
+    post_completion( request->events, node );
+  }
+
+  /* The enumeration is over, so this only tells whether it has ended with an error. */
+  return !plainmtp_cursor_select( cursor, NULL );
+}}
+
+#define CB_post_final ZZ_PLAINMTP(cb_post_final)
+PLAINMTP_INTERNAL void CB_post_final( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, plainmtp_bool success
+) {
+  async_request_s* request = job->custom_state;
+{
+  /* The child entities were already reported, so the enumerated one is not. */
+  if (job->task == &CB_select_children) { cursor = NULL; }
+
+  request->final.cursor = (cursor != NULL) ? plainmtp_cursor_assign( NULL, cursor ) : NULL;
+  request->final.success = success && ( (cursor == NULL) || (request->final.cursor != NULL) );
+
+  post_completion( request->events, &request->final );
+}}
+
+#define submit_request ZZ_PLAINMTP(submit_request)
+PLAINMTP_INTERNAL plainmtp_bool submit_request( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, plainmtp_job_s* job,
+  plainmtp_complete_f complete, void* custom_state
+) {
+  async_request_s* request;
+{
+  assert( events != NULL );
+  assert( complete != NULL );
+
+  request = malloc( sizeof(*request) );
+  if (request == NULL) { return PLAINMTP_FALSE; }
+
+  request->final.complete = complete;
+  request->final.custom_state = custom_state;
+  request->events = events;
+  request->callback = job->callback;
+
+  if (job->callback != NULL) { job->callback = &CB_forward_data; }
+  job->priority = ASYNC_REQUEST_PRIORITY;
+  job->custom_state = request;
+  job->done = &CB_post_final;
+
+  if (!plainmtp_engine_push( engine, job, device_index )) {
+    free( request );
+    return PLAINMTP_FALSE;
+  }
+
+  return PLAINMTP_TRUE;
+}}
+
+/**************************************************************************************************/
+
+struct plainmtp_events_s* plainmtp_events_create(void) {
+  struct plainmtp_events_s* events;
+{
+  events = malloc( sizeof(*events) );
+  if (events == NULL) { goto failed; }
+
+  events->lock = PLAINMTP(mutex_create());
+  if (events->lock == NULL) { goto failed_lock; }
+
+  if (!open_signal( events )) { goto failed_signal; }
+
+  events->first = NULL;
+  events->last = NULL;
+  events->is_signaled = PLAINMTP_FALSE;
+
+  return events;
+
+failed_signal:
+  PLAINMTP(mutex_destroy( events->lock ));
+failed_lock:
+  free( events );
+failed:
+  return NULL;
+}}
+
+void plainmtp_events_destroy( struct plainmtp_events_s* events ) {
+{
+  assert( events != NULL );
+
+  (void)plainmtp_process_events( events, 0 );
+
+  close_signal( events );
+  PLAINMTP(mutex_destroy( events->lock ));
+  free( events );
+}}
+
+size_t plainmtp_get_pollfds( struct plainmtp_events_s* events, plainmtp_pollfd_s* OUT_fds,
+  size_t fd_limit
+) {
+{
+  assert( events != NULL );
+  assert( (OUT_fds != NULL) || (fd_limit == 0) );
+
+  if (fd_limit != 0) {
+#ifdef _WIN32
+    OUT_fds[0].fd = -1;
+    OUT_fds[0].handle = events->handle;
+#else
+    OUT_fds[0].fd = events->pipe_fds[0];
+    OUT_fds[0].handle = NULL;
+#endif
+  }
+
+  return 1;
+}}
+
+size_t plainmtp_process_events( struct plainmtp_events_s* events, size_t event_limit ) {
+  completion_s *chain, *node;
+  size_t count = 0;
+{
+  assert( events != NULL );
+
+  PLAINMTP(mutex_lock( events->lock ));
+
+  chain = events->first;
+  node = NULL;
+
+  while ( (events->first != NULL) && ( (event_limit == 0) || (count < event_limit) ) ) {
+    node = events->first;
+    events->first = node->next;
+    ++count;
+  }
+
+  if (node != NULL) { node->next = NULL; }
+  if (events->first == NULL) { clear_signal( events ); }
+
+  PLAINMTP(mutex_unlock( events->lock ));
+
+  /* The callbacks are called without the lock, so they can start new operations. */
+  while (chain != NULL) {
+    node = chain;
+    chain = node->next;
+
+    node->complete( node->cursor, node->success, node->custom_state );
+
+    if (node->cursor != NULL) { (void)plainmtp_cursor_assign( node->cursor, NULL ); }
+    free( node );
+  }
+
+  return count;
+}}
+
+plainmtp_bool plainmtp_async_switch( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, const plainmtp_target_s* target,
+  plainmtp_complete_f complete, void* custom_state
+) {
+  plainmtp_job_s job = {0};
+{
+  assert( target != NULL );
+
+  job.target = *target;
+  job.task = &CB_resolve_target;
+
+  return submit_request( events, engine, device_index, &job, complete, custom_state );
+}}
+
+plainmtp_bool plainmtp_async_select( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, const plainmtp_target_s* target,
+  plainmtp_complete_f complete, void* custom_state
+) {
+  plainmtp_job_s job = {0};
+{
+  assert( target != NULL );
+
+  job.target = *target;
+  job.task = &CB_select_children;
+
+  return submit_request( events, engine, device_index, &job, complete, custom_state );
+}}
+
+plainmtp_bool plainmtp_async_receive( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, const plainmtp_target_s* target,
+  size_t chunk_limit, plainmtp_data_f callback, plainmtp_complete_f complete, void* custom_state
+) {
+  plainmtp_job_s job = {0};
+{
+  assert( target != NULL );
+  assert( callback != NULL );
+
+  job.target = *target;
+  job.chunk_limit = chunk_limit;
+  job.callback = callback;
+
+  return submit_request( events, engine, device_index, &job, complete, custom_state );
+}}
+
+plainmtp_bool plainmtp_async_transfer( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, const plainmtp_target_s* target,
+  const wchar_t* name, uint64_t size, size_t chunk_limit, plainmtp_data_f callback,
+  plainmtp_complete_f complete, void* custom_state
+) {
+  plainmtp_job_s job = {0};
+{
+  assert( target != NULL );
+  assert( name != NULL );
+
+  job.target = *target;
+  job.name = name;
+  job.size = size;
+  job.chunk_limit = chunk_limit;
+  job.callback = callback;
+
+  return submit_request( events, engine, device_index, &job, complete, custom_state );
+}}
+
+#ifdef PP_PLAINMTP_EVENT_LOOP_C_EX
+#include PP_PLAINMTP_EVENT_LOOP_C_EX
+#endif
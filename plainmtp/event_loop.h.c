@@ -0,0 +1,84 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <Windows.h>
+#endif
+
+#include <limits.h>
+
+#include "threads.c.h"
+
+/* The asynchronous operations are requested interactively, so they're executed before the jobs
+  pushed to the engine directly, preempting them between their steps. */
+#define ASYNC_REQUEST_PRIORITY INT_MAX
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+typedef struct ZZ_PLAINMTP(completion_s) {
+  plainmtp_complete_f complete;
+  void* custom_state;
+
+  /* A copy owned by the completion until its callback returns. */
+  struct plainmtp_cursor_s* cursor;
+  plainmtp_bool success;
+
+  struct ZZ_PLAINMTP(completion_s)* next;
+} completion_s;
+
+typedef struct ZZ_PLAINMTP(async_request_s) {
+  /* Reported when the underlying job is done. It's allocated along with the request, so reporting
+    it can't fail, and is freed by plainmtp_process_events() the same way as any other one. */
+  completion_s final;
+
+  struct plainmtp_events_s* events;
+  plainmtp_data_f callback;
+} async_request_s;
+
+struct plainmtp_events_s {
+  /* Protects everything below. */
+  mutex_s* lock;
+
+  /* Completions in the order they were posted. */
+  completion_s* first;
+  completion_s* last;
+
+  /* Whether the descriptor is ready. It is kept so while there are completions left. */
+  plainmtp_bool is_signaled;
+
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  int pipe_fds[2];  /* The read end and the write one. */
+#endif
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(open_signal( struct plainmtp_events_s* events ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(close_signal( struct plainmtp_events_s* events ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(raise_signal( struct plainmtp_events_s* events ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(clear_signal( struct plainmtp_events_s* events ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(post_completion( struct plainmtp_events_s* events,
+  completion_s* node ));
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_forward_data( void* data, size_t size,
+  void* custom_state ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(cb_resolve_target( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(cb_select_children( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(cb_post_final( const plainmtp_job_s* job,
+  struct plainmtp_cursor_s* cursor, plainmtp_bool success ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(submit_request( struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine, size_t device_index, plainmtp_job_s* job,
+  plainmtp_complete_f complete, void* custom_state ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -7,7 +7,8 @@
 /* TODO: Support weak symbol linking for these functions on some platforms?
   https://stackoverflow.com/questions/2290587/gcc-style-weak-linking-in-visual-studio */
 
-#ifdef CC_PLAINMTP_FALLBACK_WCSDUP
+/* NB: The copies made by wcsdup() can't be accounted, so the fallback is used in that mode. */
+#if defined(CC_PLAINMTP_FALLBACK_WCSDUP) || defined(CC_PLAINMTP_ALLOC_ACCOUNTING)
   PLAINMTP_EXTERN wchar_t* zz_plainmtp_wcsdup( const wchar_t* );
 #else
   #define zz_plainmtp_wcsdup wcsdup
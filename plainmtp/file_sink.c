@@ -0,0 +1,218 @@
+/* NB: Memory mapping and preallocation of files are not a part of the C standard, so they have to
+  be requested explicitly, along with the 64-bit file offsets on 32-bit systems. */
+#ifndef _WIN32
+  #define _POSIX_C_SOURCE 200112L
+  #define _FILE_OFFSET_BITS 64
+#endif
+
+#include "file_sink.h.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifndef _WIN32
+  #include <sys/types.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#include "host_files.c.h"
+#include "utf8_wchar.c.h"
+
+#define map_file_sink ZZ_PLAINMTP(map_file_sink)
+PLAINMTP_INTERNAL plainmtp_bool map_file_sink( file_sink_s* sink ) {
+#ifdef _WIN32
+  void* mapping;
+#else
+  char* mbs_path;
+  void* mapping;
+  int status;
+#endif
+{
+#ifdef _WIN32
+  sink->file_handle = CreateFileW( sink->path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+  if (sink->file_handle == INVALID_HANDLE_VALUE) { return PLAINMTP_FALSE; }
+
+  /* NB: This also extends the file to the specified size. */
+  sink->mapping_handle = CreateFileMappingW( sink->file_handle, NULL, PAGE_READWRITE,
+    (DWORD)(sink->size >> 32), (DWORD)sink->size, NULL );
+  if (sink->mapping_handle == NULL) {
+    CloseHandle( sink->file_handle );
+    return PLAINMTP_FALSE;
+  }
+
+  mapping = MapViewOfFile( sink->mapping_handle, FILE_MAP_WRITE, 0, 0, (SIZE_T)sink->size );
+  if (mapping == NULL) {
+    CloseHandle( sink->mapping_handle );
+    CloseHandle( sink->file_handle );
+    return PLAINMTP_FALSE;
+  }
+#else
+  mbs_path = PLAINMTP(make_utf8_string( sink->path ));
+  if (mbs_path == NULL) { return PLAINMTP_FALSE; }
+
+  sink->descriptor = open( mbs_path, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+  free( mbs_path );
+  if (sink->descriptor == -1) { return PLAINMTP_FALSE; }
+
+  /* NB: Writing into a mapping of a sparse file raises SIGBUS if the disk gets full, so the space is
+    preferably reserved for real. Not every filesystem supports this, though. */
+#if defined(_POSIX_ADVISORY_INFO) && (_POSIX_ADVISORY_INFO > 0)
+  status = posix_fallocate( sink->descriptor, 0, (off_t)sink->size );
+  if (status != 0) { status = ftruncate( sink->descriptor, (off_t)sink->size ); }
+#else
+  status = ftruncate( sink->descriptor, (off_t)sink->size );
+#endif
+
+  mapping = (status != 0) ? MAP_FAILED : mmap( NULL, (size_t)sink->size, PROT_READ | PROT_WRITE,
+    MAP_SHARED, sink->descriptor, 0 );
+
+  if (mapping == MAP_FAILED) {
+    (void)close( sink->descriptor );
+    return PLAINMTP_FALSE;
+  }
+#endif
+
+  sink->mapping = mapping;
+  return PLAINMTP_TRUE;
+}}
+
+#define unmap_file_sink ZZ_PLAINMTP(unmap_file_sink)
+PLAINMTP_INTERNAL plainmtp_bool unmap_file_sink( file_sink_s* sink ) {
+  plainmtp_bool result = PLAINMTP_TRUE;
+#ifdef _WIN32
+  LARGE_INTEGER position;
+#endif
+{
+  /* The file is truncated if the object has turned out to be shorter than it was reported. */
+#ifdef _WIN32
+  if (!UnmapViewOfFile( sink->mapping )) { result = PLAINMTP_FALSE; }
+  CloseHandle( sink->mapping_handle );
+
+  if (sink->position != sink->size) {
+    position.QuadPart = (LONGLONG)sink->position;
+    if ( !SetFilePointerEx( sink->file_handle, position, NULL, FILE_BEGIN )
+      || !SetEndOfFile( sink->file_handle )
+    ) {
+      result = PLAINMTP_FALSE;
+    }
+  }
+
+  if (!CloseHandle( sink->file_handle )) { result = PLAINMTP_FALSE; }
+#else
+  if (munmap( sink->mapping, (size_t)sink->size ) != 0) { result = PLAINMTP_FALSE; }
+
+  if ( (sink->position != sink->size)
+    && (ftruncate( sink->descriptor, (off_t)sink->position ) != 0)
+  ) {
+    result = PLAINMTP_FALSE;
+  }
+
+  if (close( sink->descriptor ) != 0) { result = PLAINMTP_FALSE; }
+#endif
+
+  return result;
+}}
+
+#define open_file_sink ZZ_PLAINMTP(open_file_sink)
+PLAINMTP_INTERNAL plainmtp_bool open_file_sink( file_sink_s* sink, const wchar_t* path,
+  uint64_t size
+) {
+{
+  sink->path = path;
+  sink->mapping = NULL;
+  sink->size = size;
+  sink->position = 0;
+  sink->chunk_size = 0;
+  sink->buffer = NULL;
+  sink->stream = NULL;
+
+  /* NB: Empty files can't be mapped, and there's no need in that anyway. */
+  if ( (size != PLAINMTP_SIZE_UNKNOWN) && (size != 0) && (size <= (size_t)-1) ) {
+    if (map_file_sink( sink )) { return PLAINMTP_TRUE; }
+  }
+
+  sink->stream = PLAINMTP(open_host_file( path, PLAINMTP_TRUE ));
+  return (sink->stream != NULL);
+}}
+
+#define close_file_sink ZZ_PLAINMTP(close_file_sink)
+PLAINMTP_INTERNAL plainmtp_bool close_file_sink( file_sink_s* sink, plainmtp_bool success ) {
+{
+  if (sink->mapping != NULL) {
+    if (!unmap_file_sink( sink )) { success = PLAINMTP_FALSE; }
+  } else {
+    if (fclose( sink->stream ) != 0) { success = PLAINMTP_FALSE; }
+  }
+
+  free( sink->buffer );
+
+  if (!success) { PLAINMTP(remove_host_file( sink->path )); }
+  return success;
+}}
+
+#define get_sink_buffer ZZ_PLAINMTP(get_sink_buffer)
+PLAINMTP_INTERNAL void* get_sink_buffer( file_sink_s* sink ) {
+{
+  if ( (sink->mapping != NULL) && (sink->size - sink->position >= sink->chunk_size) ) {
+    return &sink->mapping[sink->position];
+  }
+
+  if (sink->buffer == NULL) { sink->buffer = malloc( sink->chunk_size ); }
+  return sink->buffer;
+}}
+
+#define CB_file_sink ZZ_PLAINMTP(cb_file_sink)
+PLAINMTP_INTERNAL void* CB_file_sink( void* data, size_t size, void* custom_state ) {
+  file_sink_s* sink = custom_state;
+{
+  if (size == 0) { return NULL; }
+
+  if (data == NULL) {
+    sink->chunk_size = size;
+    return get_sink_buffer( sink );
+  }
+
+  if (sink->mapping == NULL) {
+    if (fwrite( data, 1, size, sink->stream ) != size) { return NULL; }
+  } else if (data != &sink->mapping[sink->position]) {
+    /* The object has turned out to be larger than it was reported. */
+    if (sink->size - sink->position < size) { return NULL; }
+    (void)memcpy( &sink->mapping[sink->position], data, size );
+  }
+
+  sink->position += size;
+  return (sink->chunk_size != 0) ? get_sink_buffer( sink ) : data;
+}}
+
+/**************************************************************************************************/
+
+plainmtp_bool plainmtp_cursor_receive_file( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* path, size_t chunk_limit,
+  plainmtp_digest_s* digest
+) {
+  file_sink_s sink;
+  plainmtp_bool result;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( path != NULL );
+
+  if (digest != NULL) { digest->size = 0; }  /* For the case of an early failure. */
+
+  if (!open_file_sink( &sink, path, ((plainmtp_cursor_s*)cursor)->size )) {
+    return PLAINMTP_FALSE;
+  }
+
+  result = plainmtp_cursor_receive_digest( cursor, device, chunk_limit, &CB_file_sink, &sink,
+    digest );
+
+  return close_file_sink( &sink, result );
+}}
+
+#ifdef PP_PLAINMTP_FILE_SINK_C_EX
+#include PP_PLAINMTP_FILE_SINK_C_EX
+#endif
@@ -0,0 +1,57 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include <stdio.h>
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <Windows.h>
+#endif
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+/* Destination file of the received object data. If the object size is known, the file is
+  preallocated and mapped into memory, so the data is written there directly. Otherwise, or if the
+  mapping has failed, it is written with the standard C stream. */
+typedef struct ZZ_PLAINMTP(file_sink_s) {
+  const wchar_t* path;
+
+  /* If NULL, the data is written into the 'stream' instead. */
+  unsigned char* mapping;
+  uint64_t size;
+  uint64_t position;
+
+  /* In "active" mode, the library gets pointers right into the mapping. Only the last part of the
+    object that is smaller than the chunk size is exchanged through the intermediate buffer. */
+  size_t chunk_size;
+  void* buffer;
+
+  FILE* stream;
+
+#ifdef _WIN32
+  HANDLE file_handle;
+  HANDLE mapping_handle;
+#else
+  int descriptor;
+#endif
+} file_sink_s;
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(map_file_sink( file_sink_s* sink ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(unmap_file_sink( file_sink_s* sink ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(open_file_sink( file_sink_s* sink, const wchar_t* path,
+  uint64_t size ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(close_file_sink( file_sink_s* sink,
+  plainmtp_bool success ));
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(get_sink_buffer( file_sink_s* sink ));
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_file_sink( void* data, size_t size, void* custom_state ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
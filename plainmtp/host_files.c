@@ -0,0 +1,74 @@
+#include "host_files.c.h"
+
+#include <stdlib.h>
+
+#include "utf8_wchar.c.h"
+
+/* NB: Paths are converted to UTF-8 on POSIX systems, where wide ones aren't supported by the file
+  API. This is the same approach that is used in the POSIX version of mtpls. */
+
+#define open_host_file PLAINMTP(open_host_file)
+FILE* open_host_file( const wchar_t* path, plainmtp_bool for_writing ) {
+#ifndef _WIN32
+  char* mbs_path;
+  FILE* result;
+#endif
+{
+#ifdef _WIN32
+  return _wfopen( path, for_writing ? L"wb" : L"rb" );
+#else
+  mbs_path = PLAINMTP(make_utf8_string( path ));
+  if (mbs_path == NULL) { return NULL; }
+
+  result = fopen( mbs_path, for_writing ? "wb" : "rb" );
+  free( mbs_path );
+
+  return result;
+#endif
+}}
+
+#define rename_host_file PLAINMTP(rename_host_file)
+plainmtp_bool rename_host_file( const wchar_t* source, const wchar_t* destination ) {
+#ifndef _WIN32
+  char *mbs_source, *mbs_destination;
+  int status = -1;
+#endif
+{
+#ifdef _WIN32
+  /* NB: Unlike POSIX rename(), _wrename() fails if the destination exists. */
+  return (_wrename( source, destination ) == 0);
+#else
+  mbs_source = PLAINMTP(make_utf8_string( source ));
+  mbs_destination = PLAINMTP(make_utf8_string( destination ));
+
+  if ( (mbs_source != NULL) && (mbs_destination != NULL) ) {
+    status = rename( mbs_source, mbs_destination );
+  }
+
+  free( mbs_source );
+  free( mbs_destination );
+
+  return (status == 0);
+#endif
+}}
+
+#define remove_host_file PLAINMTP(remove_host_file)
+void remove_host_file( const wchar_t* path ) {
+#ifndef _WIN32
+  char* mbs_path;
+#endif
+{
+#ifdef _WIN32
+  (void)_wremove( path );
+#else
+  mbs_path = PLAINMTP(make_utf8_string( path ));
+  if (mbs_path == NULL) { return; }
+
+  (void)remove( mbs_path );
+  free( mbs_path );
+#endif
+}}
+
+#ifdef PP_PLAINMTP_HOST_FILES_C_EX
+#include PP_PLAINMTP_HOST_FILES_C_EX
+#endif
@@ -0,0 +1,15 @@
+#ifndef ZZ_PLAINMTP_HOST_FILES_C_IG
+#define ZZ_PLAINMTP_HOST_FILES_C_IG
+#include "common.i.h"
+
+#include <stdio.h>
+#include <wchar.h>
+
+PLAINMTP_EXTERN FILE* PLAINMTP(open_host_file( const wchar_t* path, plainmtp_bool for_writing ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(rename_host_file( const wchar_t* source,
+  const wchar_t* destination ));
+PLAINMTP_EXTERN void PLAINMTP(remove_host_file( const wchar_t* path ));
+
+#else
+#error ZZ_PLAINMTP_HOST_FILES_C_IG
+#endif
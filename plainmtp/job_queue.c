@@ -0,0 +1,528 @@
+#include "job_queue.h.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <assert.h>
+
+#include "utf8_wchar.c.h"
+
+#define copy_job_string ZZ_PLAINMTP(copy_job_string)
+PLAINMTP_INTERNAL wchar_t* copy_job_string( wchar_t** buffer, const wchar_t* string ) {
+  wchar_t* result = *buffer;
+  size_t length;
+{
+  if (string == NULL) { return NULL; }
+
+  length = wcslen( string ) + 1;
+  *buffer += length;
+  return wmemcpy( result, string, length );
+}}
+
+#define wipe_folder_listing ZZ_PLAINMTP(wipe_folder_listing)
+PLAINMTP_INTERNAL void wipe_folder_listing( folder_cache_s* cache ) {
+{
+  if (cache->listing == NULL) { return; }
+
+  while (cache->listing_count > 0) {
+    (void)plainmtp_cursor_assign( cache->listing[--cache->listing_count], NULL );
+  }
+
+  free( cache->listing );
+  cache->listing = NULL;
+}}
+
+#define wipe_folder_cache ZZ_PLAINMTP(wipe_folder_cache)
+PLAINMTP_INTERNAL void wipe_folder_cache( folder_cache_s* cache ) {
+{
+  if (cache->base_id == NULL) { return; }
+
+  wipe_folder_listing( cache );
+  (void)plainmtp_cursor_assign( cache->folder, NULL );
+
+  free( cache->base_id );  /* This also frees 'cache->path'. */
+  cache->base_id = NULL;
+}}
+
+/* NB: Entities without names are placed first, and never match any name. The named entities of a
+  folder have their names in the same form, and the byte order of UTF-8 is the code point one. */
+#define compare_entity_names ZZ_PLAINMTP(compare_entity_names)
+PLAINMTP_INTERNAL int compare_entity_names( const void* entity_a, const void* entity_b ) {
+  plainmtp_cursor_s* const image_a = *(plainmtp_cursor_s* const*)entity_a;
+  plainmtp_cursor_s* const image_b = *(plainmtp_cursor_s* const*)entity_b;
+  const plainmtp_bool has_name_a = (image_a->name != NULL) || (image_a->name_u8 != NULL);
+  const plainmtp_bool has_name_b = (image_b->name != NULL) || (image_b->name_u8 != NULL);
+{
+  if (!has_name_a) { return has_name_b ? -1 : 0; }
+  if (!has_name_b) { return 1; }
+
+  if (image_a->name_u8 != NULL) { return strcmp( image_a->name_u8, image_b->name_u8 ); }
+  return wcscmp( image_a->name, image_b->name );
+}}
+
+#define compare_entity_name_key ZZ_PLAINMTP(compare_entity_name_key)
+PLAINMTP_INTERNAL int compare_entity_name_key( const void* key, const void* entity ) {
+  plainmtp_cursor_s* const image = *(plainmtp_cursor_s* const*)entity;
+{
+  if (image->name_u8 != NULL) {
+    return -PLAINMTP(compare_utf8_with_wide( image->name_u8, key, wcslen( key ) ));
+  }
+
+  if (image->name == NULL) { return 1; }
+  return wcscmp( key, image->name );
+}}
+
+#define obtain_folder_listing ZZ_PLAINMTP(obtain_folder_listing)
+PLAINMTP_INTERNAL plainmtp_bool obtain_folder_listing( folder_cache_s* cache,
+  struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s **listing, *entity;
+  size_t capacity = 16;
+{
+  cache->listing = malloc( capacity * sizeof(*cache->listing) );
+  if (cache->listing == NULL) { return PLAINMTP_FALSE; }
+  cache->listing_count = 0;
+
+  while (plainmtp_cursor_select( cache->folder, device )) {
+    if (cache->listing_count == capacity) {
+      capacity *= 2;
+      listing = realloc( cache->listing, capacity * sizeof(*listing) );
+      if (listing == NULL) { goto failed; }
+      cache->listing = listing;
+    }
+
+    entity = plainmtp_cursor_assign( NULL, cache->folder );
+    if (entity == NULL) { goto failed; }
+    cache->listing[cache->listing_count++] = entity;
+  }
+
+  if (plainmtp_cursor_select( cache->folder, NULL )) {
+    wipe_folder_listing( cache );
+    return PLAINMTP_FALSE;
+  }
+
+  qsort( cache->listing, cache->listing_count, sizeof(*cache->listing), &compare_entity_names );
+  return PLAINMTP_TRUE;
+
+failed:
+  /* Abort the enumeration. This is guaranteed to switch the cursor back to the folder itself. */
+  (void)plainmtp_cursor_return( cache->folder, device );
+  wipe_folder_listing( cache );
+  return PLAINMTP_FALSE;
+}}
+
+#define seek_child_entity ZZ_PLAINMTP(seek_child_entity)
+PLAINMTP_INTERNAL plainmtp_bool seek_child_entity( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* name, size_t length
+) {
+  plainmtp_cursor_s* const image = (plainmtp_cursor_s*)cursor;
+{
+  while (plainmtp_cursor_select( cursor, device )) {
+    if (image->name_u8 != NULL) {
+      if (PLAINMTP(compare_utf8_with_wide( image->name_u8, name, length )) == 0) {
+        return !plainmtp_cursor_select( cursor, NULL );
+      }
+
+      continue;
+    }
+
+    if (image->name == NULL) { continue; }
+
+    /* BEWARE: Short-circuit evaluation matters here! */
+    /* NB: wcsncmp() must be checked first to guarantee minimum length of the string. */
+    if ( (wcsncmp( name, image->name, length ) == 0) && (image->name[length] == L'\0') ) {
+      return !plainmtp_cursor_select( cursor, NULL );
+    }
+  }
+
+  return PLAINMTP_FALSE;
+}}
+
+#define resolve_job_folder ZZ_PLAINMTP(resolve_job_folder)
+PLAINMTP_INTERNAL struct plainmtp_cursor_s* resolve_job_folder( struct plainmtp_queue_s* queue,
+  const plainmtp_target_s* target, size_t path_length
+) {
+  folder_cache_s* const cache = &queue->cache;
+  const wchar_t *base_id, *path = target->path;
+  struct plainmtp_cursor_s* folder;
+  size_t base_id_length, length, i;
+{
+  if (path == NULL) { path = L""; }
+
+  if (target->cursor != NULL) {
+    base_id = ((plainmtp_cursor_s*)target->cursor)->id;
+  } else {
+    base_id = (target->entity_id != NULL) ? target->entity_id : L"";
+  }
+
+  /* BEWARE: Short-circuit evaluation matters here! */
+  if ( (cache->base_id != NULL)
+    && (wcscmp( cache->base_id, base_id ) == 0)
+    && (wcsncmp( cache->path, path, path_length ) == 0)
+    && (cache->path[path_length] == L'\0')
+    && ( (path_length == 0) || (cache->delimiter == target->delimiter) )
+  ) {
+    return cache->folder;
+  }
+
+  wipe_folder_cache( cache );
+
+  if (target->cursor != NULL) {
+    folder = plainmtp_cursor_assign( NULL, target->cursor );
+  } else {
+    folder = plainmtp_cursor_switch( NULL, target->entity_id, queue->device );
+  }
+
+  if (folder == NULL) { return NULL; }
+
+  for (i = 0; i < path_length; i += length + 1) {
+    for (length = 0; (i+length < path_length) && (path[i+length] != target->delimiter); ++length) {}
+
+    /* Empty names between delimiters are skipped, as it is usual for filesystem paths. */
+    if ( (length > 0) && !seek_child_entity( folder, queue->device, &path[i], length ) ) {
+      (void)plainmtp_cursor_assign( folder, NULL );
+      return NULL;
+    }
+  }
+
+  /* Both strings are kept in the same memory block. */
+  base_id_length = wcslen( base_id ) + 1;
+
+  cache->base_id = malloc( (base_id_length + path_length + 1) * sizeof(*cache->base_id) );
+  if (cache->base_id == NULL) {
+    (void)plainmtp_cursor_assign( folder, NULL );
+    return NULL;
+  }
+
+  (void)wmemcpy( cache->base_id, base_id, base_id_length );
+  cache->path = cache->base_id + base_id_length;
+  if (path_length > 0) { (void)wmemcpy( cache->path, path, path_length ); }
+  cache->path[path_length] = L'\0';
+
+  cache->delimiter = target->delimiter;
+  cache->folder = folder;
+  cache->listing = NULL;
+
+  return folder;
+}}
+
+#define resolve_job_target ZZ_PLAINMTP(resolve_job_target)
+PLAINMTP_INTERNAL struct plainmtp_cursor_s* resolve_job_target( struct plainmtp_queue_s* queue,
+  const plainmtp_job_s* job
+) {
+  struct plainmtp_cursor_s** entity;
+  const wchar_t* path = job->target.path;
+  size_t folder_length = 0, i;
+{
+  if (path == NULL) {
+    path = L"";
+  } else if (!JOB_IS_TRANSFER( job )) {
+    /* The last name in the path of a receive job refers to the object itself, not to a folder. */
+    for (i = 0; path[i] != L'\0'; ++i) {
+      if (path[i] == job->target.delimiter) { folder_length = i; }
+    }
+  } else {
+    folder_length = wcslen( path );
+  }
+
+  if (resolve_job_folder( queue, &job->target, folder_length ) == NULL) { return NULL; }
+
+  /* Skip the delimiters that separate the name of the object from its folder path. If nothing
+    remains after them, the path refers to the folder itself. */
+  path += folder_length;
+  while ( (*path != L'\0') && (*path == job->target.delimiter) ) { ++path; }
+
+  if ( JOB_IS_TRANSFER( job ) || (*path == L'\0') ) { return queue->cache.folder; }
+
+  if ( (queue->cache.listing == NULL) && !obtain_folder_listing( &queue->cache, queue->device ) ) {
+    return NULL;
+  }
+
+  entity = bsearch( path, queue->cache.listing, queue->cache.listing_count,
+    sizeof(*queue->cache.listing), &compare_entity_name_key );
+
+  return (entity != NULL) ? *entity : NULL;
+}}
+
+#define insert_job ZZ_PLAINMTP(insert_job)
+PLAINMTP_INTERNAL void insert_job( struct plainmtp_queue_s* queue, job_node_s* node,
+  plainmtp_bool is_resumed
+) {
+  job_node_s** link = &queue->first;
+  const int priority = node->job.priority;
+{
+  /* A resumed job is placed before the others with the same priority, so it is continued unless
+    any job with a higher one has been pushed meanwhile. A new job is placed after them. */
+  if ( !is_resumed && ( (queue->last == NULL) || (queue->last->job.priority >= priority) ) ) {
+    /* This is the most common case, since usually all the jobs have the same priority. */
+    link = (queue->last != NULL) ? &queue->last->next : &queue->first;
+  } else {
+    while ( (*link != NULL) && ( ((*link)->job.priority > priority)
+      || ( !is_resumed && ((*link)->job.priority == priority) ) )
+    ) {
+      link = &(*link)->next;
+    }
+  }
+
+  node->next = *link;
+  *link = node;
+  if (node->next == NULL) { queue->last = node; }
+}}
+
+#define receive_job_segment ZZ_PLAINMTP(receive_job_segment)
+PLAINMTP_INTERNAL plainmtp_3val receive_job_segment( struct plainmtp_queue_s* queue,
+  job_node_s* node
+) {
+  plainmtp_3val result;
+{
+  result = PLAINMTP(segments_receive( &node->segments, node->cursor, queue->device,
+    queue->segment_size, node->job.digest ));
+
+  if (node->segments.is_unranged) { queue->is_ranged = PLAINMTP_FALSE; }
+  return result;
+}}
+
+#define execute_job ZZ_PLAINMTP(execute_job)
+PLAINMTP_INTERNAL plainmtp_3val execute_job( struct plainmtp_queue_s* queue, job_node_s* node,
+  struct plainmtp_cursor_s** OUT_cursor
+) {
+  const plainmtp_job_s* job = &node->job;
+  struct plainmtp_cursor_s* target;
+  plainmtp_bool result;
+{
+  if (node->cursor != NULL) {
+    *OUT_cursor = node->cursor;
+    return receive_job_segment( queue, node );
+  }
+
+  *OUT_cursor = NULL;
+
+  target = resolve_job_target( queue, job );
+  if (target == NULL) {
+    if (job->task == NULL) {
+      if (job->digest != NULL) { job->digest->size = 0; }
+      if (job->callback != NULL) { (void)job->callback( NULL, 0, job->custom_state ); }
+    }
+
+    return PLAINMTP_BAD;
+  }
+
+  if (job->task != NULL) {
+    *OUT_cursor = target;
+    return job->task( job, target, queue->device ) ? PLAINMTP_GOOD : PLAINMTP_BAD;
+  }
+
+  if (job->name == NULL) {
+    /* The segments are received with a separate cursor, since the folder cache may be changed by
+      other jobs in between. If it can't be allocated, the object is just received as a whole. */
+    if ( (queue->segment_size != 0) && queue->is_ranged ) {
+      node->cursor = plainmtp_cursor_assign( NULL, target );
+    }
+
+    if (node->cursor != NULL) {
+      PLAINMTP(segments_start( &node->segments, job->chunk_limit, job->callback,
+        job->custom_state, (job->digest != NULL) ? job->digest->algorithm : PLAINMTP_DIGEST_NONE ));
+
+      *OUT_cursor = node->cursor;
+      return receive_job_segment( queue, node );
+    }
+
+    *OUT_cursor = target;
+    result = plainmtp_cursor_receive_digest( target, queue->device, job->chunk_limit,
+      job->callback, job->custom_state, job->digest );
+
+    return result ? PLAINMTP_GOOD : PLAINMTP_BAD;
+  }
+
+  result = plainmtp_cursor_transfer_digest( target, queue->device, job->name, job->size,
+    job->chunk_limit, job->callback, job->custom_state, OUT_cursor, job->digest );
+
+  /* The listing of the folder doesn't contain the new object anymore. */
+  if (result) { wipe_folder_listing( &queue->cache ); }
+
+  return result ? PLAINMTP_GOOD : PLAINMTP_BAD;
+}}
+
+#define finish_job ZZ_PLAINMTP(finish_job)
+PLAINMTP_INTERNAL void finish_job( job_node_s* node, struct plainmtp_cursor_s* cursor,
+  plainmtp_bool success
+) {
+{
+  if (node->job.done != NULL) { node->job.done( &node->job, cursor, success ); }
+
+  if (node->cursor != NULL) { (void)plainmtp_cursor_assign( node->cursor, NULL ); }
+  if (node->job.target.cursor != NULL) {
+    (void)plainmtp_cursor_assign( node->job.target.cursor, NULL );
+  }
+
+  free( node );
+}}
+
+/**************************************************************************************************/
+
+#define make_job_copy PLAINMTP(make_job_copy)
+plainmtp_job_s* make_job_copy( const plainmtp_job_s* job ) {
+  job_node_s* node;
+  wchar_t* buffer;
+  size_t length = 0;
+{
+  assert( job != NULL );
+  assert( (job->task != NULL) || (job->callback != NULL)
+    || ( (job->name != NULL) && (job->size == 0) ) );
+
+  if ( (job->target.cursor == NULL) && (job->target.entity_id != NULL) ) {
+    length += wcslen( job->target.entity_id ) + 1;
+  }
+
+  if (job->target.path != NULL) { length += wcslen( job->target.path ) + 1; }
+  if (job->name != NULL) { length += wcslen( job->name ) + 1; }
+
+  node = malloc( sizeof(*node) + length * sizeof(*buffer) );
+  if (node == NULL) { return NULL; }
+
+  node->job = *job;
+  buffer = (wchar_t*)(node + 1);
+
+  if (job->target.cursor != NULL) {
+    node->job.target.cursor = plainmtp_cursor_assign( NULL, job->target.cursor );
+    if (node->job.target.cursor == NULL) {
+      free( node );
+      return NULL;
+    }
+
+    node->job.target.entity_id = NULL;
+  } else {
+    node->job.target.entity_id = copy_job_string( &buffer, job->target.entity_id );
+  }
+
+  node->job.target.path = copy_job_string( &buffer, job->target.path );
+  node->job.name = copy_job_string( &buffer, job->name );
+
+  node->cursor = NULL;
+
+  return &node->job;
+}}
+
+#define discard_job_copy PLAINMTP(discard_job_copy)
+void discard_job_copy( plainmtp_job_s* copy ) {
+  job_node_s* node = JOB_NODE(copy);
+{
+  if ( (copy->task == NULL) && (copy->callback != NULL) ) {
+    if (node->cursor != NULL) {
+      PLAINMTP(segments_finish( &node->segments ));
+    } else {
+      (void)copy->callback( NULL, 0, copy->custom_state );
+    }
+  }
+
+  finish_job( node, NULL, PLAINMTP_FALSE );
+}}
+
+#define adopt_job_copy PLAINMTP(adopt_job_copy)
+void adopt_job_copy( struct plainmtp_queue_s* queue, plainmtp_job_s* copy ) {
+{
+  assert( queue != NULL );
+  assert( copy != NULL );
+
+  insert_job( queue, JOB_NODE(copy), PLAINMTP_FALSE );
+}}
+
+#define count_queued_jobs PLAINMTP(count_queued_jobs)
+size_t count_queued_jobs( struct plainmtp_queue_s* queue ) {
+  job_node_s* node;
+  size_t result = 0;
+{
+  assert( queue != NULL );
+
+  for (node = queue->first; node != NULL; node = node->next) { ++result; }
+  return result;
+}}
+
+/**************************************************************************************************/
+
+struct plainmtp_queue_s* plainmtp_queue_create( struct plainmtp_device_s* device ) {
+  struct plainmtp_queue_s* queue;
+{
+  assert( device != NULL );
+
+  queue = malloc( sizeof(*queue) );
+  if (queue == NULL) { return NULL; }
+
+  queue->device = device;
+  queue->first = NULL;
+  queue->last = NULL;
+  queue->segment_size = DEFAULT_SEGMENT_SIZE;
+  queue->is_ranged = PLAINMTP_TRUE;
+  queue->cache.base_id = NULL;
+
+  return queue;
+}}
+
+void plainmtp_queue_destroy( struct plainmtp_queue_s* queue ) {
+  job_node_s* node;
+{
+  assert( queue != NULL );
+
+  while (queue->first != NULL) {
+    node = queue->first;
+    queue->first = node->next;
+    discard_job_copy( &node->job );
+  }
+
+  wipe_folder_cache( &queue->cache );
+  free( queue );
+}}
+
+plainmtp_bool plainmtp_queue_push( struct plainmtp_queue_s* queue, const plainmtp_job_s* job ) {
+  plainmtp_job_s* copy;
+{
+  assert( queue != NULL );
+
+  copy = make_job_copy( job );
+  if (copy == NULL) { return PLAINMTP_FALSE; }
+
+  insert_job( queue, JOB_NODE(copy), PLAINMTP_FALSE );
+  return PLAINMTP_TRUE;
+}}
+
+void plainmtp_queue_set_segment_size( struct plainmtp_queue_s* queue, size_t segment_size ) {
+{
+  assert( queue != NULL );
+  queue->segment_size = segment_size;
+}}
+
+size_t plainmtp_queue_run( struct plainmtp_queue_s* queue, size_t step_limit ) {
+  job_node_s* node;
+  struct plainmtp_cursor_s* cursor;
+  plainmtp_3val status;
+  plainmtp_bool is_owned;
+  size_t result = 0;
+{
+  assert( queue != NULL );
+
+  while ( (queue->first != NULL) && ( (step_limit == 0) || (result < step_limit) ) ) {
+    node = queue->first;
+    queue->first = node->next;
+    if (queue->first == NULL) { queue->last = NULL; }
+
+    status = execute_job( queue, node, &cursor );
+    ++result;
+
+    if (status == PLAINMTP_NONE) {
+      insert_job( queue, node, PLAINMTP_TRUE );
+      continue;
+    }
+
+    /* Only the transferred object is owned here. The cursor of a receive job belongs either to the
+      folder cache or to the node itself. */
+    is_owned = JOB_IS_TRANSFER( &node->job ) && (cursor != NULL);
+    finish_job( node, cursor, status == PLAINMTP_GOOD );
+    if (is_owned) { (void)plainmtp_cursor_assign( cursor, NULL ); }
+  }
+
+  return result;
+}}
+
+#ifdef PP_PLAINMTP_JOB_QUEUE_C_EX
+#include PP_PLAINMTP_JOB_QUEUE_C_EX
+#endif
@@ -0,0 +1,19 @@
+#ifndef ZZ_PLAINMTP_JOB_QUEUE_C_IG
+#define ZZ_PLAINMTP_JOB_QUEUE_C_IG
+#include "common.i.h"
+
+#include "plainmtp.h"
+
+/* A copy of the job is made the same way plainmtp_queue_push() does it, so it can be held before
+  being adopted by a queue. Until then, it can only be discarded, reporting failure. */
+PLAINMTP_EXTERN plainmtp_job_s* PLAINMTP(make_job_copy( const plainmtp_job_s* job ));
+PLAINMTP_EXTERN void PLAINMTP(discard_job_copy( plainmtp_job_s* copy ));
+PLAINMTP_EXTERN void PLAINMTP(adopt_job_copy( struct plainmtp_queue_s* queue,
+  plainmtp_job_s* copy ));
+
+/* Number of the jobs in the queue, including the ones that are executed in segments. */
+PLAINMTP_EXTERN size_t PLAINMTP(count_queued_jobs( struct plainmtp_queue_s* queue ));
+
+#else
+#error ZZ_PLAINMTP_JOB_QUEUE_C_IG
+#endif
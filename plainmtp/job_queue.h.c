@@ -0,0 +1,92 @@
+#include "job_queue.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include "data_segments.c.h"
+
+/* 8 MiB is small enough to be received in a fraction of a second even by USB 2.0 devices. */
+#define DEFAULT_SEGMENT_SIZE (8 * 1024 * 1024)
+
+#define JOB_IS_TRANSFER( Job ) \
+  ( ( (Job)->task == NULL ) && ( (Job)->name != NULL ) )
+
+/* The job is the first member of the node, so the copy of the job is the node itself. */
+#define JOB_NODE( Copy ) \
+  ( (job_node_s*)(Copy) )
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+typedef struct ZZ_PLAINMTP(job_node_s) {
+  /* All the strings of the job are stored in the same memory block right after the node. */
+  plainmtp_job_s job;
+  struct ZZ_PLAINMTP(job_node_s)* next;
+
+  /* State of a receive job that is executed in segments. The cursor is NULL until the first one. */
+  struct plainmtp_cursor_s* cursor;
+  segmented_receive_s segments;
+} job_node_s;
+
+/* The folder of the last resolved target along with its lazily obtained listing sorted by names.
+  Consecutive jobs within the same folder, which is the common case for bulk copies, thus need only
+  one enumeration of it instead of one per job. */
+typedef struct ZZ_PLAINMTP(folder_cache_s) {
+  /* If NULL, there's no folder cached. An empty string means the device root. */
+  wchar_t* base_id;
+
+  /* Path of the folder relative to the base entity, not terminated with the delimiter. */
+  wchar_t* path;
+  wchar_t delimiter;
+
+  struct plainmtp_cursor_s* folder;
+
+  /* If NULL, the listing wasn't obtained yet or has been invalidated. */
+  struct plainmtp_cursor_s** listing;
+  size_t listing_count;
+} folder_cache_s;
+
+struct plainmtp_queue_s {
+  struct plainmtp_device_s* device;
+
+  /* Jobs sorted by their priorities. */
+  job_node_s* first;
+  job_node_s* last;
+
+  size_t segment_size;
+
+  /* Cleared when a segment has failed while receiving of the whole object has succeeded. */
+  plainmtp_bool is_ranged;
+
+  folder_cache_s cache;
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN wchar_t* ZZ_PLAINMTP(copy_job_string( wchar_t** buffer, const wchar_t* string ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_folder_listing( folder_cache_s* cache ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_folder_cache( folder_cache_s* cache ));
+PLAINMTP_EXTERN int ZZ_PLAINMTP(compare_entity_names( const void* entity_a,
+  const void* entity_b ));
+PLAINMTP_EXTERN int ZZ_PLAINMTP(compare_entity_name_key( const void* key, const void* entity ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(obtain_folder_listing( folder_cache_s* cache,
+  struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(seek_child_entity( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, const wchar_t* name, size_t length ));
+PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(resolve_job_folder(
+  struct plainmtp_queue_s* queue, const plainmtp_target_s* target, size_t path_length ));
+PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(resolve_job_target(
+  struct plainmtp_queue_s* queue, const plainmtp_job_s* job ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(insert_job( struct plainmtp_queue_s* queue, job_node_s* node,
+  plainmtp_bool is_resumed ));
+PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(receive_job_segment( struct plainmtp_queue_s* queue,
+  job_node_s* node ));
+PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(execute_job( struct plainmtp_queue_s* queue,
+  job_node_s* node, struct plainmtp_cursor_s** OUT_cursor ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(finish_job( job_node_s* node,
+  struct plainmtp_cursor_s* cursor, plainmtp_bool success ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -55,6 +55,20 @@ typedef void* (*plainmtp_data_f)
   pointer for the next call (in "active" mode) or any pointer that is not NULL (in "passive" mode).
 */
 
+/* Value of the size of the entity data that is not known, e.g. because the entity is a folder. */
+#define PLAINMTP_SIZE_UNKNOWN (~(uint64_t)0)
+
+/* Coarse formats of the entities, as they're reported by the device. */
+typedef enum zz_plainmtp_format_e {
+  PLAINMTP_FORMAT_UNDEFINED,  /* Any format that doesn't fall in the other categories. */
+  PLAINMTP_FORMAT_FOLDER,
+  PLAINMTP_FORMAT_IMAGE,
+  PLAINMTP_FORMAT_AUDIO,
+  PLAINMTP_FORMAT_VIDEO,
+  PLAINMTP_FORMAT_PLAYLIST,
+  PLAINMTP_FORMAT_DOCUMENT
+} plainmtp_format_e;
+
 /* Library context. Pointer to it can be typecast to 'plainmtp_context_s*' to access information
   about available devices connected to the machine. */
 PLAINMTP_OPAQUE(struct plainmtp_context_s) {
@@ -66,6 +80,7 @@ PLAINMTP_OPAQUE(struct plainmtp_context_s) {
     const wchar_t* const* names;
     const wchar_t* const* captions;
     const wchar_t* const* vendors;
+    const wchar_t* const* serials;
   } endpoints;
 
   struct {
@@ -74,9 +89,62 @@ PLAINMTP_OPAQUE(struct plainmtp_context_s) {
   } features;
 } const plainmtp_context_s;
 
+/* Filter of the devices to be registered in the context. Zero members match any device. */
+typedef struct zz_plainmtp_filter_s {
+  /* USB vendor and product IDs. */
+  uint16_t vendor_id;
+  uint16_t product_id;
+
+  /* USB bus number and the address of the device on it. Note that the latter changes whenever the
+    device is reconnected. Some implementations don't provide these, so they're ignored there. */
+  uint32_t bus_location;
+  uint8_t device_number;
+
+  /* Serial number of the device. Some implementations have to open the device to obtain it, so
+    it's checked only for devices that match all the other members. */
+  const wchar_t* serial_number;
+} plainmtp_filter_s;
+
+/* Options of the library initialization. A zero-initialized structure means the default ones. */
+typedef struct zz_plainmtp_startup_s {
+  /* Whether to postpone obtaining the names, captions and vendors of the device endpoints until
+    they're probed explicitly. Some implementations have to open every device to obtain them,
+    which is slow, so otherwise they're probed in parallel across the devices. */
+  plainmtp_bool lazy_probing;
+
+  /* Devices that match any of these filters are registered, and the others are skipped without
+    being opened, except for checking the serial number. If there are no filters, all the devices
+    are registered. Endpoints filtered by the serial number are always probed. */
+  const plainmtp_filter_s* filters;
+  size_t filter_count;
+
+  /* Time in microseconds to keep the sessions of the finished devices open, so the next start of a
+    device for the same endpoint and with the same access reuses the session instead of opening a
+    new one. The sessions that have been idle for longer are closed on the next start or finish of
+    a device, or on the shutdown. Note that an open session may prevent other applications from
+    accessing the device. If 0, the sessions are closed right away. */
+  uint64_t session_idle_time;
+
+  /* Whether to provide the names of the objects as 'name_u8' in UTF-8 instead of 'name', so that
+    implementations which obtain them in UTF-8 natively pass them through without any conversions.
+    The device root and storages still have 'name'. Other implementations ignore this option. */
+  plainmtp_bool utf8_names;
+} plainmtp_startup_s;
+
 /* Device handle. The non-struct 'const plainmtp_device_s' typename is reserved for future use. */
 PLAINMTP_OPAQUE(struct plainmtp_device_s) const plainmtp_device_s;
 
+/* Compact binary form of the persistent unique ID of an entity, which can be compared with memcmp()
+  and takes 16 bytes instead of the whole string. It's available only for the IDs in the GUID form,
+  i.e. for objects, while the device root and storages (that are few) have the nil one with all the
+  bytes set to 0. The bytes are in the order they're written in the string form. */
+typedef struct zz_plainmtp_binary_id_s {
+  uint8_t bytes[16];
+} plainmtp_binary_id_s;
+
+/* Size of the buffer for the string form of a binary ID, including the null-terminator. */
+#define PLAINMTP_BINARY_ID_STRING_SIZE 39
+
 /* Cursor. This is the main primitive to access entities on the device and perform operations on
   them (enumerate child entities, create new ones, read their binary data etc). Points to the only
   one specific entity at a time. Pointer to it can be typecast to 'plainmtp_cursor_s*' to access
@@ -89,13 +157,247 @@ PLAINMTP_OPAQUE(struct plainmtp_cursor_s) {
     standard NOR guaranteed to be represented in the same GUID format as in PUID. */
   const wchar_t* id;
 
+  /* Binary form of the 'id', or the nil one if it has no such form. See plainmtp_binary_id_s. */
+  plainmtp_binary_id_s binary_id;
+
   /* Either a file name or any other descriptive string that can be used as such. Can be NULL. */
   const wchar_t* name;
 
+  /* The same as 'name', but in UTF-8. At most one of them is set, see the 'utf8_names' option. */
+  const char* name_u8;
+
   /* Date/time in standard portable C format. When not available, datetime.tm_mday is set to 0. */
   struct tm datetime;
+
+  /* Size of the object data in bytes, as reported by the device when the cursor was switched to
+    it. Contains PLAINMTP_SIZE_UNKNOWN for the device root, storages, folders and the objects that
+    don't report their size. */
+  uint64_t size;
+
+  plainmtp_format_e format;
+
+  /* Whether the entity can contain child entities, i.e. it's worth to be enumerated at all. */
+  plainmtp_bool is_container;
 } const plainmtp_cursor_s;
 
+/* Kinds of operations that are measured separately in the device statistics. */
+typedef enum zz_plainmtp_operation_e {
+  PLAINMTP_OPERATION_STARTUP,  /* Initialization of the context the device was started from. */
+  PLAINMTP_OPERATION_DEVICE_OPEN,  /* Establishing a session with the device. */
+  PLAINMTP_OPERATION_STORAGE_QUERY,  /* Obtaining the list of storages and their information. */
+  PLAINMTP_OPERATION_FOLDER_LISTING,  /* Obtaining the list of child entities. */
+  PLAINMTP_OPERATION_OBJECT_INFO,  /* Obtaining the information about a single entity. */
+  PLAINMTP_OPERATION_RECEIVE,  /* Receiving the data of an object, including callback time. */
+  PLAINMTP_OPERATION_TRANSFER,  /* Transferring the data of an object, including callback time. */
+
+  PLAINMTP_OPERATION_COUNT
+} plainmtp_operation_e;
+
+/* Bucket N of the latency histogram counts operations that took less than 10^(N+1) microseconds
+  and not less than the limit of the previous bucket. The last bucket counts all the rest. */
+enum { PLAINMTP_STATS_HISTOGRAM_SIZE = 8 };
+
+/* Performance statistics of the device handle. All the times are measured in microseconds of wall
+  clock time. Note that some implementations may never perform some kinds of operations at all. */
+typedef struct zz_plainmtp_stats_s {
+  struct {
+    uint32_t count;
+    uint32_t failures;  /* Included in 'count'. */
+    uint64_t total_time;
+    uint64_t peak_time;
+    uint32_t histogram[PLAINMTP_STATS_HISTOGRAM_SIZE];
+  } operations[PLAINMTP_OPERATION_COUNT];
+
+  /* Amount of the object data that went through the callbacks. */
+  uint64_t bytes_received;
+  uint64_t bytes_transferred;
+
+  /* Time of receive / transfer operations spent inside the user callbacks and outside of them. */
+  uint64_t callback_time;
+  uint64_t device_time;
+
+  /* Number of the calls to the underlying library that communicate with the device. Comparing it
+    before and after an API call shows how many of them the call costs. */
+  uint32_t round_trips;
+} plainmtp_stats_s;
+
+/* Heap usage of the library that is attributed to something. An allocation belongs to the API call
+  it was made in until it's freed, even if that happens in another call, and a reallocation counts
+  as a new allocation. */
+typedef struct zz_plainmtp_alloc_stats_s {
+  uint32_t count;  /* Number of the allocations made. */
+  uint64_t bytes;  /* Total size of the allocations made. */
+  uint64_t live_bytes;  /* Size of the ones that are still allocated. */
+  uint64_t peak_bytes;  /* Highest value that 'live_bytes' has ever reached. */
+} plainmtp_alloc_stats_s;
+
+/* Algorithms of the integrity digests that can be computed over the object data in transit. */
+typedef enum zz_plainmtp_digest_e {
+  PLAINMTP_DIGEST_NONE,
+  PLAINMTP_DIGEST_CRC32C,  /* CRC-32C (Castagnoli), 4 bytes in big-endian order. */
+  PLAINMTP_DIGEST_SHA256  /* SHA-256, 32 bytes. */
+} plainmtp_digest_e;
+
+enum { PLAINMTP_DIGEST_SIZE_LIMIT = 32 };
+
+/* Integrity digest of the object data. The digest is computed over exactly the same bytes that
+  are passed through the callback, in the same order, so no additional pass over them is needed. */
+typedef struct zz_plainmtp_digest_s {
+  /* The algorithm requested by user. Unsupported values are replaced with PLAINMTP_DIGEST_NONE. */
+  plainmtp_digest_e algorithm;
+
+  /* The actual size of the resulting value, in bytes. It is 0 if no digest was computed. */
+  size_t size;
+
+  uint8_t value[PLAINMTP_DIGEST_SIZE_LIMIT];
+} plainmtp_digest_s;
+
+/* On-disk cache of thumbnails on the host side. */
+PLAINMTP_OPAQUE(struct plainmtp_thumbnail_cache_s) const plainmtp_thumbnail_cache_s;
+
+/* Data exchange that is performed step by step, so that the caller decides when to continue it. */
+PLAINMTP_OPAQUE(struct plainmtp_exchange_s) const plainmtp_exchange_s;
+
+/* Job queue bound to a device handle. It allows to perform a lot of receive / transfer operations
+  back-to-back within the same session, sharing the path lookups between them. */
+PLAINMTP_OPAQUE(struct plainmtp_queue_s) const plainmtp_queue_s;
+
+/* Specification of an entity on the device for the deferred operations. */
+typedef struct zz_plainmtp_target_s {
+  /* Cursor that points to the base entity. If NULL, 'entity_id' is used instead. The cursor is
+    copied when the job is enqueued, so the original one may be changed or freed after that. */
+  struct plainmtp_cursor_s* cursor;
+
+  /* Persistent unique ID of the base entity. If NULL, the device root is used. */
+  const wchar_t* entity_id;
+
+  /* Names of entities to descend through from the base one, separated by 'delimiter'. Can be NULL.
+    NB: Both PTP and MTP technically allow duplicate names, in which case any of them may match. */
+  const wchar_t* path;
+  wchar_t delimiter;
+} plainmtp_target_s;
+
+struct zz_plainmtp_job_s;
+
+/* This is the prototype of a callback function that is called once for every enqueued job when it
+  is completed, failed or discarded. */
+typedef void (*plainmtp_done_f)
+(
+  /* The job as it was enqueued. All the pointers in it are valid only until the callback returns,
+    and the 'target.cursor' refers to the copy made by the queue. */
+  const struct zz_plainmtp_job_s* job,
+
+  /* Cursor that points to the received object or to the transferred one. It can be NULL (e.g. if
+    the job has failed) and is owned by the queue, so use plainmtp_cursor_assign() to keep it. */
+  struct plainmtp_cursor_s* cursor,
+
+  /* Whether the operation has succeeded. */
+  plainmtp_bool success
+);
+
+/* This is the prototype of a callback function that performs a custom operation as a job, so that
+  it is scheduled along with the others, e.g. an interactive listing of a folder. */
+typedef plainmtp_bool (*plainmtp_task_f)
+(
+  /* The job as it was enqueued. See plainmtp_done_f description for details. */
+  const struct zz_plainmtp_job_s* job,
+
+  /* Cursor that points to the target entity. It is owned by the queue and must point to the same
+    entity when the callback returns, so any enumeration started on it must be finished. */
+  struct plainmtp_cursor_s* cursor,
+
+  /* Handle of the device the queue is bound to. */
+  struct plainmtp_device_s* device
+);  /*
+  Returns the result to be passed to the completion callback of the job.
+*/
+
+/* Description of a deferred receive, transfer or custom operation. */
+typedef struct zz_plainmtp_job_s {
+  /* The object to be received, or the parent entity of the object to be transferred. */
+  plainmtp_target_s target;
+
+  /* Jobs with a higher priority are executed first, and jobs with the same priority are executed in
+    the order they were enqueued. Receive jobs are executed in segments when possible, so a job with
+    a higher priority waits for at most one segment of a large object rather than for all of it. */
+  int priority;
+
+  /* Custom operation. If not NULL, it is executed on the target instead of receiving it, and the
+    members related to the data exchange are ignored. */
+  plainmtp_task_f task;
+
+  /* Name for the new object. If NULL, this is a receive job; otherwise, it is a transfer one. */
+  const wchar_t* name;
+
+  /* These are the same as for plainmtp_cursor_transfer() or plainmtp_cursor_receive(). The 'size'
+    member is ignored for receive jobs. The callback is still called for its final call even if
+    the job has failed before the data exchange or was discarded, so it can release its state. */
+  uint64_t size;
+  size_t chunk_limit;
+  plainmtp_data_f callback;
+  void* custom_state;
+
+  /* Optional digest to be filled on completion. It must remain valid until the job is done. */
+  plainmtp_digest_s* digest;
+
+  /* Optional completion callback. */
+  plainmtp_done_f done;
+} plainmtp_job_s;
+
+/* Engine that executes jobs on multiple devices in parallel, with a worker thread per device. */
+PLAINMTP_OPAQUE(struct plainmtp_engine_s) const plainmtp_engine_s;
+
+/* Index of the engine device to let the job be executed by the first one that becomes idle. */
+#define PLAINMTP_ANY_DEVICE (~(size_t)0)
+
+/* Progress of the jobs executed by the engine. */
+typedef struct zz_plainmtp_progress_s {
+  /* Devices whose sessions were established, and the ones that failed to establish it. */
+  size_t devices_ready;
+  size_t devices_failed;
+
+  /* Jobs waiting for a worker, executed at the moment, and completed both successfully and not. */
+  size_t jobs_pending;
+  size_t jobs_running;
+  size_t jobs_finished;
+
+  /* Amount of the object data that went through the callbacks of the jobs. */
+  uint64_t bytes_received;
+  uint64_t bytes_transferred;
+} plainmtp_progress_s;
+
+/* Completion channel that lets an event loop receive the results of the asynchronous operations on
+  its own thread, instead of blocking until the devices answer. */
+PLAINMTP_OPAQUE(struct plainmtp_events_s) const plainmtp_events_s;
+
+/* Descriptor to be watched by an event loop for the completions to become available. */
+typedef struct zz_plainmtp_pollfd_s {
+  /* File descriptor that becomes readable on POSIX systems, e.g. for poll() or epoll. It is -1 on
+    Windows. */
+  int fd;
+
+  /* Handle of the event object that becomes signaled on Windows, e.g. for
+    WaitForMultipleObjects(). It is NULL on POSIX systems. */
+  void* handle;
+} plainmtp_pollfd_s;
+
+/* This is the prototype of a callback function that reports the result of an asynchronous
+  operation. It is called from plainmtp_process_events() on the thread of the event loop. */
+typedef void (*plainmtp_complete_f)
+(
+  /* Cursor that points to the entity the operation has resulted in: the target one for switching,
+    a child one for selection, the received object, or the transferred one. It can be NULL (e.g. if
+    the operation has failed) and is owned by the library, so use plainmtp_cursor_assign() to keep
+    it. The cursor can be passed as the target of further operations on the same device. */
+  struct plainmtp_cursor_s* cursor,
+
+  /* Whether the operation has succeeded. */
+  plainmtp_bool success,
+
+  /* An arbitrary user's pointer that was passed to the operation. */
+  void* custom_state
+);
+
 /**************************************************************************************************/
 
 #ifdef __cplusplus
@@ -107,7 +409,47 @@ extern struct plainmtp_context_s* plainmtp_startup(void);  /*
   Returns a pointer to the allocated context. If initialization has failed, returns NULL.
 */
 
-/* Finalize the library and dispose the operating context. */
+/* Same as plainmtp_startup(), but with the options specified. */
+extern struct plainmtp_context_s* plainmtp_startup_ex
+(
+  /* Options of the initialization. If NULL, the default ones are used. */
+  const plainmtp_startup_s* options
+);
+
+/* Obtain the name, caption and vendor of the device endpoint, if they weren't obtained yet. This
+  is required only if the context was initialized with lazy probing. It changes the registry, so it
+  must not be called while the context is used in another thread, e.g. by an engine. */
+extern plainmtp_bool plainmtp_endpoint_probe
+(
+  /* A pointer to the operating context. */
+  struct plainmtp_context_s* context,
+
+  /* Index of the device endpoint in the context registry. */
+  size_t endpoint_index
+);  /*
+  Returns True if the endpoint was probed successfully now or before, False otherwise. Note that the
+  strings may still be NULL in the former case if the device doesn't report them.
+*/
+
+/* Update the registry to match the devices that are connected to the machine now. The endpoints
+  of the devices that remain connected keep their keys and strings, so only the newly connected
+  ones are probed, but the indices of the endpoints may change. Device handles that were already
+  started stay valid. This must not be called while the context is used in another thread. */
+extern plainmtp_bool plainmtp_context_refresh
+(
+  /* A pointer to the operating context. */
+  struct plainmtp_context_s* context,
+
+  /* Options of the initialization, which apply to the whole registry again, so the endpoints that
+    don't match the filters anymore are removed. The session idle time is not changed, but the
+    pooled sessions of the removed endpoints are closed. If NULL, the default ones are used. */
+  const plainmtp_startup_s* options
+);  /*
+  Returns True if the registry was updated, False otherwise. The registry is left intact then.
+*/
+
+/* Finalize the library and dispose the operating context. All the devices must be finished before
+  this, and the sessions that are kept open for reuse are closed. */
 extern void plainmtp_shutdown
 (
   /* A pointer to the operating context that was allocated by plainmtp_startup(). */
@@ -129,13 +471,108 @@ extern struct plainmtp_device_s* plainmtp_device_start
   Returns a pointer to the allocated device handle. If session wasn't opened, returns NULL.
 */
 
-/* Close a session with the device and release resources acquired for the device handle. */
+/* Close a session with the device and release resources acquired for the device handle. If the
+  context keeps the sessions for reuse, the session is kept open, but the handle must not be used
+  anymore anyway. */
 extern void plainmtp_device_finish
 (
   /* A pointer to the device handle that was obtained through plainmtp_device_start(). */
   struct plainmtp_device_s* device
 );
 
+/* Take exclusive access to the device to perform a sequence of operations without interleaving
+  them with the ones from other threads. If the library was built with the CC_PLAINMTP_THREAD_SAFE
+  option, every API function that accepts a device handle does this internally for its duration,
+  so the handle can be shared across threads. A cursor can be passed between threads, but it must
+  not be used by several threads at the same time; the same is true for a job queue. */
+extern plainmtp_bool plainmtp_device_acquire
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device,
+
+  /* Flag to wait for the device (True), or to fail immediately if it's busy (False). */
+  plainmtp_bool wait
+);  /*
+  Returns True if access has been taken, False otherwise. In the former case, the device must be
+  released with plainmtp_device_release() by the same thread. Access can be taken recursively.
+  If the library was built without the CC_PLAINMTP_THREAD_SAFE option, always returns True.
+*/
+
+/* Give up exclusive access to the device that was taken by plainmtp_device_acquire(). */
+extern void plainmtp_device_release
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device
+);
+
+/* Obtain the performance statistics accumulated since the session start or the last reset. */
+extern void plainmtp_device_get_stats
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device,
+
+  /* A pointer to the structure to be filled with the statistics. */
+  plainmtp_stats_s* OUT_stats
+);
+
+/* Discard the performance statistics accumulated for the device handle. */
+extern void plainmtp_device_reset_stats
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device
+);
+
+/* Start recording the calls to the underlying library that communicate with the device, along with
+  the spans of the API calls that have made them, to find the access patterns that cost extra round
+  trips. A recording that is already in progress is discarded. */
+extern plainmtp_bool plainmtp_device_start_trace
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device,
+
+  /* Maximum number of the events to be recorded. The ones beyond it are dropped, but counted. */
+  size_t capacity
+);  /*
+  Returns True if recording has started, False otherwise.
+*/
+
+/* Stop recording and write the recorded events into a file in the Chrome trace event format, which
+  can be viewed with chrome://tracing or Perfetto. The recording is discarded when the device handle
+  is finished anyway. */
+extern plainmtp_bool plainmtp_device_stop_trace
+(
+  /* A pointer to the device handle. */
+  struct plainmtp_device_s* device,
+
+  /* Path to the file to be created or overwritten. If NULL, the recording is just discarded. */
+  const wchar_t* path
+);  /*
+  Returns True if the file has been written or wasn't requested, False otherwise. The recording is
+  stopped in both cases.
+*/
+
+/* Obtain the heap usage of the API calls on the device handle, to find the ones that make the
+  memory grow in long sessions. This requires the library to be built with the option named
+  CC_PLAINMTP_ALLOC_ACCOUNTING, which makes every allocation of the library slower. Nested API calls
+  on the same device are attributed to the outermost one. The allocations that outlive the device
+  handle are no longer accounted once it's finished. */
+extern plainmtp_bool plainmtp_device_get_alloc_stats
+(
+  /* A pointer to the device handle. If NULL, the allocations made outside of the API calls on the
+    devices are reported, e.g. by the context or by the device starts. */
+  struct plainmtp_device_s* device,
+
+  /* Name of the API function, e.g. "plainmtp_cursor_select". If NULL, the allocations made by all
+    the API calls on the device are reported. Ignored if 'device' is NULL. */
+  const char* api_name,
+
+  /* A pointer to the structure to be filled with the heap usage. */
+  plainmtp_alloc_stats_s* OUT_stats
+);  /*
+  Returns True on success, False if the function has never been called on the device, or if the
+  library was built without the CC_PLAINMTP_ALLOC_ACCOUNTING option.
+*/
+
 /* Set cursor to entity specified by another one. */
 extern struct plainmtp_cursor_s* plainmtp_cursor_assign
 (
@@ -149,6 +586,21 @@ extern struct plainmtp_cursor_s* plainmtp_cursor_assign
   If an error has occurred or cursor was freed, returns NULL. A cursor retains its state on error.
 */
 
+/* Make a copy of the cursor from the cursor pool of the device, which keeps the memory of disposed
+  cursors for reuse. Copying into such a cursor with plainmtp_cursor_assign() and disposing it thus
+  need no memory allocations in the steady state, except for entities with very long names. */
+extern struct plainmtp_cursor_s* plainmtp_cursor_copy
+(
+  /* Cursor to be copied. */
+  struct plainmtp_cursor_s* source,
+
+  /* Handle of the device whose pool is used. The cursor must be freed before the device is
+    finished, but it may point to an entity of any device. */
+  struct plainmtp_device_s* device
+);  /*
+  Returns a pointer to the created cursor. If an error has occurred, returns NULL.
+*/
+
 /* Set cursor to entity by its persistent unique ID. */
 extern struct plainmtp_cursor_s* plainmtp_cursor_switch
 (
@@ -165,6 +617,62 @@ extern struct plainmtp_cursor_s* plainmtp_cursor_switch
   If an error has occurred or cursor was freed, returns NULL. A cursor retains its state on error.
 */
 
+/* Same as plainmtp_cursor_switch(), but accepts the binary form of the ID, which saves parsing of
+  the string form. */
+extern struct plainmtp_cursor_s* plainmtp_cursor_switch_binary
+(
+  struct plainmtp_cursor_s* cursor,
+
+  /* Binary form of the persistent unique ID of the entity. Must not be the nil one. */
+  const plainmtp_binary_id_s* entity_id,
+
+  struct plainmtp_device_s* device
+);  /*
+  Returns 'cursor' if it was changed; or a pointer to the created cursor.
+  If an error has occurred or cursor was freed, returns NULL. A cursor retains its state on error.
+*/
+
+/* Obtain the binary form of the persistent unique ID, e.g. to convert an index of IDs that were
+  stored in the string form. */
+extern plainmtp_bool plainmtp_binary_id_parse
+(
+  /* A pointer to the binary ID to be filled. It's set to the nil one if the ID has no such form. */
+  plainmtp_binary_id_s* OUT_binary_id,
+
+  /* Persistent unique ID of the entity. */
+  const wchar_t* entity_id
+);  /*
+  Returns True if the ID has the binary form, False otherwise.
+*/
+
+/* Derive the string form of the binary ID, which is the same as the 'id' of the cursor. */
+extern void plainmtp_binary_id_format
+(
+  /* Binary ID to be formatted. Must not be the nil one. */
+  const plainmtp_binary_id_s* binary_id,
+
+  /* Buffer of PLAINMTP_BINARY_ID_STRING_SIZE characters to receive the string form. */
+  wchar_t* OUT_string
+);
+
+/* Compare the binary IDs. This defines a total order, e.g. for sorting or binary search. */
+extern int plainmtp_binary_id_compare
+(
+  const plainmtp_binary_id_s* left,
+  const plainmtp_binary_id_s* right
+);  /*
+  Returns a negative value if 'left' is less than 'right', a positive one if it's greater, or 0 if
+  they are equal, just like memcmp().
+*/
+
+/* Calculate a hash of the binary ID for hash tables. It's stable across runs and platforms. */
+extern size_t plainmtp_binary_id_hash
+(
+  const plainmtp_binary_id_s* binary_id
+);  /*
+  Returns the hash value.
+*/
+
 /* Updates the cursor information about the entity that is accessible by user through typecasting
   cursor to 'plainmtp_image_s*' type. If there's an enumeration in progress, it will be finished if
   function succeeds. */
@@ -240,6 +748,116 @@ extern plainmtp_bool plainmtp_cursor_receive
   Returns True if object has been received successfully, False otherwise.
 */
 
+/* Same as plainmtp_cursor_receive(), but also computes the integrity digest of the data. */
+extern plainmtp_bool plainmtp_cursor_receive_digest
+(
+  struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state,
+
+  /* A pointer to the digest with the 'algorithm' field set to the desired value. The rest of the
+    fields will be filled when the function returns. Can be NULL to skip the digest computation. */
+  plainmtp_digest_s* digest
+);  /*
+  Returns True if object has been received successfully, False otherwise. The digest is filled in
+  both cases and corresponds to the data that was actually passed to the callback.
+*/
+
+/* Receive only the specified range of the data of the object pointed to by the cursor. This allows
+  to split the receiving of large objects so that other operations can be performed in between. */
+extern plainmtp_bool plainmtp_cursor_receive_range
+(
+  struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device,
+
+  /* Offset of the range from the beginning of the object data, in bytes. */
+  uint64_t offset,
+
+  /* Size of the range, in bytes. Less data is received if the range exceeds the object data. */
+  size_t length,
+
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state
+);  /*
+  Returns True if the range has been received successfully, False otherwise. It also fails without
+  calling the callback at all if the device doesn't support partial receiving.
+*/
+
+/* Receive the data of the object pointed to by the cursor into a file on the host. If the object
+  size is known, the file is preallocated and mapped into memory, so the data is written there
+  directly without any intermediate buffers (in "active" mode) and without fragmentation. */
+extern plainmtp_bool plainmtp_cursor_receive_file
+(
+  struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device,
+
+  /* Path to the file to be created or overwritten. */
+  const wchar_t* path,
+
+  size_t chunk_limit,
+
+  /* See plainmtp_cursor_receive_digest() for details. */
+  plainmtp_digest_s* digest
+);  /*
+  Returns True if object has been received successfully, False otherwise. The file is removed in
+  the latter case.
+*/
+
+/* Receive the thumbnail image of the object pointed to by the cursor. This is much faster than
+  receiving the object itself if only a preview of it is needed. */
+extern plainmtp_bool plainmtp_cursor_receive_thumbnail
+(
+  struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state
+);  /*
+  Returns True if the thumbnail has been received successfully, False otherwise. It also fails
+  without calling the callback at all if the object has no thumbnail.
+*/
+
+/* Open the on-disk thumbnail cache. */
+extern struct plainmtp_thumbnail_cache_s* plainmtp_thumbnail_cache_open
+(
+  /* Path to an existing directory to keep the cached thumbnails in. */
+  const wchar_t* directory
+);  /*
+  Returns a pointer to the allocated cache. If an error has occurred, returns NULL.
+*/
+
+/* Close the thumbnail cache. The cached thumbnails are retained in its directory. */
+extern void plainmtp_thumbnail_cache_close
+(
+  /* A pointer to the cache that was allocated by plainmtp_thumbnail_cache_open(). */
+  struct plainmtp_thumbnail_cache_s* cache
+);
+
+/* Same as plainmtp_cursor_receive_thumbnail(), but the thumbnail is taken from the cache if it was
+  received before, and is stored in it otherwise. Thumbnails are keyed by the object ID along with
+  its size and date/time, so they're never cached for objects without the latter. */
+extern plainmtp_bool plainmtp_cursor_receive_thumbnail_cached
+(
+  struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device,
+
+  /* Cache to look up the thumbnail in. Can be NULL, so the thumbnail is always received. The same
+    cache can be used by several threads at once. */
+  struct plainmtp_thumbnail_cache_s* cache,
+
+  size_t chunk_limit,
+
+  /* NB: The callback operates in "passive" mode when the thumbnail is taken from the cache. */
+  plainmtp_data_f callback,
+
+  void* custom_state
+);  /*
+  Returns True if the thumbnail has been received successfully, False otherwise.
+*/
+
 /* Transfer data as the new child object. */
 extern plainmtp_bool plainmtp_cursor_transfer
 (
@@ -276,6 +894,358 @@ extern plainmtp_bool plainmtp_cursor_transfer
   the underlying value will be NULL.
 */
 
+/* Same as plainmtp_cursor_transfer(), but also computes the integrity digest of the data. */
+extern plainmtp_bool plainmtp_cursor_transfer_digest
+(
+  struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device,
+  const wchar_t* name,
+  uint64_t size,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state,
+  struct plainmtp_cursor_s** SET_cursor,
+
+  /* See plainmtp_cursor_receive_digest() for details. */
+  plainmtp_digest_s* digest
+);
+
+/* Same as plainmtp_cursor_transfer(), but accepts the name in UTF-8, which is passed through
+  without any conversions to the implementations that use UTF-8 natively. */
+extern plainmtp_bool plainmtp_cursor_transfer_u8
+(
+  struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device,
+
+  /* Name for the new object in UTF-8. */
+  const char* name,
+
+  uint64_t size,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state,
+  struct plainmtp_cursor_s** SET_cursor
+);
+
+/* Begin receiving the data of the object step by step. No data is exchanged until the first step,
+  and the cursor and the device can be used for other operations in between the steps. */
+extern struct plainmtp_exchange_s* plainmtp_exchange_begin_receive
+(
+  /* Cursor that points to the object to be received. It is copied, so the original one may be
+    changed or freed after that. */
+  struct plainmtp_cursor_s* cursor,
+
+  /* Handle of the device the object belongs to. It must outlive the exchange. */
+  struct plainmtp_device_s* device,
+
+  /* These are the same as for plainmtp_cursor_receive(). The callback is called only from within
+    the steps and the end of the exchange. */
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state
+);  /*
+  Returns a pointer to the allocated exchange. If an error has occurred, returns NULL.
+*/
+
+/* Begin transferring data as the new child object step by step. NB: Neither PTP nor MTP allow to
+  suspend sending of an object, so the whole object is transferred within the first step. */
+extern struct plainmtp_exchange_s* plainmtp_exchange_begin_transfer
+(
+  /* Cursor that points to the entity to be the parent of a new one. It is copied as well. */
+  struct plainmtp_cursor_s* parent,
+
+  struct plainmtp_device_s* device,
+
+  /* These are the same as for plainmtp_cursor_transfer(). */
+  const wchar_t* name,
+  uint64_t size,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+  void* custom_state
+);  /*
+  Returns a pointer to the allocated exchange. If an error has occurred, returns NULL.
+*/
+
+/* Advance the exchange by a bounded amount of data. */
+extern plainmtp_bool plainmtp_exchange_step
+(
+  /* Exchange to be advanced. */
+  struct plainmtp_exchange_s* exchange,
+
+  /* Maximum amount of the object data to be exchanged, in bytes. Must not be 0. If the device
+    doesn't support partial receiving, the whole object is received within the first step. */
+  size_t step_size
+);  /*
+  Returns True if there's more data to be exchanged. If the exchange is completed, or an error has
+  occurred, returns False. This allows to drive the exchange with a simple 'while' loop.
+*/
+
+/* Finish the exchange and dispose it. If it's not completed yet, it is aborted, and the final call
+  of the callback is made anyway. */
+extern plainmtp_bool plainmtp_exchange_end
+(
+  /* A pointer to the exchange that was allocated by one of the plainmtp_exchange_begin_*(). */
+  struct plainmtp_exchange_s* exchange,
+
+  /* A pointer to the cursor that will be set to the transferred object, the same as for
+    plainmtp_cursor_transfer(). It is left unchanged if no object was transferred. Can be NULL. */
+  struct plainmtp_cursor_s** SET_cursor
+);  /*
+  Returns True if the exchange has been completed successfully, False otherwise.
+*/
+
+/* Create a job queue for the device. */
+extern struct plainmtp_queue_s* plainmtp_queue_create
+(
+  /* Handle of the device the jobs will be executed on. It must outlive the queue. */
+  struct plainmtp_device_s* device
+);  /*
+  Returns a pointer to the allocated queue. If an error has occurred, returns NULL.
+*/
+
+/* Dispose the job queue. All the jobs still pending are discarded, reporting failure. */
+extern void plainmtp_queue_destroy
+(
+  /* A pointer to the queue that was allocated by plainmtp_queue_create(). */
+  struct plainmtp_queue_s* queue
+);
+
+/* Add a job to the queue according to its priority. */
+extern plainmtp_bool plainmtp_queue_push
+(
+  /* Queue to add the job to. */
+  struct plainmtp_queue_s* queue,
+
+  /* Description of the job. It is copied along with all the strings, and the target cursor. */
+  const plainmtp_job_s* job
+);  /*
+  Returns True if the job has been enqueued, False otherwise. The completion callback of the job
+  is not called in the latter case.
+*/
+
+/* Set the size of segments the receive jobs are executed in. The default one is 8 MiB. */
+extern void plainmtp_queue_set_segment_size
+(
+  /* Queue to change the setting of. */
+  struct plainmtp_queue_s* queue,
+
+  /* Size of the segment, in bytes. If 0, objects are always received as a whole. */
+  size_t segment_size
+);
+
+/* Execute pending jobs one step at a time, selecting the job with the highest priority before each
+  step. A step is either the whole job, or a single segment of a receive job. Jobs pushed between
+  the calls to this function (or from the callbacks) thus preempt the lower-priority ones. */
+extern size_t plainmtp_queue_run
+(
+  /* Queue to execute the jobs from. */
+  struct plainmtp_queue_s* queue,
+
+  /* Maximum number of steps to execute. If 0, the queue is run until it becomes empty. */
+  size_t step_limit
+);  /*
+  Returns the number of steps that were executed, both successfully and not.
+*/
+
+/* Create an engine that establishes sessions with the devices in parallel and then executes jobs
+  on them, each in its own worker thread. Jobs targeted to a specific device are executed only by
+  its worker, while jobs for any device are taken by the workers as they become idle. This requires
+  the library to be built with the CC_PLAINMTP_THREAD_SAFE option on Windows. */
+extern struct plainmtp_engine_s* plainmtp_engine_create
+(
+  /* A pointer to the operating context. It must outlive the engine. */
+  struct plainmtp_context_s* context,
+
+  /* Indices of the device endpoints in the context registry. If NULL, all the endpoints are used,
+    and 'endpoint_count' is ignored. Devices are referred to by their positions in this array. */
+  const size_t* endpoint_indices,
+  size_t endpoint_count,
+
+  /* Flag to request read-only (True) or read-write (False) access to the devices. */
+  plainmtp_bool read_only
+);  /*
+  Returns a pointer to the allocated engine. If an error has occurred, returns NULL. The sessions
+  are established asynchronously, so this doesn't wait for the devices.
+*/
+
+/* Stop the workers and dispose the engine. Jobs that are executed at the moment are completed, and
+  all the pending ones are discarded, reporting failure. */
+extern void plainmtp_engine_destroy
+(
+  /* A pointer to the engine that was allocated by plainmtp_engine_create(). */
+  struct plainmtp_engine_s* engine
+);
+
+/* Add a job to the engine according to its priority. A job with a higher priority than the one
+  executed by a worker that can take it preempts the latter between its steps, the same way as in a
+  queue. The callbacks of the job are called from the worker thread that executes it, but never
+  from several threads at the same time. */
+extern plainmtp_bool plainmtp_engine_push
+(
+  /* Engine to add the job to. */
+  struct plainmtp_engine_s* engine,
+
+  /* Description of the job, the same as for plainmtp_queue_push(). The target cursor must be NULL
+    for jobs that can be executed on any device, as a cursor belongs to a specific one. */
+  const plainmtp_job_s* job,
+
+  /* Position of the device in the engine, or PLAINMTP_ANY_DEVICE. */
+  size_t device_index
+);  /*
+  Returns True if the job has been enqueued, False otherwise (e.g. if the session with the device
+  has failed to be established). The completion callback of the job is not called in the latter
+  case.
+*/
+
+/* Wait until the engine has no jobs that are pending or executed at the moment. This must not be
+  called from the callbacks of the jobs. */
+extern void plainmtp_engine_wait
+(
+  /* Engine to wait for. */
+  struct plainmtp_engine_s* engine
+);
+
+/* Obtain the progress of the jobs executed by the engine. It is safe to call at any time. */
+extern void plainmtp_engine_get_progress
+(
+  /* Engine to obtain the progress of. */
+  struct plainmtp_engine_s* engine,
+
+  /* Position of the device in the engine to obtain its own progress, or PLAINMTP_ANY_DEVICE to
+    obtain the aggregate one. Pending jobs for any device are counted only in the latter case. */
+  size_t device_index,
+
+  /* A pointer to the structure to be filled with the progress. */
+  plainmtp_progress_s* OUT_progress
+);
+
+/* Create a completion channel for the asynchronous operations. */
+extern struct plainmtp_events_s* plainmtp_events_create(void);  /*
+  Returns a pointer to the allocated channel. If an error has occurred, returns NULL.
+*/
+
+/* Dispose the completion channel. The completions that were not processed yet are processed by
+  this function, so all the callbacks are called anyway. */
+extern void plainmtp_events_destroy
+(
+  /* A pointer to the channel that was allocated by plainmtp_events_create(). The engines that the
+    operations were submitted to must be destroyed before it. */
+  struct plainmtp_events_s* events
+);
+
+/* Obtain the descriptors to be watched by an event loop. They stay the same for the whole life of
+  the channel, and become ready when there are completions to be processed. */
+extern size_t plainmtp_get_pollfds
+(
+  /* Channel to obtain the descriptors of. */
+  struct plainmtp_events_s* events,
+
+  /* Array to be filled with the descriptors. Can be NULL only if 'fd_limit' is 0. */
+  plainmtp_pollfd_s* OUT_fds,
+
+  /* Number of elements in the array. */
+  size_t fd_limit
+);  /*
+  Returns the number of the descriptors, which may be greater than 'fd_limit'.
+*/
+
+/* Call the completion callbacks of the operations that have finished, in the order they finished.
+  The descriptors are reset once there are no completions left. This never blocks. */
+extern size_t plainmtp_process_events
+(
+  /* Channel to process the completions of. */
+  struct plainmtp_events_s* events,
+
+  /* Maximum number of completions to process. If 0, all the available ones are processed. */
+  size_t event_limit
+);  /*
+  Returns the number of completions that were processed.
+*/
+
+/* Start switching to an entity asynchronously. The operations are executed by the worker of the
+  engine device, as the devices can't be accessed without blocking, and are scheduled along with
+  the jobs with the highest priority, INT_MAX. Thus, they preempt the jobs that have a lower one
+  between their steps, and the callbacks of the data exchange are called from the worker thread. */
+extern plainmtp_bool plainmtp_async_switch
+(
+  /* Channel to report the completion to. */
+  struct plainmtp_events_s* events,
+
+  /* Engine to execute the operation on. */
+  struct plainmtp_engine_s* engine,
+
+  /* Position of the device in the engine. See plainmtp_engine_push() for details. */
+  size_t device_index,
+
+  /* Entity to switch to. See plainmtp_target_s description for details. */
+  const plainmtp_target_s* target,
+
+  /* Callback function to report the completion to. */
+  plainmtp_complete_f complete,
+
+  /* An arbitrary user's pointer that will be passed to callbacks unchanged. */
+  void* custom_state
+);  /*
+  Returns True if the operation has been started, False otherwise. The completion callback is not
+  called in the latter case. The same applies to all the asynchronous operations.
+*/
+
+/* Start enumerating the child entities asynchronously. The completion callback is called once for
+  every child entity with a cursor pointing to it, and then once more with NULL as the cursor. The
+  latter call reports whether the enumeration has succeeded. */
+extern plainmtp_bool plainmtp_async_select
+(
+  struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine,
+  size_t device_index,
+
+  /* Entity to enumerate the child entities of. */
+  const plainmtp_target_s* target,
+
+  plainmtp_complete_f complete,
+  void* custom_state
+);
+
+/* Start receiving the data of an object asynchronously. */
+extern plainmtp_bool plainmtp_async_receive
+(
+  struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine,
+  size_t device_index,
+
+  /* Object to be received. */
+  const plainmtp_target_s* target,
+
+  /* These are the same as for plainmtp_cursor_receive(). The callback is called from the worker
+    thread, but never from several threads at the same time. */
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+
+  plainmtp_complete_f complete,
+  void* custom_state
+);
+
+/* Start transferring data as the new child object asynchronously. */
+extern plainmtp_bool plainmtp_async_transfer
+(
+  struct plainmtp_events_s* events,
+  struct plainmtp_engine_s* engine,
+  size_t device_index,
+
+  /* Entity to be the parent of the new object. */
+  const plainmtp_target_s* target,
+
+  /* These are the same as for plainmtp_cursor_transfer(). See plainmtp_async_receive() for the
+    details on the callback. */
+  const wchar_t* name,
+  uint64_t size,
+  size_t chunk_limit,
+  plainmtp_data_f callback,
+
+  plainmtp_complete_f complete,
+  void* custom_state
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <wchar.h>
 
 #include "object_queue.c.h"
 #include "utf8_wchar.c.h"
@@ -21,6 +22,7 @@ PLAINMTP_INTERNAL void set_object_values( entity_location_s* descriptor,
   /* Fix libmtp semantic nonsense with root parent_id != LIBMTP_FILES_AND_FOLDERS_ROOT.
     https://github.com/libmtp/libmtp/commit/4c162fa4eef539fa4eae3f4f92f0f4bf60d70c19 */
   descriptor->parent_handle = (object->parent_id == 0) ? OBJECT_HANDLE_NULL : object->parent_id;
+  descriptor->object_size = object->filesize;
 }}
 
 #define set_storage_values ZZ_PLAINMTP(set_storage_values)
@@ -29,6 +31,7 @@ PLAINMTP_INTERNAL void set_storage_values( entity_location_s* descriptor, uint32
   descriptor->storage_id = storage_id;
   descriptor->object_handle = OBJECT_HANDLE_NULL;
   descriptor->parent_handle = OBJECT_HANDLE_NULL;
+  descriptor->object_size = 0;
 }}
 
 #define get_cursor_state ZZ_PLAINMTP(get_cursor_state)
@@ -78,6 +81,282 @@ PLAINMTP_INTERNAL wchar_t* make_device_string( LIBMTP_mtpdevice_t* socket,
   return result;
 }}
 
+#define set_endpoint_strings ZZ_PLAINMTP(set_endpoint_strings)
+PLAINMTP_INTERNAL void set_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index, LIBMTP_mtpdevice_t* socket
+) {
+{
+  if (context->is_probed[endpoint_index]) { return; }
+
+  context->endpoint_names[endpoint_index] = make_device_string( socket,
+    LIBMTP_Get_Friendlyname );
+  context->endpoint_captions[endpoint_index] = make_device_string( socket,
+    LIBMTP_Get_Modelname );
+  context->endpoint_vendors[endpoint_index] = make_device_string( socket,
+    LIBMTP_Get_Manufacturername );
+  context->endpoint_serials[endpoint_index] = make_device_string( socket,
+    LIBMTP_Get_Serialnumber );
+
+  context->is_probed[endpoint_index] = PLAINMTP_TRUE;
+}}
+
+#define probe_endpoint ZZ_PLAINMTP(probe_endpoint)
+PLAINMTP_INTERNAL plainmtp_bool probe_endpoint( struct plainmtp_context_s* context,
+  size_t endpoint_index
+) {
+  LIBMTP_mtpdevice_t* libmtp_socket;
+{
+  if (context->is_probed[endpoint_index]) { return PLAINMTP_TRUE; }
+
+  libmtp_socket = LIBMTP_Open_Raw_Device_Uncached( &context->hardware_list[endpoint_index] );
+  if (libmtp_socket == NULL) { return PLAINMTP_FALSE; }
+
+  set_endpoint_strings( context, endpoint_index, libmtp_socket );
+  LIBMTP_Release_Device( libmtp_socket );
+
+  return PLAINMTP_TRUE;
+}}
+
+#define CB_probe_endpoint ZZ_PLAINMTP(cb_probe_endpoint)
+PLAINMTP_INTERNAL void CB_probe_endpoint( void* task ) {
+{
+  (void)probe_endpoint( ((probe_task_s*)task)->context, ((probe_task_s*)task)->endpoint_index );
+}}
+
+#define probe_all_endpoints ZZ_PLAINMTP(probe_all_endpoints)
+PLAINMTP_INTERNAL void probe_all_endpoints( struct plainmtp_context_s* context ) {
+  probe_task_s* tasks = NULL;
+  size_t i, count = context->origin.endpoints.count;
+{
+  /* NB: Opening a device takes most of the time waiting for it to respond, so the endpoints are
+    probed in parallel, each in its own thread. Each thread writes only the strings of its own
+    endpoint, so there's no need to synchronize them. */
+  if (count > 1) { tasks = malloc( count * sizeof(*tasks) ); }
+
+  for (i = 0; i < count; ++i) {
+    if (tasks == NULL) {
+      (void)probe_endpoint( context, i );
+      continue;
+    }
+
+    if (context->is_probed[i]) {
+      tasks[i].thread = NULL;
+      continue;
+    }
+
+    tasks[i].context = context;
+    tasks[i].endpoint_index = i;
+    tasks[i].thread = PLAINMTP(thread_start( &CB_probe_endpoint, &tasks[i] ));
+    if (tasks[i].thread == NULL) { (void)probe_endpoint( context, i ); }
+  }
+
+  if (tasks == NULL) { return; }
+
+  for (i = 0; i < count; ++i) {
+    if (tasks[i].thread != NULL) { PLAINMTP(thread_join( tasks[i].thread )); }
+  }
+
+  free( tasks );
+}}
+
+#define release_endpoint_strings ZZ_PLAINMTP(release_endpoint_strings)
+PLAINMTP_INTERNAL void release_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index
+) {
+{
+  free( (void*)context->endpoint_keys[endpoint_index] );
+  free( (void*)context->endpoint_names[endpoint_index] );
+  free( (void*)context->endpoint_captions[endpoint_index] );
+  free( (void*)context->endpoint_vendors[endpoint_index] );
+  free( (void*)context->endpoint_serials[endpoint_index] );
+}}
+
+#define make_endpoint_key ZZ_PLAINMTP(make_endpoint_key)
+PLAINMTP_INTERNAL wchar_t* make_endpoint_key( const LIBMTP_raw_device_t* hardware ) {
+  wchar_t buffer[ENDPOINT_KEY_LENGTH_LIMIT];
+{
+  /* NB: The device number is assigned anew each time the device is connected, so the key refers to
+    the connection rather than the device itself, which is exactly what the endpoint is. */
+  (void)swprintf( buffer, ENDPOINT_KEY_LENGTH_LIMIT, L"usb:%lu:%u",
+    (unsigned long)hardware->bus_location, (unsigned int)hardware->devnum );
+  return zz_plainmtp_wcsdup( buffer );
+}}
+
+#define match_endpoint ZZ_PLAINMTP(match_endpoint)
+PLAINMTP_INTERNAL plainmtp_3val match_endpoint( const LIBMTP_raw_device_t* hardware,
+  const wchar_t* serial, const plainmtp_startup_s* options
+) {
+  plainmtp_filter_s device;
+{
+  device.vendor_id = hardware->device_entry.vendor_id;
+  device.product_id = hardware->device_entry.product_id;
+  device.bus_location = hardware->bus_location;
+  device.device_number = hardware->devnum;
+  device.serial_number = serial;
+
+  return PLAINMTP(match_device_filters( options, &device, PLAINMTP_TRUE ));
+}}
+
+#define filter_hardware_list ZZ_PLAINMTP(filter_hardware_list)
+PLAINMTP_INTERNAL plainmtp_bool filter_hardware_list( LIBMTP_raw_device_t* hardware_list,
+  int* device_count, const plainmtp_startup_s* options
+) {
+  plainmtp_bool needs_serials = PLAINMTP_FALSE;
+  int i, count = 0;
+{
+  /* NB: This is done before opening any device, so only the serial numbers remain unknown. */
+  for (i = 0; i < *device_count; ++i) {
+    switch (match_endpoint( &hardware_list[i], NULL, options )) {
+      case PLAINMTP_BAD:
+      continue;
+
+      case PLAINMTP_NONE:
+        needs_serials = PLAINMTP_TRUE;
+      break;
+
+      default:
+      break;
+    }
+
+    hardware_list[count++] = hardware_list[i];
+  }
+
+  *device_count = count;
+  return needs_serials;
+}}
+
+#define drop_unmatched_endpoints ZZ_PLAINMTP(drop_unmatched_endpoints)
+PLAINMTP_INTERNAL void drop_unmatched_endpoints( struct plainmtp_context_s* context,
+  const plainmtp_startup_s* options
+) {
+  plainmtp_3val match;
+  size_t i, count = 0;
+{
+  for (i = 0; i < context->origin.endpoints.count; ++i) {
+    match = match_endpoint( &context->hardware_list[i], context->endpoint_serials[i], options );
+
+    if (match != PLAINMTP_GOOD) {
+      release_endpoint_strings( context, i );
+      continue;
+    }
+
+    context->hardware_list[count] = context->hardware_list[i];
+    context->endpoint_keys[count] = context->endpoint_keys[i];
+    context->endpoint_names[count] = context->endpoint_names[i];
+    context->endpoint_captions[count] = context->endpoint_captions[i];
+    context->endpoint_vendors[count] = context->endpoint_vendors[i];
+    context->endpoint_serials[count] = context->endpoint_serials[i];
+    context->is_probed[count] = context->is_probed[i];
+    ++count;
+  }
+
+  context->origin.endpoints.count = count;
+}}
+
+#define detect_hardware_list ZZ_PLAINMTP(detect_hardware_list)
+PLAINMTP_INTERNAL plainmtp_bool detect_hardware_list( LIBMTP_raw_device_t** OUT_hardware_list,
+  int* OUT_device_count
+) {
+{
+  *OUT_hardware_list = NULL;
+  *OUT_device_count = 0;
+
+  switch (LIBMTP_Detect_Raw_Devices( OUT_hardware_list, OUT_device_count )) {
+    case LIBMTP_ERROR_NONE:
+    case LIBMTP_ERROR_NO_DEVICE_ATTACHED:
+    return PLAINMTP_TRUE;
+
+    default:
+      LIBMTP_FreeMemory( *OUT_hardware_list );
+      return PLAINMTP_FALSE;
+  }
+}}
+
+#define adopt_hardware_list ZZ_PLAINMTP(adopt_hardware_list)
+PLAINMTP_INTERNAL plainmtp_bool adopt_hardware_list( struct plainmtp_context_s* context,
+  LIBMTP_raw_device_t* hardware_list, int device_count, const plainmtp_startup_s* options
+) {
+  const wchar_t **keys, **names, **captions, **vendors, **serials;
+  plainmtp_bool* is_probed;
+  plainmtp_bool needs_serials;
+  LIBMTP_raw_device_t* known;
+  size_t i, j, count;
+  const size_t known_count = context->origin.endpoints.count;
+{
+  needs_serials = filter_hardware_list( hardware_list, &device_count, options );
+  count = (size_t)device_count;
+
+  if (count > 0) {
+    keys = malloc( count * (ENDPOINT_STRING_COUNT * sizeof(*keys) + sizeof(*is_probed)) );
+    if (keys == NULL) { return PLAINMTP_FALSE; }
+
+    names = keys + count;
+    captions = names + count;
+    vendors = captions + count;
+    serials = vendors + count;
+    is_probed = (plainmtp_bool*)(serials + count);
+  } else {
+    keys = names = captions = vendors = serials = NULL;
+    is_probed = NULL;
+  }
+
+  /* NB: The endpoints of the devices that are still connected keep their strings, so only the newly
+    connected devices have to be probed. A device can't change its bus location and number without
+    being reconnected, so they identify it unambiguously. */
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < known_count; ++j) {
+      known = &context->hardware_list[j];
+      if (known->devnum != hardware_list[i].devnum) { continue; }
+      if (known->bus_location == hardware_list[i].bus_location) { break; }
+    }
+
+    if (j < known_count) {
+      keys[i] = context->endpoint_keys[j];
+      names[i] = context->endpoint_names[j];
+      captions[i] = context->endpoint_captions[j];
+      vendors[i] = context->endpoint_vendors[j];
+      serials[i] = context->endpoint_serials[j];
+      is_probed[i] = context->is_probed[j];
+
+      /* USB device addresses start from 1, so the endpoint won't be matched again. */
+      context->hardware_list[j].devnum = 0;
+    } else {
+      keys[i] = make_endpoint_key( &hardware_list[i] );
+      names[i] = captions[i] = vendors[i] = serials[i] = NULL;
+      is_probed[i] = PLAINMTP_FALSE;
+    }
+  }
+
+  for (j = 0; j < known_count; ++j) {
+    if (context->hardware_list[j].devnum != 0) { release_endpoint_strings( context, j ); }
+  }
+
+  free( context->endpoint_keys );
+  LIBMTP_FreeMemory( context->hardware_list );
+
+  context->hardware_list = hardware_list;
+  context->endpoint_keys = keys;
+  context->endpoint_names = names;
+  context->endpoint_captions = captions;
+  context->endpoint_vendors = vendors;
+  context->endpoint_serials = serials;
+  context->is_probed = is_probed;
+
+  context->origin.endpoints.count = count;
+  context->origin.endpoints.keys = keys;
+  context->origin.endpoints.names = names;
+  context->origin.endpoints.captions = captions;
+  context->origin.endpoints.vendors = vendors;
+  context->origin.endpoints.serials = serials;
+
+  if ( needs_serials || (options == NULL) || !options->lazy_probing ) {
+    probe_all_endpoints( context );
+  }
+
+  if (needs_serials) { drop_unmatched_endpoints( context, options ); }
+  return PLAINMTP_TRUE;
+}}
+
 #define make_storage_name ZZ_PLAINMTP(make_storage_name)
 PLAINMTP_INTERNAL wchar_t* make_storage_name( LIBMTP_devicestorage_t* values ) {
   wchar_t* result;
@@ -140,115 +419,215 @@ PLAINMTP_INTERNAL LIBMTP_devicestorage_t* find_storage_by_id( LIBMTP_devicestora
   return NULL;
 }}
 
+#define release_device ZZ_PLAINMTP(release_device)
+PLAINMTP_INTERNAL void release_device( struct plainmtp_device_s* device ) {
+{
+  LOCK_DEVICE(device);
+  LIBMTP_Release_Device( device->libmtp_socket );
+  UNLOCK_DEVICE(device);
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  PLAINMTP(mutex_destroy( device->lock ));
+#endif
+
+  PLAINMTP(cursor_pool_finish( &device->cursors ));
+  free( device->pool_key );
+
+  RESET_ALLOCS(device);
+  free( device );
+}}
+
 /**************************************************************************************************/
 
 struct plainmtp_context_s* plainmtp_startup(void) {
-  LIBMTP_error_number_t status;
-  LIBMTP_mtpdevice_t* libmtp_socket;
-  LIBMTP_raw_device_t* libmtp_hardware_list = NULL;
+{
+  return plainmtp_startup_ex( NULL );
+}}
+
+struct plainmtp_context_s* plainmtp_startup_ex( const plainmtp_startup_s* options ) {
+  LIBMTP_raw_device_t* libmtp_hardware_list;
   struct plainmtp_context_s* context;
-  int libmtp_device_count, i;
-  const wchar_t **libmtp_device_names, **libmtp_device_captions, **libmtp_device_vendors;
+  int libmtp_device_count;
+  uint64_t idle_time;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   if (!is_libmtp_initialized) {
     LIBMTP_Init();
     is_libmtp_initialized = PLAINMTP_TRUE;
   }
 
-  status = LIBMTP_Detect_Raw_Devices( &libmtp_hardware_list, &libmtp_device_count );
-  switch (status) {
-    case LIBMTP_ERROR_NONE:
-    case LIBMTP_ERROR_NO_DEVICE_ATTACHED:
-    break;
+  if (!detect_hardware_list( &libmtp_hardware_list, &libmtp_device_count )) { return NULL; }
 
-    default:
-      goto failed;
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  if (!PLAINMTP(start_alloc_accounting())) {
+    LIBMTP_FreeMemory( libmtp_hardware_list );
+    return NULL;
   }
+#endif
 
-  context = malloc( sizeof(*context) + 3 * (size_t)libmtp_device_count *
-    sizeof(*libmtp_device_names) );
+  context = malloc( sizeof(*context) );
   if (context == NULL) { goto failed; }
 
-  if ( libmtp_device_count > 0 ) {
-    libmtp_device_names = (const wchar_t**)(context + 1);
-    libmtp_device_captions = libmtp_device_names + libmtp_device_count;
-    libmtp_device_vendors = libmtp_device_captions + libmtp_device_count;
-
-    for (i = 0; i < libmtp_device_count; ++i) {
-      libmtp_socket = LIBMTP_Open_Raw_Device_Uncached( &libmtp_hardware_list[i] );
-      if (libmtp_socket == NULL) {
-        libmtp_device_names[i] = NULL;
-        libmtp_device_captions[i] = NULL;
-        libmtp_device_vendors[i] = NULL;
-        continue;
-      }
+  context->hardware_list = NULL;
+  context->endpoint_keys = NULL;
+  context->endpoint_names = NULL;
+  context->endpoint_captions = NULL;
+  context->endpoint_vendors = NULL;
+  context->endpoint_serials = NULL;
+  context->is_probed = NULL;
 
-      libmtp_device_names[i] = make_device_string( libmtp_socket, LIBMTP_Get_Friendlyname );
-      libmtp_device_captions[i] = make_device_string( libmtp_socket, LIBMTP_Get_Modelname );
-      libmtp_device_vendors[i] = make_device_string( libmtp_socket, LIBMTP_Get_Manufacturername );
-      LIBMTP_Release_Device( libmtp_socket );
-    }
-  } else {
-    libmtp_device_names = NULL;
-    libmtp_device_captions = NULL;
-    libmtp_device_vendors = NULL;
-  }
+  context->origin.endpoints.count = 0;
+  context->origin.features.active_mode_receive = PLAINMTP_FALSE;
+  context->origin.features.active_mode_transfer = PLAINMTP_FALSE;
 
-  context->hardware_list = libmtp_hardware_list;
+  idle_time = (options != NULL) ? options->session_idle_time : 0;
+  context->utf8_names = (options != NULL) && options->utf8_names;
 
-  context->origin.endpoints.count = libmtp_device_count;
-  context->origin.endpoints.keys = NULL;
-  context->origin.endpoints.names = libmtp_device_names;
-  context->origin.endpoints.captions = libmtp_device_captions;
-  context->origin.endpoints.vendors = libmtp_device_vendors;
+  if (!PLAINMTP(session_pool_start( &context->sessions, idle_time, &release_device ))) {
+    free( context );
+    goto failed;
+  }
 
-  context->origin.features.active_mode_receive = PLAINMTP_FALSE;
-  context->origin.features.active_mode_transfer = PLAINMTP_FALSE;
+  if (!adopt_hardware_list( context, libmtp_hardware_list, libmtp_device_count, options )) {
+    PLAINMTP(session_pool_finish( &context->sessions ));
+    free( context );
+    goto failed;
+  }
+
+  context->startup_time = PLAINMTP(get_monotonic_time()) - start_time;
   return context;
 
 failed:
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  PLAINMTP(finish_alloc_accounting());
+#endif
+
   LIBMTP_FreeMemory( libmtp_hardware_list );
   return NULL;
 }}
 
+plainmtp_bool plainmtp_context_refresh( struct plainmtp_context_s* context,
+  const plainmtp_startup_s* options
+) {
+  LIBMTP_raw_device_t* libmtp_hardware_list;
+  int libmtp_device_count;
+{
+  assert( context != NULL );
+
+  if (!detect_hardware_list( &libmtp_hardware_list, &libmtp_device_count )) {
+    return PLAINMTP_FALSE;
+  }
+
+  if (!adopt_hardware_list( context, libmtp_hardware_list, libmtp_device_count, options )) {
+    LIBMTP_FreeMemory( libmtp_hardware_list );
+    return PLAINMTP_FALSE;
+  }
+
+  /* The sessions of the devices that were disconnected are unusable, so they're released. */
+  PLAINMTP(retain_pooled_sessions( &context->sessions, context->origin.endpoints.keys,
+    context->origin.endpoints.count ));
+  return PLAINMTP_TRUE;
+}}
+
+plainmtp_bool plainmtp_endpoint_probe( struct plainmtp_context_s* context,
+  size_t endpoint_index
+) {
+{
+  assert( context != NULL );
+  assert( endpoint_index < context->origin.endpoints.count );
+
+  return probe_endpoint( context, endpoint_index );
+}}
+
 void plainmtp_shutdown( struct plainmtp_context_s* context ) {
   size_t i;
 {
   assert( context != NULL );
 
-  for (i = 0; i < context->origin.endpoints.count; ++i) {
-    free( (void*)context->origin.endpoints.names[i] );
-    free( (void*)context->origin.endpoints.captions[i] );
-    free( (void*)context->origin.endpoints.vendors[i] );
-  }
+  PLAINMTP(session_pool_finish( &context->sessions ));
+  for (i = 0; i < context->origin.endpoints.count; ++i) { release_endpoint_strings( context, i ); }
 
+  free( context->endpoint_keys );
   LIBMTP_FreeMemory( context->hardware_list );
   free( context );
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  PLAINMTP(finish_alloc_accounting());
+#endif
 }}
 
 struct plainmtp_device_s* plainmtp_device_start( struct plainmtp_context_s* context,
   size_t endpoint_index, plainmtp_bool read_only
 ) {
   struct plainmtp_device_s* device;
+  uint64_t start_time;
 {
   assert( context != NULL );
   assert( endpoint_index < context->origin.endpoints.count );
 
+  device = PLAINMTP(take_pooled_session( &context->sessions,
+    context->endpoint_keys[endpoint_index], read_only ));
+
+  if (device != NULL) {
+    plainmtp_device_reset_stats( device );
+    RESET_ALLOCS(device);
+    PLAINMTP(account_operation( &device->stats, PLAINMTP_OPERATION_STARTUP,
+      context->startup_time, PLAINMTP_TRUE ));
+    return device;
+  }
+
   device = malloc( sizeof(*device) );
   if (device == NULL) { goto failed; }
 
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  device->lock = PLAINMTP(mutex_create());
+  if (device->lock == NULL) { goto failed; }
+#endif
+
+  if (!PLAINMTP(cursor_pool_start( &device->cursors, sizeof(struct plainmtp_cursor_s) ))) {
+    goto failed_lock;
+  }
+
+  memset( &device->trace, 0, sizeof(device->trace) );
+  RESET_ALLOCS(device);
+  plainmtp_device_reset_stats( device );
+  PLAINMTP(account_operation( &device->stats, PLAINMTP_OPERATION_STARTUP, context->startup_time,
+    PLAINMTP_TRUE ));
+
   /* We use LIBMTP_Open_Raw_Device_Uncached() instead of LIBMTP_Open_Raw_Device() because MTP is
     event-oriented, but libmtp doesn't process events and thus doesn't update its own cache (what
     WPD, for example, apparently does). Since we don't process them too (by design), this forces us
     to use the uncached mode to achieve WPD-like behavior with libmtp. */
 
+  start_time = PLAINMTP(get_monotonic_time());
   device->libmtp_socket = LIBMTP_Open_Raw_Device_Uncached(
     &context->hardware_list[endpoint_index] );
-  if (device->libmtp_socket == NULL) { goto failed; }
+  if (device->libmtp_socket == NULL) { goto failed_cursors; }
+
+  PLAINMTP(account_device_call( &device->stats, &device->trace, PLAINMTP_OPERATION_DEVICE_OPEN,
+    "LIBMTP_Open_Raw_Device_Uncached", start_time, PLAINMTP_TRUE ));
 
   device->read_only = read_only;
+  device->utf8_names = context->utf8_names;
+
+  /* If the key can't be copied, the session is just not pooled. */
+  device->pool = &context->sessions;
+  device->pool_key = NULL;
+
+  if ( (context->sessions.idle_time != 0) && (context->endpoint_keys[endpoint_index] != NULL) ) {
+    device->pool_key = zz_plainmtp_wcsdup( context->endpoint_keys[endpoint_index] );
+  }
+
   return device;
 
+failed_cursors:
+  PLAINMTP(cursor_pool_finish( &device->cursors ));
+
+failed_lock:
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  PLAINMTP(mutex_destroy( device->lock ));
+#endif
+
 failed:
   free( device );
   return NULL;
@@ -258,8 +637,100 @@ void plainmtp_device_finish( struct plainmtp_device_s* device ) {
 {
   assert( device != NULL );
 
-  LIBMTP_Release_Device( device->libmtp_socket );
-  free( device );
+  /* Wait for the operation that may still be in progress in another thread. */
+  LOCK_DEVICE(device);
+  (void)PLAINMTP(stop_device_trace( &device->trace, NULL ));
+  UNLOCK_DEVICE(device);
+
+  if (!PLAINMTP(keep_pooled_session( device->pool, device, device->pool_key, device->read_only ))) {
+    release_device( device );
+  }
+}}
+
+plainmtp_bool plainmtp_device_acquire( struct plainmtp_device_s* device, plainmtp_bool wait ) {
+{
+  assert( device != NULL );
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  if (!wait) { return PLAINMTP(mutex_try_lock( device->lock )); }
+#else
+  (void)device;
+  (void)wait;
+#endif
+
+  LOCK_DEVICE(device);
+  return PLAINMTP_TRUE;
+}}
+
+void plainmtp_device_release( struct plainmtp_device_s* device ) {
+{
+  assert( device != NULL );
+
+#ifndef CC_PLAINMTP_THREAD_SAFE
+  (void)device;
+#endif
+
+  UNLOCK_DEVICE(device);
+}}
+
+void plainmtp_device_get_stats( struct plainmtp_device_s* device, plainmtp_stats_s* OUT_stats ) {
+{
+  assert( device != NULL );
+  assert( OUT_stats != NULL );
+
+  LOCK_DEVICE(device);
+  *OUT_stats = device->stats;
+  UNLOCK_DEVICE(device);
+}}
+
+void plainmtp_device_reset_stats( struct plainmtp_device_s* device ) {
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  memset( &device->stats, 0, sizeof(device->stats) );
+  UNLOCK_DEVICE(device);
+}}
+
+plainmtp_bool plainmtp_device_start_trace( struct plainmtp_device_s* device, size_t capacity ) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  result = PLAINMTP(start_device_trace( &device->trace, capacity ));
+  UNLOCK_DEVICE(device);
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_device_stop_trace( struct plainmtp_device_s* device, const wchar_t* path ) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  result = PLAINMTP(stop_device_trace( &device->trace, path ));
+  UNLOCK_DEVICE(device);
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_device_get_alloc_stats( struct plainmtp_device_s* device,
+  const char* api_name, plainmtp_alloc_stats_s* OUT_stats
+) {
+{
+  assert( OUT_stats != NULL );
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  return PLAINMTP(get_alloc_stats( (device != NULL) ? &device->allocs : NULL, api_name,
+    OUT_stats ));
+#else
+  (void)device;
+  (void)api_name;
+  (void)OUT_stats;
+  return PLAINMTP_FALSE;
+#endif
 }}
 
 /**************************************************************************************************/
@@ -268,30 +739,103 @@ void plainmtp_device_finish( struct plainmtp_device_s* device ) {
 PLAINMTP_INTERNAL plainmtp_bool obtain_image_copy( zz_plainmtp_cursor_s* entity,
   zz_plainmtp_cursor_s* source
 ) {
-  wchar_t* unique_id;
+  wchar_t *unique_id, *name = NULL;
+  char* name_u8 = NULL;
+  size_t size;
 {
   unique_id = zz_plainmtp_wcsdup( source->id );
   if (unique_id == NULL) { return PLAINMTP_FALSE; }
-  entity->id = unique_id;
 
-  if (source->name != NULL) { entity->name = zz_plainmtp_wcsdup( source->name ); }
+  /* An entity without the name it has would be missed by the lookups by name, so it's an error. */
+  if (source->name != NULL) {
+    name = zz_plainmtp_wcsdup( source->name );
+    if (name == NULL) { goto failed; }
+  }
+
+  if (source->name_u8 != NULL) {
+    size = strlen( source->name_u8 ) + 1;
+    name_u8 = malloc( size );
+    if (name_u8 == NULL) { goto failed; }
+    memcpy( name_u8, source->name_u8, size );
+  }
+
+  entity->id = unique_id;
+  entity->binary_id = source->binary_id;
+  entity->name = name;
+  entity->name_u8 = name_u8;
   entity->datetime = source->datetime;
+  entity->size = source->size;
+  entity->format = source->format;
+  entity->is_container = source->is_container;
 
   return PLAINMTP_TRUE;
+
+failed:
+  free( name );
+  free( unique_id );
+  return PLAINMTP_FALSE;
+}}
+
+#define get_object_format ZZ_PLAINMTP(get_object_format)
+PLAINMTP_INTERNAL plainmtp_format_e get_object_format( LIBMTP_filetype_t filetype ) {
+{
+  if (filetype == LIBMTP_FILETYPE_FOLDER) { return PLAINMTP_FORMAT_FOLDER; }
+  if (LIBMTP_FILETYPE_IS_IMAGE( filetype )) { return PLAINMTP_FORMAT_IMAGE; }
+
+  /* NB: This must be checked before audio, since audio/video formats are reported as both. */
+  if (LIBMTP_FILETYPE_IS_VIDEO( filetype ) || LIBMTP_FILETYPE_IS_AUDIOVIDEO( filetype )) {
+    return PLAINMTP_FORMAT_VIDEO;
+  }
+
+  if (LIBMTP_FILETYPE_IS_AUDIO( filetype )) { return PLAINMTP_FORMAT_AUDIO; }
+
+  switch (filetype) {
+    case LIBMTP_FILETYPE_PLAYLIST:
+    case LIBMTP_FILETYPE_ALBUM:
+      return PLAINMTP_FORMAT_PLAYLIST;
+
+    case LIBMTP_FILETYPE_TEXT:
+    case LIBMTP_FILETYPE_HTML:
+    case LIBMTP_FILETYPE_DOC:
+    case LIBMTP_FILETYPE_XML:
+    case LIBMTP_FILETYPE_XLS:
+    case LIBMTP_FILETYPE_PPT:
+      return PLAINMTP_FORMAT_DOCUMENT;
+
+    default:
+      return PLAINMTP_FORMAT_UNDEFINED;
+  }
+}}
+
+/* NB: This is the same as fold_wpd_object_name() for the wide string made of this one. */
+#define fold_utf8_object_name ZZ_PLAINMTP(fold_utf8_object_name)
+PLAINMTP_INTERNAL void fold_utf8_object_name( uint16_t name_units[8], const char* name ) {
+  size_t i = 0;
+{
+  memset( name_units, 0, 8 * sizeof(*name_units) );
+
+  if (name != NULL) while (*name != '\0') {
+    name_units[i % 8] ^= (uint16_t)(wchar_t)PLAINMTP(read_utf8_codepoint( &name ));
+    ++i;
+  }
 }}
 
 #define obtain_object_image ZZ_PLAINMTP(obtain_object_image)
 PLAINMTP_INTERNAL plainmtp_3val obtain_object_image( zz_plainmtp_cursor_s* entity,
-  LIBMTP_file_t* object, const wpd_guid_plain_i required_id
+  LIBMTP_file_t* object, const wpd_guid_plain_i required_id, plainmtp_bool utf8_names
 ) {
   wpd_guid_plain_i plain_guid;
+  uint16_t name_units[8];
   wchar_t *name, *id_string;
 {
-  if (object->filename != NULL) {
+  /* In the UTF-8 mode, the name is folded right from the libmtp string, and is taken from it. */
+  if ( (object->filename != NULL) && !utf8_names ) {
     name = PLAINMTP(make_wide_string_from_utf8( object->filename, NULL ));
     if (name == NULL) { return PLAINMTP_BAD; }
+    PLAINMTP(fold_wpd_object_name( name_units, name ));
   } else {
     name = NULL;
+    fold_utf8_object_name( name_units, object->filename );
   }
 
   /* TODO: Usage of the WPD fallback algorithm here is a temporary workaround solution for unique
@@ -303,8 +847,8 @@ PLAINMTP_INTERNAL plainmtp_3val obtain_object_image( zz_plainmtp_cursor_s* entit
     the wrapper should not have the need in this algorithm at all, because libmtp supports only MTP
     and ignores PTP devices. */
 
-  PLAINMTP(get_wpd_fallback_object_id( plain_guid, name, object->item_id, object->parent_id,
-    object->storage_id, (uint32_t)object->filesize ));
+  PLAINMTP(get_wpd_fallback_object_id( plain_guid, name_units, object->item_id,
+    object->parent_id, object->storage_id, (uint32_t)object->filesize ));
 
   /* BEWARE: Short-circuit evaluation matters here! */
   if ( (required_id != NULL)
@@ -323,11 +867,23 @@ PLAINMTP_INTERNAL plainmtp_3val obtain_object_image( zz_plainmtp_cursor_s* entit
   PLAINMTP(write_wpd_plain_guid( plain_guid, id_string ));
 
   entity->id = id_string;
+  memcpy( entity->binary_id.bytes, plain_guid, sizeof(plain_guid) );
   entity->name = name;
+  entity->name_u8 = NULL;
+
+  if (utf8_names) {
+    entity->name_u8 = object->filename;
+    object->filename = NULL;
+  }
 
   /* NB: I personally would prefer gmtime() here, but that's how WPD wrapper for plainmtp works. */
   entity->datetime = *localtime( &object->modificationdate );
 
+  /* Folders are associations in terms of PTP/MTP, and their size has no meaning. */
+  entity->format = get_object_format( object->filetype );
+  entity->is_container = (entity->format == PLAINMTP_FORMAT_FOLDER);
+  entity->size = entity->is_container ? PLAINMTP_SIZE_UNKNOWN : object->filesize;
+
   return PLAINMTP_GOOD;
 }}
 
@@ -353,8 +909,13 @@ PLAINMTP_INTERNAL plainmtp_3val obtain_storage_image( zz_plainmtp_cursor_s* enti
   }
 
   entity->id = unique_id;
+  memset( entity->binary_id.bytes, 0, sizeof(entity->binary_id.bytes) );
   entity->name = storage_name;
+  entity->name_u8 = NULL;
   entity->datetime.tm_mday = 0;  /* There's no datetime information for storages. */
+  entity->size = PLAINMTP_SIZE_UNKNOWN;
+  entity->format = PLAINMTP_FORMAT_UNDEFINED;
+  entity->is_container = PLAINMTP_TRUE;
 
   return PLAINMTP_GOOD;
 }}
@@ -368,9 +929,14 @@ PLAINMTP_INTERNAL plainmtp_bool obtain_device_image( zz_plainmtp_cursor_s* entit
   unique_id = zz_plainmtp_wcsdup( PLAINMTP(wpd_root_persistent_id) );
   if (unique_id == NULL) { return PLAINMTP_FALSE; }
   entity->id = unique_id;
+  memset( entity->binary_id.bytes, 0, sizeof(entity->binary_id.bytes) );
 
   entity->name = make_device_string( socket, LIBMTP_Get_Modelname );
+  entity->name_u8 = NULL;
   entity->datetime.tm_mday = 0;  /* There's no datetime information for the device root. */
+  entity->size = PLAINMTP_SIZE_UNKNOWN;
+  entity->format = PLAINMTP_FORMAT_UNDEFINED;
+  entity->is_container = PLAINMTP_TRUE;
 
   return PLAINMTP_TRUE;
 }}
@@ -380,6 +946,19 @@ PLAINMTP_INTERNAL void wipe_entity_image( zz_plainmtp_cursor_s* entity ) {
 {
   free( (void*)entity->id );
   free( (void*)entity->name );
+  free( (void*)entity->name_u8 );
+}}
+
+/* NB: This must be used instead of wipe_entity_image() for the current and the shadowed entities of
+  the cursor, as they may refer to the strings in the storage of a pooled cursor. */
+#define wipe_cursor_image ZZ_PLAINMTP(wipe_cursor_image)
+PLAINMTP_INTERNAL void wipe_cursor_image( struct plainmtp_cursor_s* cursor,
+  zz_plainmtp_cursor_s* entity
+) {
+{
+  if (entity->id != cursor->pooled_id) { free( (void*)entity->id ); }
+  if (entity->name != cursor->pooled_name) { free( (void*)entity->name ); }
+  if (entity->name_u8 != cursor->pooled_name_u8) { free( (void*)entity->name_u8 ); }
 }}
 
 #define free_libmtp_object_listing ZZ_PLAINMTP(free_libmtp_object_listing)
@@ -399,7 +978,8 @@ PLAINMTP_INTERNAL void wipe_enumeration_data( struct plainmtp_cursor_s* cursor,
 ) {
   void* chain = cursor->enumeration;
 {
-  wipe_entity_image( (OUT_descriptor != NULL) ? &cursor->parent_entity : &cursor->current_entity );
+  wipe_cursor_image( cursor,
+    (OUT_descriptor != NULL) ? &cursor->parent_entity : &cursor->current_entity );
 
   if (!CURSOR_HAS_STORAGE_ID(cursor)) {
     storage_enumeration_s* node = chain;
@@ -428,9 +1008,21 @@ PLAINMTP_INTERNAL void clear_cursor( struct plainmtp_cursor_s* cursor ) {
 {
   if (CURSOR_HAS_ENUMERATION(cursor)) {
     wipe_enumeration_data( cursor, NULL );
-    wipe_entity_image( &cursor->parent_entity );
+    wipe_cursor_image( cursor, &cursor->parent_entity );
+  } else {
+    wipe_cursor_image( cursor, &cursor->current_entity );
+  }
+}}
+
+#define release_cursor ZZ_PLAINMTP(release_cursor)
+PLAINMTP_INTERNAL void release_cursor( struct plainmtp_cursor_s* cursor ) {
+{
+  clear_cursor( cursor );
+
+  if (cursor->pool != NULL) {
+    PLAINMTP(keep_pooled_cursor( cursor->pool, cursor ));
   } else {
-    wipe_entity_image( &cursor->current_entity );
+    free( cursor );
   }
 }}
 
@@ -441,6 +1033,11 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* prepare_cursor( struct plainmtp_curs
   if (cursor == NULL) {
     cursor = malloc( sizeof(*cursor) );
     if (cursor == NULL) { return NULL; }
+
+    cursor->pool = NULL;
+    cursor->pooled_id = NULL;
+    cursor->pooled_name = NULL;
+    cursor->pooled_name_u8 = NULL;
   } else {
     clear_cursor( cursor );
   }
@@ -451,13 +1048,31 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* prepare_cursor( struct plainmtp_curs
   return cursor;
 }}
 
+/* NB: The cursor must be pooled and already cleared, and the strings of the source entity must fit
+  into its storage. */
+#define fill_pooled_cursor ZZ_PLAINMTP(fill_pooled_cursor)
+PLAINMTP_INTERNAL void fill_pooled_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_cursor_s* source
+) {
+{
+  cursor->current_entity = source->current_entity;
+  PLAINMTP(copy_pooled_strings( POOLED_CURSOR_STRINGS(cursor), &cursor->current_entity ));
+
+  cursor->pooled_id = cursor->current_entity.id;
+  cursor->pooled_name = cursor->current_entity.name;
+  cursor->pooled_name_u8 = cursor->current_entity.name_u8;
+  cursor->enumeration = cursor;
+
+  (void)get_cursor_state( source, &cursor->values );
+}}
+
 #define setup_cursor_to_object ZZ_PLAINMTP(setup_cursor_to_object)
 PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_to_object(
-  struct plainmtp_cursor_s* cursor, LIBMTP_file_t* object
+  struct plainmtp_cursor_s* cursor, LIBMTP_file_t* object, plainmtp_bool utf8_names
 ) {
   zz_plainmtp_cursor_s entity;
 {
-  if ( obtain_object_image( &entity, object, NULL ) == PLAINMTP_GOOD ) {
+  if ( obtain_object_image( &entity, object, NULL, utf8_names ) == PLAINMTP_GOOD ) {
     cursor = prepare_cursor( cursor, &entity );
     if (cursor != NULL) {
       set_object_values( &cursor->values, object );
@@ -510,14 +1125,17 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_to_device(
 
 #define setup_cursor_by_handle ZZ_PLAINMTP(setup_cursor_by_handle)
 PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_handle(
-  struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket, uint32_t object_handle
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, uint32_t object_handle
 ) {
   LIBMTP_file_t* object;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
-  object = LIBMTP_Get_Filemetadata( socket, object_handle );
+  object = LIBMTP_Get_Filemetadata( device->libmtp_socket, object_handle );
+  PLAINMTP(account_device_call( &device->stats, &device->trace, PLAINMTP_OPERATION_OBJECT_INFO,
+    "LIBMTP_Get_Filemetadata", start_time, object != NULL ));
   if (object == NULL) { return NULL; }
 
-  cursor = setup_cursor_to_object( cursor, object );
+  cursor = setup_cursor_to_object( cursor, object, device->utf8_names );
   LIBMTP_destroy_file_t( object );
 
   return cursor;
@@ -525,13 +1143,16 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_handle(
 
 #define setup_cursor_by_lookup ZZ_PLAINMTP(setup_cursor_by_lookup)
 PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_lookup(
-  struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket, const wpd_guid_plain_i required_id
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device,
+  const wpd_guid_plain_i required_id
 ) {
   struct plainmtp_cursor_s* result = NULL;
   LIBMTP_file_t *chain, *object;
   zz_plainmtp_cursor_s entity;
   object_queue_s *bfs_pipeline, *data;
   object_queue_item_s step = {STORAGE_ID_NULL, LIBMTP_FILES_AND_FOLDERS_ROOT};
+  uint64_t start_time;
+  plainmtp_bool failed;
 {
   /* TODO: Can this be faster? LIBMTP_Get_Files_And_Folders() parses all objects into LIBMTP_file_t
     instances, while we need only their handles here, so that is quite slow. It's worth noting that
@@ -542,13 +1163,22 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_lookup(
   if (bfs_pipeline == NULL) { return NULL; }
 
   do {
-    chain = LIBMTP_Get_Files_And_Folders( socket, step.storage_id, step.object_handle );
+    /* See select_object_first() about the error stack. */
+    LIBMTP_Clear_Errorstack( device->libmtp_socket );
+
+    start_time = PLAINMTP(get_monotonic_time());
+    chain = LIBMTP_Get_Files_And_Folders( device->libmtp_socket, step.storage_id,
+      step.object_handle );
+
+    failed = (chain == NULL) && (LIBMTP_Get_Errorstack( device->libmtp_socket ) != NULL);
+    PLAINMTP(account_device_call( &device->stats, &device->trace,
+      PLAINMTP_OPERATION_FOLDER_LISTING, "LIBMTP_Get_Files_And_Folders", start_time, !failed ));
 
     while (chain != NULL) {
       object = chain;
       chain = object->next;
 
-      switch (obtain_object_image( &entity, object, required_id )) {
+      switch (obtain_object_image( &entity, object, required_id, device->utf8_names )) {
         default:
           if (object->filetype == LIBMTP_FILETYPE_FOLDER) {
             data = PLAINMTP(object_queue_push( bfs_pipeline, object->storage_id,
@@ -584,32 +1214,41 @@ quit:
 
 #define setup_cursor_by_id ZZ_PLAINMTP(setup_cursor_by_id)
 PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_id( struct plainmtp_cursor_s* cursor,
-  LIBMTP_mtpdevice_t* socket, uint32_t storage_id, plainmtp_bool force_update,
+  struct plainmtp_device_s* device, uint32_t storage_id, plainmtp_bool force_update,
   const wchar_t* required_id
 ) {
   LIBMTP_devicestorage_t* storage;
 {
-  if ( (socket->storage == NULL) || force_update ) {
-    int status = LIBMTP_Get_Storage( socket, LIBMTP_STORAGE_SORTBY_NOTSORTED );
+  if ( (device->libmtp_socket->storage == NULL) || force_update ) {
+    const uint64_t start_time = PLAINMTP(get_monotonic_time());
+    int status = LIBMTP_Get_Storage( device->libmtp_socket, LIBMTP_STORAGE_SORTBY_NOTSORTED );
+
+    PLAINMTP(account_device_call( &device->stats, &device->trace,
+      PLAINMTP_OPERATION_STORAGE_QUERY, "LIBMTP_Get_Storage", start_time, status == 0 ));
     if (status != 0) { return NULL; }
   }
 
-  storage = find_storage_by_id( socket->storage, storage_id );
+  storage = find_storage_by_id( device->libmtp_socket->storage, storage_id );
   if (storage == NULL) { return NULL; }
 
   return setup_cursor_to_storage( cursor, storage, required_id );
 }}
 
 #define make_storage_enumeration ZZ_PLAINMTP(make_storage_enumeration)
-PLAINMTP_INTERNAL storage_enumeration_s* make_storage_enumeration( LIBMTP_mtpdevice_t* socket ) {
+PLAINMTP_INTERNAL storage_enumeration_s* make_storage_enumeration(
+  struct plainmtp_device_s* device
+) {
   int status;
   LIBMTP_devicestorage_t* chain;
   storage_enumeration_s *last_node = NULL, *next_node, *result;
   storage_enumeration_s** link = &result;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
-  status = LIBMTP_Get_Storage( socket, LIBMTP_STORAGE_SORTBY_MAXSPACE );
+  status = LIBMTP_Get_Storage( device->libmtp_socket, LIBMTP_STORAGE_SORTBY_MAXSPACE );
+  PLAINMTP(account_device_call( &device->stats, &device->trace,
+    PLAINMTP_OPERATION_STORAGE_QUERY, "LIBMTP_Get_Storage", start_time, status == 0 ));
   if (status != 0) { return NULL; }
-  chain = socket->storage;
+  chain = device->libmtp_socket->storage;
 
   while (chain != NULL) {
     next_node = malloc( sizeof(*next_node) );
@@ -643,9 +1282,18 @@ struct plainmtp_cursor_s* plainmtp_cursor_assign( struct plainmtp_cursor_s* curs
 {
   if (cursor == source) { return cursor; }
 
-  if (source == NULL) {
+  /* The strings are copied into the storage of a pooled cursor only after it's cleared, but that
+    can't fail, so the cursor still retains its state on error. */
+  if ( (source != NULL) && (cursor != NULL) && (cursor->pool != NULL)
+    && PLAINMTP(fit_pooled_strings( &source->current_entity ))
+  ) {
     clear_cursor( cursor );
-    free( cursor );
+    fill_pooled_cursor( cursor, source );
+    return cursor;
+  }
+
+  if (source == NULL) {
+    release_cursor( cursor );
   } else if ( obtain_image_copy( &entity, &source->current_entity ) ) {
     cursor = prepare_cursor( cursor, &entity );
     if (cursor != NULL) {
@@ -659,7 +1307,41 @@ struct plainmtp_cursor_s* plainmtp_cursor_assign( struct plainmtp_cursor_s* curs
   return NULL;
 }}
 
-struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* cursor,
+struct plainmtp_cursor_s* plainmtp_cursor_copy( struct plainmtp_cursor_s* source,
+  struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s* cursor;
+  zz_plainmtp_cursor_s entity;
+{
+  assert( source != NULL );
+  assert( device != NULL );
+
+  cursor = PLAINMTP(take_pooled_cursor( &device->cursors ));
+  if (cursor == NULL) { return NULL; }
+
+  cursor->pool = &device->cursors;
+  cursor->pooled_id = NULL;
+  cursor->pooled_name = NULL;
+  cursor->pooled_name_u8 = NULL;
+
+  if (PLAINMTP(fit_pooled_strings( &source->current_entity ))) {
+    fill_pooled_cursor( cursor, source );
+    return cursor;
+  }
+
+  if ( obtain_image_copy( &entity, &source->current_entity ) ) {
+    cursor->current_entity = entity;
+    cursor->enumeration = cursor;
+    (void)get_cursor_state( source, &cursor->values );
+    return cursor;
+  }
+
+  PLAINMTP(keep_pooled_cursor( cursor->pool, cursor ));
+  return NULL;
+}}
+
+#define switch_cursor ZZ_PLAINMTP(switch_cursor)
+PLAINMTP_INTERNAL struct plainmtp_cursor_s* switch_cursor( struct plainmtp_cursor_s* cursor,
   const wchar_t* entity_id, struct plainmtp_device_s* device
 ) {
   wpd_guid_plain_i object_id;
@@ -673,18 +1355,52 @@ struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* curs
   }
 
   if ( PLAINMTP(parse_wpd_storage_unique_id( entity_id, &storage_id )) ) {
-    return setup_cursor_by_id( cursor, device->libmtp_socket, storage_id, PLAINMTP_TRUE,
-      entity_id );
+    return setup_cursor_by_id( cursor, device, storage_id, PLAINMTP_TRUE, entity_id );
   }
 
   if ( PLAINMTP(read_wpd_plain_guid( object_id, entity_id )) ) {
-    return setup_cursor_by_lookup( cursor, device->libmtp_socket, object_id );
+    return setup_cursor_by_lookup( cursor, device, object_id );
   }
 
   return NULL;
 }}
 
-plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
+struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* cursor,
+  const wchar_t* entity_id, struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s* result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_switch" );
+  result = switch_cursor( cursor, entity_id, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+struct plainmtp_cursor_s* plainmtp_cursor_switch_binary( struct plainmtp_cursor_s* cursor,
+  const plainmtp_binary_id_s* entity_id, struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s* result;
+{
+  assert( entity_id != NULL );
+  assert( device != NULL );
+  assert( !PLAINMTP(is_nil_wpd_plain_guid( entity_id->bytes )) );
+
+  /* Only objects have non-nil binary IDs, and they're all in the GUID form. The nil one would make
+    the lookup scan the whole device in vain. */
+  if ( PLAINMTP(is_nil_wpd_plain_guid( entity_id->bytes )) ) { return NULL; }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_switch_binary" );
+  result = setup_cursor_by_lookup( cursor, device, entity_id->bytes );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define update_cursor ZZ_PLAINMTP(update_cursor)
+PLAINMTP_INTERNAL plainmtp_bool update_cursor( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device
 ) {
   entity_location_s descriptor;
@@ -698,19 +1414,33 @@ plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
     break;
 
     case CURSOR_ENTITY_STORAGE:
-      cursor = setup_cursor_by_id( cursor, device->libmtp_socket, descriptor.storage_id,
-        PLAINMTP_TRUE, NULL );
+      cursor = setup_cursor_by_id( cursor, device, descriptor.storage_id, PLAINMTP_TRUE, NULL );
     break;
 
     case CURSOR_ENTITY_OBJECT:
-      cursor = setup_cursor_by_handle( cursor, device->libmtp_socket, descriptor.object_handle );
+      cursor = setup_cursor_by_handle( cursor, device, descriptor.object_handle );
     break;
   }
 
   return (cursor != NULL);
 }}
 
-plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
+plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_update" );
+  result = update_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define return_cursor ZZ_PLAINMTP(return_cursor)
+PLAINMTP_INTERNAL plainmtp_bool return_cursor( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device
 ) {
   plainmtp_bool is_shadowed;
@@ -736,17 +1466,30 @@ plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
 
   } else if (cursor->values.parent_handle == OBJECT_HANDLE_NULL) {
     /* The cursor represents an object from the storage root. */
-    cursor = setup_cursor_by_id( cursor, device->libmtp_socket, cursor->values.storage_id,
-      PLAINMTP_FALSE, NULL );
+    cursor = setup_cursor_by_id( cursor, device, cursor->values.storage_id, PLAINMTP_FALSE, NULL );
 
   } else {
     /* The cursor represents an object with a parent. */
-    cursor = setup_cursor_by_handle( cursor, device->libmtp_socket, cursor->values.parent_handle );
+    cursor = setup_cursor_by_handle( cursor, device, cursor->values.parent_handle );
   }
 
   return (cursor != NULL);
 }}
 
+plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  if (device == NULL) { return return_cursor( cursor, NULL ); }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_return" );
+  result = return_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 /**************************************************************************************************/
 
 #define select_storage_first ZZ_PLAINMTP(select_storage_first)
@@ -755,7 +1498,7 @@ PLAINMTP_INTERNAL plainmtp_bool select_storage_first( struct plainmtp_cursor_s*
 ) {
   storage_enumeration_s* chain;
 {
-  chain = make_storage_enumeration( device->libmtp_socket );
+  chain = make_storage_enumeration( device );
   if (chain == NULL) {
     cursor->enumeration = cursor;
     return PLAINMTP_FALSE;
@@ -796,6 +1539,8 @@ PLAINMTP_INTERNAL plainmtp_bool select_object_first( struct plainmtp_cursor_s* c
   struct plainmtp_device_s* device
 ) {
   LIBMTP_file_t* chain;
+  plainmtp_bool failed;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   /* NB: LIBMTP_Get_Files_And_Folders() always returns NULL for empty 'Association' objects.
     It also omits some errors in non-empty case, but still litters the error stack with them. */
@@ -806,13 +1551,19 @@ PLAINMTP_INTERNAL plainmtp_bool select_object_first( struct plainmtp_cursor_s* c
   chain = LIBMTP_Get_Files_And_Folders( device->libmtp_socket, cursor->values.storage_id,
     cursor->values.object_handle );
 
+  failed = (chain == NULL) && (LIBMTP_Get_Errorstack( device->libmtp_socket ) != NULL);
+  PLAINMTP(account_device_call( &device->stats, &device->trace,
+    PLAINMTP_OPERATION_FOLDER_LISTING, "LIBMTP_Get_Files_And_Folders", start_time, !failed ));
+
   if (chain == NULL) {
-    cursor->enumeration = (LIBMTP_Get_Errorstack( device->libmtp_socket ) == NULL) ? NULL : cursor;
+    cursor->enumeration = failed ? cursor : NULL;
     return PLAINMTP_FALSE;
   }
 
   cursor->parent_entity = cursor->current_entity;
-  if (obtain_object_image( &cursor->current_entity, chain, NULL ) != PLAINMTP_GOOD) {
+  if (obtain_object_image( &cursor->current_entity, chain, NULL, device->utf8_names )
+    != PLAINMTP_GOOD
+  ) {
     free_libmtp_object_listing( chain );
     cursor->enumeration = cursor;
     return PLAINMTP_FALSE;
@@ -823,7 +1574,9 @@ PLAINMTP_INTERNAL plainmtp_bool select_object_first( struct plainmtp_cursor_s* c
 }}
 
 #define select_object_next ZZ_PLAINMTP(select_object_next)
-PLAINMTP_INTERNAL plainmtp_bool select_object_next( struct plainmtp_cursor_s* cursor ) {
+PLAINMTP_INTERNAL plainmtp_bool select_object_next( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
   LIBMTP_file_t *node = cursor->enumeration, *chain = node->next;
 {
   wipe_entity_image( &cursor->current_entity );
@@ -834,7 +1587,9 @@ PLAINMTP_INTERNAL plainmtp_bool select_object_next( struct plainmtp_cursor_s* cu
     goto finished;
   }
 
-  if (obtain_object_image( &cursor->current_entity, chain, NULL ) != PLAINMTP_GOOD) {
+  if (obtain_object_image( &cursor->current_entity, chain, NULL, device->utf8_names )
+    != PLAINMTP_GOOD
+  ) {
     free_libmtp_object_listing( chain );
     cursor->enumeration = cursor;
     goto finished;
@@ -848,8 +1603,10 @@ finished:
   return PLAINMTP_FALSE;
 }}
 
-plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
-  struct plainmtp_device_s* device ) {
+#define select_cursor ZZ_PLAINMTP(select_cursor)
+PLAINMTP_INTERNAL plainmtp_bool select_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
 {
   assert( cursor != NULL );
 
@@ -864,7 +1621,7 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
   }
 
   if (CURSOR_HAS_ENUMERATION(cursor)) {
-    if (CURSOR_HAS_STORAGE_ID(cursor)) { return select_object_next( cursor ); }
+    if (CURSOR_HAS_STORAGE_ID(cursor)) { return select_object_next( cursor, device ); }
     return select_storage_next( cursor );
   }
 
@@ -872,6 +1629,20 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
   return select_storage_first( cursor, device );
 }}
 
+plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  if (device == NULL) { return select_cursor( cursor, NULL ); }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_select" );
+  result = select_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 /**************************************************************************************************/
 
 #define CB_file_data_exchange ZZ_PLAINMTP(cb_file_data_exchange)
@@ -881,14 +1652,27 @@ PLAINMTP_INTERNAL uint16_t CB_file_data_exchange( void* ptp_context, void* wrapp
   file_exchange_s* context = wrapper_state;
   size_t bytes_left = chunk_size, part_limit;
   void* result;
+  uint64_t start_time;
 {
   part_limit = (context->chunk_limit == 0) ? chunk_size : context->chunk_limit;
 
   while (bytes_left > 0) {
     const size_t part_size = (part_limit < bytes_left) ? part_limit : bytes_left;
+
+    if (!context->is_transfer) {
+      PLAINMTP(digest_update( &context->digest, chunk_data, part_size ));
+    }
+
+    start_time = PLAINMTP(get_monotonic_time());
     result = context->callback( chunk_data, part_size, context->custom_state );
+    context->callback_time += PLAINMTP(get_monotonic_time()) - start_time;
     if (result == NULL) { return LIBMTP_HANDLER_RETURN_ERROR; }
 
+    if (context->is_transfer) {
+      PLAINMTP(digest_update( &context->digest, chunk_data, part_size ));
+    }
+
+    context->bytes += part_size;
     chunk_data += part_size;
     bytes_left -= part_size;
   }
@@ -902,10 +1686,175 @@ PLAINMTP_INTERNAL uint16_t CB_file_data_exchange( void* ptp_context, void* wrapp
 plainmtp_bool plainmtp_cursor_receive( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
   void* custom_state
+) {
+{
+  return plainmtp_cursor_receive_digest( cursor, device, chunk_limit, callback, custom_state,
+    NULL );
+}}
+
+#define receive_object ZZ_PLAINMTP(receive_object)
+PLAINMTP_INTERNAL plainmtp_bool receive_object( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state, plainmtp_digest_s* digest
+) {
+  int status;
+  entity_location_s descriptor;
+  file_exchange_s context;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  context.callback = callback;
+  context.custom_state = custom_state;
+  context.chunk_limit = chunk_limit;
+  context.callback_time = 0;
+  context.bytes = 0;
+  context.is_transfer = PLAINMTP_FALSE;
+
+  PLAINMTP(digest_start( &context.digest,
+    (digest != NULL) ? digest->algorithm : PLAINMTP_DIGEST_NONE ));
+
+  if ( get_cursor_state( cursor, &descriptor ) != CURSOR_ENTITY_OBJECT ) {
+    status = -1;
+  } else {
+    status = LIBMTP_Get_File_To_Handler( device->libmtp_socket, descriptor.object_handle,
+      &CB_file_data_exchange, &context, NULL, NULL );
+    (void)PLAINMTP(trace_device_call( &device->stats, &device->trace,
+      "LIBMTP_Get_File_To_Handler", start_time, status == 0 ));
+
+    (void)callback( NULL, 0, custom_state );
+  }
+
+  if (digest != NULL) { PLAINMTP(digest_finish( &context.digest, digest )); }
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_RECEIVE, start_time,
+    context.callback_time, context.bytes, status == 0 ));
+  return (status == 0);
+}}
+
+plainmtp_bool plainmtp_cursor_receive_digest( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state, plainmtp_digest_s* digest
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_digest" );
+  result = receive_object( cursor, device, chunk_limit, callback, custom_state,
+    digest );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define receive_object_range ZZ_PLAINMTP(receive_object_range)
+PLAINMTP_INTERNAL plainmtp_bool receive_object_range( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, uint64_t offset, size_t length, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  int status = 0;
+  entity_location_s descriptor;
+  file_exchange_s context;
+  unsigned char* data;
+  unsigned int data_size;
+  uint32_t part_size, processed;
+  uint64_t part_start_time;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  if ( get_cursor_state( cursor, &descriptor ) != CURSOR_ENTITY_OBJECT ) { return PLAINMTP_FALSE; }
+
+  if (!LIBMTP_Check_Capability( device->libmtp_socket, LIBMTP_DEVICECAP_GetPartialObject )) {
+    return PLAINMTP_FALSE;
+  }
+
+  context.callback = callback;
+  context.custom_state = custom_state;
+  context.chunk_limit = chunk_limit;
+  context.callback_time = 0;
+  context.bytes = 0;
+  context.is_transfer = PLAINMTP_FALSE;
+  PLAINMTP(digest_start( &context.digest, PLAINMTP_DIGEST_NONE ));
+
+  /* NB: Requesting the data beyond the end of the object is an error for some devices, so the
+    range is clamped with the known object size instead of relying on a short read. */
+  if (offset >= descriptor.object_size) {
+    length = 0;
+  } else if (descriptor.object_size - offset < length) {
+    length = (size_t)(descriptor.object_size - offset);
+  }
+
+  /* NB: Each part is a separate transaction, so the range is requested at once if its size allows
+    that. LIBMTP_GetPartialObject() reads the whole part into its own memory buffer, which is then
+    passed to the callback in chunks no larger than the chunk limit. */
+  while ( (length > 0) && (status == 0) ) {
+    part_size = (length < UINT32_MAX) ? (uint32_t)length : UINT32_MAX;
+
+    data = NULL;
+    part_start_time = PLAINMTP(get_monotonic_time());
+    status = LIBMTP_GetPartialObject( device->libmtp_socket, descriptor.object_handle, offset,
+      part_size, &data, &data_size );
+    (void)PLAINMTP(trace_device_call( &device->stats, &device->trace, "LIBMTP_GetPartialObject",
+      part_start_time, status == 0 ));
+
+    if (status == 0) {
+      if (data_size > part_size) { data_size = part_size; }
+
+      if (CB_file_data_exchange( NULL, &context, data_size, data, &processed )
+        != LIBMTP_HANDLER_RETURN_OK
+      ) {
+        status = -1;
+      }
+
+      /* The object has turned out to be shorter than it was. */
+      length = (data_size < part_size) ? 0 : length - data_size;
+      offset += data_size;
+    }
+
+    free( data );
+  }
+
+  (void)callback( NULL, 0, custom_state );
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_RECEIVE, start_time,
+    context.callback_time, context.bytes, status == 0 ));
+  return (status == 0);
+}}
+
+plainmtp_bool plainmtp_cursor_receive_range( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, uint64_t offset, size_t length, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_range" );
+  result = receive_object_range( cursor, device, offset, length, chunk_limit,
+    callback, custom_state );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define receive_object_thumbnail ZZ_PLAINMTP(receive_object_thumbnail)
+PLAINMTP_INTERNAL plainmtp_bool receive_object_thumbnail( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state
 ) {
   int status;
   entity_location_s descriptor;
   file_exchange_s context;
+  unsigned char* data = NULL;
+  unsigned int data_size = 0;
+  uint32_t processed;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   assert( cursor != NULL );
   assert( device != NULL );
@@ -913,35 +1862,93 @@ plainmtp_bool plainmtp_cursor_receive( struct plainmtp_cursor_s* cursor,
 
   if ( get_cursor_state( cursor, &descriptor ) != CURSOR_ENTITY_OBJECT ) { return PLAINMTP_FALSE; }
 
+  /* NB: Thumbnails are small enough to be always received by libmtp as a whole in one buffer. */
+  status = LIBMTP_Get_Thumbnail( device->libmtp_socket, descriptor.object_handle, &data,
+    &data_size );
+  (void)PLAINMTP(trace_device_call( &device->stats, &device->trace, "LIBMTP_Get_Thumbnail",
+    start_time, status == 0 ));
+  if (status != 0) {
+    free( data );
+    PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_RECEIVE, start_time, 0, 0,
+      PLAINMTP_FALSE ));
+    return PLAINMTP_FALSE;
+  }
+
   context.callback = callback;
   context.custom_state = custom_state;
   context.chunk_limit = chunk_limit;
+  context.callback_time = 0;
+  context.bytes = 0;
+  context.is_transfer = PLAINMTP_FALSE;
+  PLAINMTP(digest_start( &context.digest, PLAINMTP_DIGEST_NONE ));
 
-  status = LIBMTP_Get_File_To_Handler( device->libmtp_socket, descriptor.object_handle,
-    &CB_file_data_exchange, &context, NULL, NULL );
+  if (CB_file_data_exchange( NULL, &context, data_size, data, &processed )
+    != LIBMTP_HANDLER_RETURN_OK
+  ) {
+    status = -1;
+  }
 
+  free( data );
   (void)callback( NULL, 0, custom_state );
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_RECEIVE, start_time,
+    context.callback_time, context.bytes, status == 0 ));
   return (status == 0);
 }}
 
+plainmtp_bool plainmtp_cursor_receive_thumbnail( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_thumbnail" );
+  result = receive_object_thumbnail( cursor, device, chunk_limit,
+    callback, custom_state );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 plainmtp_bool plainmtp_cursor_transfer( struct plainmtp_cursor_s* parent,
   struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
   plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor
+) {
+{
+  return plainmtp_cursor_transfer_digest( parent, device, name, size, chunk_limit, callback,
+    custom_state, SET_cursor, NULL );
+}}
+
+/* NB: The UTF-8 file name is freed by this function, and it may be taken by the new cursor. */
+#define transfer_object ZZ_PLAINMTP(transfer_object)
+PLAINMTP_INTERNAL plainmtp_bool transfer_object( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, char* filename, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest
 ) {
   plainmtp_bool result;
   LIBMTP_file_t metadata = {0};
   entity_location_s descriptor;
   file_exchange_s context;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   assert( parent != NULL );
   assert( device != NULL );
   assert( (callback != NULL) || (size == 0) );
 
-  if (device->read_only) { return PLAINMTP_FALSE; }
-  if ( get_cursor_state( parent, &descriptor ) == CURSOR_ENTITY_DEVICE ) { return PLAINMTP_FALSE; }
+  if (digest != NULL) { digest->size = 0; }  /* For the case of an early failure. */
+
+  /* BEWARE: Short-circuit evaluation matters here! */
+  if ( (filename == NULL) || device->read_only
+    || (get_cursor_state( parent, &descriptor ) == CURSOR_ENTITY_DEVICE)
+  ) {
+    free( filename );
+    return PLAINMTP_FALSE;
+  }
 
-  metadata.filename = PLAINMTP(make_multibyte_string( name ));
-  if (metadata.filename == NULL) { return PLAINMTP_FALSE; }
+  metadata.filename = filename;
 
   metadata.parent_id = descriptor.object_handle;
   metadata.storage_id = descriptor.storage_id;
@@ -951,22 +1958,74 @@ plainmtp_bool plainmtp_cursor_transfer( struct plainmtp_cursor_s* parent,
   context.callback = callback;
   context.custom_state = custom_state;
   context.chunk_limit = chunk_limit;
+  context.callback_time = 0;
+  context.bytes = 0;
+  context.is_transfer = PLAINMTP_TRUE;
+
+  PLAINMTP(digest_start( &context.digest,
+    (digest != NULL) ? digest->algorithm : PLAINMTP_DIGEST_NONE ));
 
   result = LIBMTP_Send_File_From_Handler( device->libmtp_socket, &CB_file_data_exchange, &context,
     &metadata, NULL, NULL ) == 0;
+  (void)PLAINMTP(trace_device_call( &device->stats, &device->trace,
+    "LIBMTP_Send_File_From_Handler", start_time, result ));
 
   if (callback != NULL) {
     (void)callback( NULL, 0, custom_state );
   }
 
+  if (digest != NULL) { PLAINMTP(digest_finish( &context.digest, digest )); }
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_TRANSFER, start_time,
+    context.callback_time, context.bytes, result ));
+
   if ( result && (SET_cursor != NULL) ) {
-    *SET_cursor = setup_cursor_to_object( *SET_cursor, &metadata );
+    *SET_cursor = setup_cursor_to_object( *SET_cursor, &metadata, device->utf8_names );
   }
 
   free( metadata.filename );
   return result;
 }}
 
+plainmtp_bool plainmtp_cursor_transfer_digest( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_transfer_digest" );
+  result = transfer_object( parent, device, PLAINMTP(make_utf8_string( name )), size,
+    chunk_limit, callback, custom_state, SET_cursor, digest );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_cursor_transfer_u8( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const char* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor
+) {
+  plainmtp_bool result;
+  const size_t length = strlen( name ) + 1;
+  char* filename;
+{
+  assert( device != NULL );
+
+  /* libmtp takes a non-const name, and the new cursor may take it as well. */
+  filename = malloc( length );
+  if (filename != NULL) { memcpy( filename, name, length ); }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_transfer_u8" );
+  result = transfer_object( parent, device, filename, size, chunk_limit, callback,
+    custom_state, SET_cursor, NULL );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 #ifdef PP_PLAINMTP_MAIN_C_EX
 #include PP_PLAINMTP_MAIN_C_EX
 #endif
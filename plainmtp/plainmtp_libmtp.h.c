@@ -7,6 +7,13 @@
 #include <libmtp.h>
 
 #include "wpd_puid.c.h"
+#include "data_digest.c.h"
+#include "threads.c.h"
+#include "device_filters.c.h"
+#include "session_pool.c.h"
+#include "cursor_pool.c.h"
+#include "device_stats.c.h"
+#include "alloc_stats.c.h"
 
 /* By PTP/MTP standards, the values 0x00000000 and 0xFFFFFFFF are reserved for contextual use for
   both object handles and storage IDs. Alas, this exceeds the 'signed int' range of 'enum' in C. */
@@ -19,9 +26,39 @@
 #define CURSOR_HAS_STORAGE_ID( Cursor ) \
   !( (Cursor)->values.storage_id == STORAGE_ID_NULL )
 
+/* The strings of an entity copied into a pooled cursor are stored right after the cursor. */
+#define POOLED_CURSOR_STRINGS( Cursor ) \
+  ( (wchar_t*)( (Cursor) + 1 ) )
+
 #define WSTRING_PRINTABLE( String ) \
   !( ( (String) == NULL ) || ( (String)[0] == L'\0' ) )
 
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  #define LOCK_DEVICE( Device ) PLAINMTP(mutex_lock( (Device)->lock ))
+  #define UNLOCK_DEVICE( Device ) PLAINMTP(mutex_unlock( (Device)->lock ))
+#else
+  #define LOCK_DEVICE( Device ) ((void)0)
+  #define UNLOCK_DEVICE( Device ) ((void)0)
+#endif
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  #define ENTER_ALLOCS( Device, Api_Name ) \
+    PLAINMTP(enter_alloc_scope( &(Device)->allocs, Api_Name ))
+  #define LEAVE_ALLOCS( Device ) PLAINMTP(leave_alloc_scope( &(Device)->allocs ))
+  #define RESET_ALLOCS( Device ) PLAINMTP(reset_alloc_scope( &(Device)->allocs ))
+#else
+  #define ENTER_ALLOCS( Device, Api_Name ) ((void)0)
+  #define LEAVE_ALLOCS( Device ) ((void)0)
+  #define RESET_ALLOCS( Device ) ((void)0)
+#endif
+
+/* The API calls that communicate with the device are bracketed with these instead, so the trace
+  attributes the calls to libmtp to them, and the heap usage is accounted per API call. */
+#define ENTER_DEVICE( Device, Api_Name ) ( LOCK_DEVICE(Device), \
+  PLAINMTP(enter_api_call( &(Device)->trace, Api_Name )), ENTER_ALLOCS(Device, Api_Name) )
+#define LEAVE_DEVICE( Device ) ( LEAVE_ALLOCS(Device), \
+  PLAINMTP(leave_api_call( &(Device)->trace )), UNLOCK_DEVICE(Device) )
+
 #else
 #undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
 #endif
@@ -30,6 +67,9 @@
 typedef char* (*libmtp_device_string_f) (
   LIBMTP_mtpdevice_t* );
 
+/* Keys, names, captions, vendors and serials. The keys are "usb:BUS:DEVNUM" with 32-bit BUS. */
+enum { ENDPOINT_STRING_COUNT = 5, ENDPOINT_KEY_LENGTH_LIMIT = 24 };
+
 typedef enum ZZ_PLAINMTP(cursor_entity_e) {
   CURSOR_ENTITY_DEVICE,
   CURSOR_ENTITY_STORAGE,
@@ -40,12 +80,24 @@ typedef struct ZZ_PLAINMTP(file_exchange_s) {
   plainmtp_data_f callback;
   size_t chunk_limit;
   void* custom_state;
+
+  /* Accumulated for the device statistics. */
+  uint64_t callback_time;
+  uint64_t bytes;
+
+  /* The digest is computed over the data produced by the callback when transferring, and over the
+    data consumed by it when receiving, so it never depends on what the callback does with it. */
+  digest_state_s digest;
+  plainmtp_bool is_transfer;
 } file_exchange_s;
 
 typedef struct ZZ_PLAINMTP(entity_location_s) {
   uint32_t storage_id;
   uint32_t object_handle;
   uint32_t parent_handle;
+
+  /* Size of the object data as it was reported by the device when the object was retrieved. */
+  uint64_t object_size;
 } entity_location_s;
 
 typedef struct ZZ_PLAINMTP(storage_enumeration_s) {
@@ -58,11 +110,48 @@ typedef struct ZZ_PLAINMTP(storage_enumeration_s) {
 
 PLAINMTP_SUBCLASS( struct plainmtp_context_s, origin ) (
   LIBMTP_raw_device_t* hardware_list;
+  uint64_t startup_time;
+  session_pool_s sessions;
+  plainmtp_bool utf8_names;
+
+  /* Writable views of the endpoint strings, and whether they were probed for each endpoint. They
+    all reside in a single block starting with the keys, which is replaced on every refresh. */
+  const wchar_t** endpoint_keys;
+  const wchar_t** endpoint_names;
+  const wchar_t** endpoint_captions;
+  const wchar_t** endpoint_vendors;
+  const wchar_t** endpoint_serials;
+  plainmtp_bool* is_probed;
 );
 
+typedef struct ZZ_PLAINMTP(probe_task_s) {
+  struct plainmtp_context_s* context;
+  size_t endpoint_index;
+  thread_s* thread;
+} probe_task_s;
+
 struct plainmtp_device_s {
   LIBMTP_mtpdevice_t* libmtp_socket;
   plainmtp_bool read_only;
+  plainmtp_bool utf8_names;
+  plainmtp_stats_s stats;
+  device_trace_s trace;
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  alloc_scope_s allocs;
+#endif
+
+  /* Pool of the context the device was started from, and the copy of the endpoint key to keep the
+    session in it when the device is finished. The latter is NULL if the pool is disabled. */
+  session_pool_s* pool;
+  wchar_t* pool_key;
+
+  /* Pool of the cursors made by plainmtp_cursor_copy(). */
+  cursor_pool_s cursors;
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  /* Serializes the operations, since libmtp doesn't allow to use the socket concurrently. */
+  mutex_s* lock;
+#endif
 };
 
 PLAINMTP_SUBCLASS( struct plainmtp_cursor_s, current_entity ) (
@@ -74,6 +163,7 @@ PLAINMTP_SUBCLASS( struct plainmtp_cursor_s, current_entity ) (
     - storage_id - Contains STORAGE_ID_NULL if the cursor represents the device root.
     - object_handle - Contains OBJECT_HANDLE_NULL if the cursor doesn't point to an object.
     - parent_handle - Contains OBJECT_HANDLE_NULL if the current object is in the storage root.
+    - object_size - Contains 0 if the cursor doesn't point to an object.
   */
 
   entity_location_s values;
@@ -87,6 +177,14 @@ PLAINMTP_SUBCLASS( struct plainmtp_cursor_s, current_entity ) (
   */
 
   void* enumeration;
+
+  /* Pool the cursor was taken from, or NULL if it was allocated on its own. The strings that were
+    copied into the storage of a pooled cursor are referred by the 'pooled_*' members, and must
+    not be freed. They remain valid until the next copy into the same cursor. */
+  cursor_pool_s* pool;
+  const wchar_t* pooled_id;
+  const wchar_t* pooled_name;
+  const char* pooled_name_u8;
 );
 
 /**************************************************************************************************/
@@ -102,52 +200,103 @@ PLAINMTP_EXTERN cursor_entity_e ZZ_PLAINMTP(get_cursor_state( struct plainmtp_cu
   entity_location_s* OUT_descriptor ));
 PLAINMTP_EXTERN wchar_t* ZZ_PLAINMTP(make_device_string( LIBMTP_mtpdevice_t* socket,
   libmtp_device_string_f method ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(set_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index, LIBMTP_mtpdevice_t* socket ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(probe_endpoint( struct plainmtp_context_s* context,
+  size_t endpoint_index ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(cb_probe_endpoint( void* task ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(probe_all_endpoints( struct plainmtp_context_s* context ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index ));
+PLAINMTP_EXTERN wchar_t* ZZ_PLAINMTP(make_endpoint_key( const LIBMTP_raw_device_t* hardware ));
+PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(match_endpoint( const LIBMTP_raw_device_t* hardware,
+  const wchar_t* serial, const plainmtp_startup_s* options ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(filter_hardware_list(
+  LIBMTP_raw_device_t* hardware_list, int* device_count, const plainmtp_startup_s* options ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(drop_unmatched_endpoints( struct plainmtp_context_s* context,
+  const plainmtp_startup_s* options ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(detect_hardware_list(
+  LIBMTP_raw_device_t** OUT_hardware_list, int* OUT_device_count ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(adopt_hardware_list( struct plainmtp_context_s* context,
+  LIBMTP_raw_device_t* hardware_list, int device_count, const plainmtp_startup_s* options ));
 PLAINMTP_EXTERN wchar_t* ZZ_PLAINMTP(make_storage_name( LIBMTP_devicestorage_t* values ));
 PLAINMTP_EXTERN wchar_t* ZZ_PLAINMTP(make_storage_unique_id( LIBMTP_devicestorage_t* storage,
   wchar_t** OUT_volume_string ));
 PLAINMTP_EXTERN LIBMTP_devicestorage_t* ZZ_PLAINMTP(find_storage_by_id(
   LIBMTP_devicestorage_t* chain, uint32_t storage_id ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_device( struct plainmtp_device_s* device ));
 
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(obtain_image_copy( zz_plainmtp_cursor_s* entity,
   zz_plainmtp_cursor_s* source ));
+PLAINMTP_EXTERN plainmtp_format_e ZZ_PLAINMTP(get_object_format( LIBMTP_filetype_t filetype ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(fold_utf8_object_name( uint16_t name_units[8],
+  const char* name ));
 PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(obtain_object_image( zz_plainmtp_cursor_s* entity,
-  LIBMTP_file_t* object, const wpd_guid_plain_i required_id ));
+  LIBMTP_file_t* object, const wpd_guid_plain_i required_id, plainmtp_bool utf8_names ));
 PLAINMTP_EXTERN plainmtp_3val ZZ_PLAINMTP(obtain_storage_image( zz_plainmtp_cursor_s* entity,
   LIBMTP_devicestorage_t* storage, const wchar_t* required_id ));
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(obtain_device_image( zz_plainmtp_cursor_s* entity,
   LIBMTP_mtpdevice_t* socket ));
 PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_entity_image( zz_plainmtp_cursor_s* entity ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_cursor_image( struct plainmtp_cursor_s* cursor,
+  zz_plainmtp_cursor_s* entity ));
 PLAINMTP_EXTERN void ZZ_PLAINMTP(free_libmtp_object_listing( LIBMTP_file_t* chain ));
 PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_enumeration_data( struct plainmtp_cursor_s* cursor,
   entity_location_s* OUT_descriptor ));
 PLAINMTP_EXTERN void ZZ_PLAINMTP(clear_cursor( struct plainmtp_cursor_s* cursor ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_cursor( struct plainmtp_cursor_s* cursor ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(prepare_cursor(
   struct plainmtp_cursor_s* cursor, zz_plainmtp_cursor_s* entity ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(fill_pooled_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_cursor_s* source ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_to_object(
-  struct plainmtp_cursor_s* cursor, LIBMTP_file_t* object ));
+  struct plainmtp_cursor_s* cursor, LIBMTP_file_t* object, plainmtp_bool utf8_names ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_to_storage(
   struct plainmtp_cursor_s* cursor, LIBMTP_devicestorage_t* storage, const wchar_t* required_id ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_to_device(
   struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_by_handle(
-  struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket, uint32_t object_handle ));
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, uint32_t object_handle ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_by_lookup(
-  struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device,
   const wpd_guid_plain_i required_id ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_by_id(
-  struct plainmtp_cursor_s* cursor, LIBMTP_mtpdevice_t* socket, uint32_t storage_id,
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, uint32_t storage_id,
   plainmtp_bool force_update, const wchar_t* required_id ));
 PLAINMTP_EXTERN storage_enumeration_s* ZZ_PLAINMTP(make_storage_enumeration(
-  LIBMTP_mtpdevice_t* socket ));
+  struct plainmtp_device_s* device ));
+
+PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(switch_cursor(
+  struct plainmtp_cursor_s* cursor, const wchar_t* entity_id, struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(update_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(return_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
 
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_storage_first( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device ));
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_storage_next( struct plainmtp_cursor_s* cursor ));
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_object_first( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device ));
-PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_object_next( struct plainmtp_cursor_s* cursor ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_object_next( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
 
 PLAINMTP_EXTERN uint16_t ZZ_PLAINMTP(cb_file_data_exchange( void* ptp_context, void* wrapper_state,
   uint32_t chunk_size, unsigned char* chunk_data, uint32_t* OUT_processed ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(receive_object( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state, plainmtp_digest_s* digest ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(receive_object_range( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, uint64_t offset, size_t length, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(receive_object_thumbnail(
+  struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(transfer_object( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, char* filename, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest ));
 
 #endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -1,6 +1,7 @@
 #include "plainmtp_wpd.h.c"
 
 #include <assert.h>
+#include <wchar.h>
 
 #include <ObjBase.h>
 #include <PropIdl.h>
@@ -78,6 +79,26 @@
   ...to be continued.
 */
 
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+/* NB: The parentheses around the names suppress the macros that redirect them here. */
+
+#define accounted_co_task_mem_alloc ZZ_PLAINMTP(accounted_co_task_mem_alloc)
+PLAINMTP_INTERNAL LPVOID accounted_co_task_mem_alloc( SIZE_T size ) {
+  LPVOID result;
+{
+  result = (CoTaskMemAlloc)( size );
+  PLAINMTP(account_allocation( result, size ));
+  return result;
+}}
+
+#define accounted_co_task_mem_free ZZ_PLAINMTP(accounted_co_task_mem_free)
+PLAINMTP_INTERNAL void accounted_co_task_mem_free( LPVOID pointer ) {
+{
+  PLAINMTP(account_deallocation( pointer ));
+  (CoTaskMemFree)( pointer );
+}}
+#endif
+
 #define make_device_string ZZ_PLAINMTP(make_device_string)
 PLAINMTP_INTERNAL LPWSTR make_device_string( IPortableDeviceManager* wpd_manager,
   LPCWSTR device_id, wpd_device_string_f method
@@ -220,6 +241,12 @@ PLAINMTP_INTERNAL IPortableDeviceKeyCollection* make_values_request(void) {
 
     hr = IPortableDeviceKeyCollection_Add( result, &WPD_OBJECT_DATE_MODIFIED );
     if (FAILED(hr)) { goto failed; }
+
+    hr = IPortableDeviceKeyCollection_Add( result, &WPD_OBJECT_SIZE );
+    if (FAILED(hr)) { goto failed; }
+
+    hr = IPortableDeviceKeyCollection_Add( result, &WPD_OBJECT_CONTENT_TYPE );
+    if (FAILED(hr)) { goto failed; }
   }
 
   return result;
@@ -229,15 +256,224 @@ failed:
   return NULL;
 }}
 
+#define get_device_id_field ZZ_PLAINMTP(get_device_id_field)
+PLAINMTP_INTERNAL uint16_t get_device_id_field( LPCWSTR device_id, LPCWSTR prefix ) {
+  size_t length = wcslen( prefix );
+{
+  for (; *device_id != L'\0'; ++device_id) {
+    if (_wcsnicmp( device_id, prefix, length ) == 0) {
+      return (uint16_t)wcstoul( device_id + length, NULL, 16 );
+    }
+  }
+
+  return 0;
+}}
+
+#define make_device_serial ZZ_PLAINMTP(make_device_serial)
+PLAINMTP_INTERNAL LPWSTR make_device_serial( LPCWSTR device_id ) {
+  LPWSTR result;
+  LPCWSTR start = NULL;
+  size_t length, separators = 0;
+{
+  /* NB: The device ID is a device interface path, which for USB devices looks like this:
+    "\\?\usb#vid_XXXX&pid_XXXX#SERIAL#{INTERFACE}". If the device has no serial number, its place
+    is taken by the instance ID generated by Windows, which always contains ampersands. */
+  for (; *device_id != L'\0'; ++device_id) {
+    if (*device_id != L'#') { continue; }
+
+    if (++separators == 2) {
+      start = device_id + 1;
+    } else if (separators == 3) {
+      break;
+    }
+  }
+
+  if ( (start == NULL) || (*device_id == L'\0') ) { return NULL; }
+
+  length = (size_t)(device_id - start);
+  if ( (length == 0) || (wmemchr( start, L'&', length ) != NULL) ) { return NULL; }
+
+  result = CoTaskMemAlloc( (length + 1) * sizeof(*result) );
+  if (result == NULL) { return NULL; }
+
+  (void)wmemcpy( result, start, length );
+  result[length] = L'\0';
+
+  return result;
+}}
+
+#define match_device_id ZZ_PLAINMTP(match_device_id)
+PLAINMTP_INTERNAL plainmtp_bool match_device_id( LPCWSTR device_id, LPCWSTR serial,
+  const plainmtp_startup_s* options
+) {
+  plainmtp_filter_s device;
+{
+  /* WPD doesn't provide the location of the device on the bus, so it's never matched. A serial
+    number that can't be obtained from the device ID won't ever be known, so it never matches. */
+  device.vendor_id = get_device_id_field( device_id, L"vid_" );
+  device.product_id = get_device_id_field( device_id, L"pid_" );
+  device.bus_location = 0;
+  device.device_number = 0;
+  device.serial_number = serial;
+
+  return PLAINMTP(match_device_filters( options, &device, PLAINMTP_FALSE )) == PLAINMTP_GOOD;
+}}
+
+#define release_device_ids ZZ_PLAINMTP(release_device_ids)
+PLAINMTP_INTERNAL void release_device_ids( LPWSTR* device_ids, size_t device_count ) {
+  size_t i;
+{
+  for (i = 0; i < device_count; ++i) { CoTaskMemFree( device_ids[i] ); }
+  CoTaskMemFree( device_ids );
+}}
+
+#define release_endpoint_strings ZZ_PLAINMTP(release_endpoint_strings)
+PLAINMTP_INTERNAL void release_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index
+) {
+{
+  CoTaskMemFree( (void*)context->endpoint_keys[endpoint_index] );
+  CoTaskMemFree( (void*)context->endpoint_names[endpoint_index] );
+  CoTaskMemFree( (void*)context->endpoint_captions[endpoint_index] );
+  CoTaskMemFree( (void*)context->endpoint_vendors[endpoint_index] );
+  CoTaskMemFree( (void*)context->endpoint_serials[endpoint_index] );
+}}
+
+/* NB: On success, the device IDs are owned by the context, and on failure they're left intact. */
+#define adopt_device_ids ZZ_PLAINMTP(adopt_device_ids)
+PLAINMTP_INTERNAL plainmtp_bool adopt_device_ids( struct plainmtp_context_s* context,
+  LPWSTR* device_ids, size_t device_count, const plainmtp_startup_s* options
+) {
+  IPortableDeviceManager* const wpd_manager = context->wpd_manager;
+  LPCWSTR *keys, *names, *captions, *vendors, *serials;
+  LPWSTR serial;
+  size_t i, j, count = 0;
+  const size_t known_count = context->origin.endpoints.count;
+{
+  if (device_count > 0) {
+    keys = CoTaskMemAlloc( 5 * device_count * sizeof(*keys) );
+    if (keys == NULL) { return PLAINMTP_FALSE; }
+
+    names = keys + device_count;
+    captions = names + device_count;
+    vendors = captions + device_count;
+    serials = vendors + device_count;
+  } else {
+    keys = names = captions = vendors = serials = NULL;
+  }
+
+  for (i = 0; i < device_count; ++i) {
+    serial = make_device_serial( device_ids[i] );
+
+    if (!match_device_id( device_ids[i], serial, options )) {
+      CoTaskMemFree( device_ids[i] );
+      CoTaskMemFree( serial );
+      continue;
+    }
+
+    /* The endpoints of the devices that are still connected keep their strings, which are taken
+      from the known endpoint, so its key is reset to NULL in order not to be matched again. */
+    for (j = 0; j < known_count; ++j) {
+      if (context->endpoint_keys[j] == NULL) { continue; }
+      if (wcscmp( context->endpoint_keys[j], device_ids[i] ) == 0) { break; }
+    }
+
+    if (j < known_count) {
+      CoTaskMemFree( device_ids[i] );
+      CoTaskMemFree( serial );
+
+      keys[count] = context->endpoint_keys[j];
+      names[count] = context->endpoint_names[j];
+      captions[count] = context->endpoint_captions[j];
+      vendors[count] = context->endpoint_vendors[j];
+      serials[count] = context->endpoint_serials[j];
+      context->endpoint_keys[j] = NULL;
+    } else {
+      keys[count] = device_ids[i];  /* proclaims LPCWSTR as the "effective type" */
+      serials[count] = serial;
+      names[count] = make_device_string( wpd_manager, keys[count],
+        wpd_manager->lpVtbl->GetDeviceFriendlyName );
+      captions[count] = make_device_string( wpd_manager, keys[count],
+        wpd_manager->lpVtbl->GetDeviceDescription );
+      vendors[count] = make_device_string( wpd_manager, keys[count],
+        wpd_manager->lpVtbl->GetDeviceManufacturer );
+    }
+
+    ++count;
+  }
+
+  for (j = 0; j < known_count; ++j) {
+    if (context->endpoint_keys[j] != NULL) { release_endpoint_strings( context, j ); }
+  }
+
+  CoTaskMemFree( context->endpoint_keys );
+  CoTaskMemFree( device_ids );
+
+  context->endpoint_keys = keys;
+  context->endpoint_names = names;
+  context->endpoint_captions = captions;
+  context->endpoint_vendors = vendors;
+  context->endpoint_serials = serials;
+
+  context->origin.endpoints.count = count;
+  context->origin.endpoints.keys = keys;
+  context->origin.endpoints.names = names;
+  context->origin.endpoints.captions = captions;
+  context->origin.endpoints.vendors = vendors;
+  context->origin.endpoints.serials = serials;
+  return PLAINMTP_TRUE;
+}}
+
+#define make_device_id_copy ZZ_PLAINMTP(make_device_id_copy)
+PLAINMTP_INTERNAL LPWSTR make_device_id_copy( LPCWSTR device_id ) {
+  LPWSTR result;
+  size_t size = (wcslen( device_id ) + 1) * sizeof(*device_id);
+{
+  result = CoTaskMemAlloc( size );
+  if (result == NULL) { return NULL; }
+
+  CopyMemory( result, device_id, size );
+  return result;
+}}
+
+#define release_device ZZ_PLAINMTP(release_device)
+PLAINMTP_INTERNAL void release_device( struct plainmtp_device_s* device ) {
+{
+  LOCK_DEVICE(device);
+
+  IUnknown_Release( device->values_request );
+
+  IUnknown_Release( device->wpd_properties );
+  IUnknown_Release( device->wpd_resources );
+  IUnknown_Release( device->wpd_content );
+
+  /*IPortableDevice_Close( device->wpd_socket );*/
+  IUnknown_Release( device->wpd_socket );
+
+  UNLOCK_DEVICE(device);
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  PLAINMTP(mutex_destroy( device->lock ));
+#endif
+
+  PLAINMTP(cursor_pool_finish( &device->cursors ));
+  CoTaskMemFree( device->pool_key );
+
+  RESET_ALLOCS(device);
+  CoTaskMemFree( device );
+}}
+
 #define make_library_context ZZ_PLAINMTP(make_library_context)
-PLAINMTP_INTERNAL struct plainmtp_context_s* make_library_context(void) {
+PLAINMTP_INTERNAL struct plainmtp_context_s* make_library_context(
+  const plainmtp_startup_s* options
+) {
   HRESULT hr;
   IPortableDeviceManager* wpd_manager;
   IPortableDeviceKeyCollection* wpd_values_request;
   struct plainmtp_context_s* context = NULL;
   LPWSTR* device_ids_buffer;
-  LPCWSTR *wpd_device_ids, *wpd_device_names, *wpd_device_captions, *wpd_device_vendors;
-  size_t device_count, i;
+  size_t device_count;
+  uint64_t idle_time;
 {
   hr = CoCreateInstance( &CLSID_PortableDeviceManager, NULL, CLSCTX_INPROC_SERVER,
     &IID_IPortableDeviceManager, &wpd_manager );
@@ -246,51 +482,37 @@ PLAINMTP_INTERNAL struct plainmtp_context_s* make_library_context(void) {
   hr = obtain_wpd_device_ids( wpd_manager, &device_ids_buffer, &device_count );
   if (FAILED(hr)) { goto failed_main; }
 
-  context = CoTaskMemAlloc( sizeof(*context) + 4 * device_count * sizeof(*wpd_device_ids) );
+  context = CoTaskMemAlloc( sizeof(*context) );
   if (context == NULL) { goto failed_full; }
 
-  if ( device_count == 0 ) {
-    wpd_device_ids = NULL;
-    wpd_device_names = NULL;
-    wpd_device_captions = NULL;
-    wpd_device_vendors = NULL;
-  } else {
-    wpd_device_ids = (LPCWSTR*)(context + 1);
-    wpd_device_names = wpd_device_ids + device_count;
-    wpd_device_captions = wpd_device_names + device_count;
-    wpd_device_vendors = wpd_device_captions + device_count;
-
-    for (i = 0; i < device_count; ++i) {
-      wpd_device_ids[i] = device_ids_buffer[i];  /* proclaims LPCWSTR as the "effective type" */
-      wpd_device_names[i] = make_device_string( wpd_manager, wpd_device_ids[i],
-        wpd_manager->lpVtbl->GetDeviceFriendlyName );
-      wpd_device_captions[i] = make_device_string( wpd_manager, wpd_device_ids[i],
-        wpd_manager->lpVtbl->GetDeviceDescription );
-      wpd_device_vendors[i] = make_device_string( wpd_manager, wpd_device_ids[i],
-        wpd_manager->lpVtbl->GetDeviceManufacturer );
-    }
-
-    CoTaskMemFree( device_ids_buffer );
-  }
-
   wpd_values_request = make_values_request();
-  if (wpd_values_request == NULL) { goto failed_main; }
+  if (wpd_values_request == NULL) { goto failed_full; }
 
   context->wpd_manager = wpd_manager;
   context->wpd_values_request = wpd_values_request;
 
-  context->origin.endpoints.count = device_count;
-  context->origin.endpoints.keys = wpd_device_ids;
-  context->origin.endpoints.names = wpd_device_names;
-  context->origin.endpoints.captions = wpd_device_captions;
-  context->origin.endpoints.vendors = wpd_device_vendors;
+  context->endpoint_keys = NULL;
+  context->origin.endpoints.count = 0;
 
   context->origin.features.active_mode_receive = PLAINMTP_TRUE;
   context->origin.features.active_mode_transfer = PLAINMTP_TRUE;
+
+  idle_time = (options != NULL) ? options->session_idle_time : 0;
+  if (!PLAINMTP(session_pool_start( &context->sessions, idle_time, &release_device ))) {
+    IUnknown_Release( wpd_values_request );
+    goto failed_full;
+  }
+
+  if (!adopt_device_ids( context, device_ids_buffer, device_count, options )) {
+    PLAINMTP(session_pool_finish( &context->sessions ));
+    IUnknown_Release( wpd_values_request );
+    goto failed_full;
+  }
+
   return context;
 
 failed_full:
-  CoTaskMemFree( device_ids_buffer );
+  release_device_ids( device_ids_buffer, device_count );
 
 failed_main:
   CoTaskMemFree( context );
@@ -317,7 +539,7 @@ PLAINMTP_INTERNAL IPortableDevice* make_connection_socket( LPCWSTR device_id,
     share_mode = FILE_SHARE_EXCLUSIVE;
   }
 
-  hr = CoCreateInstance( &CLSID_PortableDevice, NULL, CLSCTX_INPROC_SERVER, &IID_IPortableDevice,
+  hr = CoCreateInstance( &CLSID_PORTABLE_DEVICE, NULL, CLSCTX_INPROC_SERVER, &IID_IPortableDevice,
     &result );
   if (FAILED(hr)) { return NULL; }
 
@@ -354,47 +576,118 @@ PLAINMTP_INTERNAL IPortableDevice* make_connection_socket( LPCWSTR device_id,
 }}
 
 /*
-  There's no plans to support multithreading natively at the moment, so we use:
+  Unless the library is built with the CC_PLAINMTP_THREAD_SAFE option, device handles aren't meant
+  to be shared across threads, so we use:
   - CoInitialize() instead of CoInitializeEx()
   - CLSID_PortableDevice instead of CLSID_PortableDeviceFTM
+  Otherwise, the multithreaded apartment and the free-threaded marshaler are used, so interfaces
+  obtained in one thread can be called from another one without marshaling.
 */
 
 struct plainmtp_context_s* plainmtp_startup(void) {
+{
+  return plainmtp_startup_ex( NULL );
+}}
+
+/* NB: WPD obtains the endpoint strings from its own device registry without opening the devices,
+  so there's no need to postpone this, and the lazy probing option is just ignored. The filters are
+  matched against the device IDs, which contain the USB vendor and product IDs, and the serial
+  numbers unless the devices don't report them. */
+
+struct plainmtp_context_s* plainmtp_startup_ex( const plainmtp_startup_s* options ) {
   HRESULT hr;
   struct plainmtp_context_s* result;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  if (!PLAINMTP(start_alloc_accounting())) { return NULL; }
+#endif
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  hr = CoInitializeEx( NULL, COINIT_MULTITHREADED );
+#else
   hr = CoInitialize( NULL );
+#endif
   if (SUCCEEDED(hr)) {
-    result = make_library_context();
-    if (result != NULL) { return result; }
+    result = make_library_context( options );
+    if (result != NULL) {
+      result->startup_time = PLAINMTP(get_monotonic_time()) - start_time;
+      return result;
+    }
     CoUninitialize();
   }
 
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  PLAINMTP(finish_alloc_accounting());
+#endif
+
   return NULL;
 }}
 
+plainmtp_bool plainmtp_context_refresh( struct plainmtp_context_s* context,
+  const plainmtp_startup_s* options
+) {
+  HRESULT hr;
+  LPWSTR* device_ids_buffer;
+  size_t device_count;
+{
+  assert( context != NULL );
+
+  /* NB: The WPD manager caches the list of the devices, so it has to be updated explicitly. */
+  hr = IPortableDeviceManager_RefreshDeviceList( context->wpd_manager );
+  if (FAILED(hr)) { return PLAINMTP_FALSE; }
+
+  hr = obtain_wpd_device_ids( context->wpd_manager, &device_ids_buffer, &device_count );
+  if (FAILED(hr)) { return PLAINMTP_FALSE; }
+
+  if (!adopt_device_ids( context, device_ids_buffer, device_count, options )) {
+    release_device_ids( device_ids_buffer, device_count );
+    return PLAINMTP_FALSE;
+  }
+
+  /* The sessions of the devices that were disconnected are unusable, so they're released. */
+  PLAINMTP(retain_pooled_sessions( &context->sessions, context->origin.endpoints.keys,
+    context->origin.endpoints.count ));
+  return PLAINMTP_TRUE;
+}}
+
+plainmtp_bool plainmtp_endpoint_probe( struct plainmtp_context_s* context,
+  size_t endpoint_index
+) {
+{
+  assert( context != NULL );
+  assert( endpoint_index < context->origin.endpoints.count );
+
+  return PLAINMTP_TRUE;
+
+  (void)context;
+  (void)endpoint_index;
+}}
+
 void plainmtp_shutdown( struct plainmtp_context_s* context ) {
   size_t i;
 {
   assert( context != NULL );
 
   /*
-    We don't use the FreePortableDevicePnPIDs() function because this would require 4 loops over 1.
+    We don't use the FreePortableDevicePnPIDs() function because this would require 5 loops over 1.
     https://docs.microsoft.com/en-us/windows/win32/wpd_sdk/freeportabledevicepnpids
   */
 
-  for (i = 0; i < context->origin.endpoints.count; ++i) {
-    CoTaskMemFree( (void*)context->origin.endpoints.keys[i] );
-    CoTaskMemFree( (void*)context->origin.endpoints.names[i] );
-    CoTaskMemFree( (void*)context->origin.endpoints.captions[i] );
-    CoTaskMemFree( (void*)context->origin.endpoints.vendors[i] );
-  }
+  PLAINMTP(session_pool_finish( &context->sessions ));
+
+  for (i = 0; i < context->origin.endpoints.count; ++i) { release_endpoint_strings( context, i ); }
+  CoTaskMemFree( context->endpoint_keys );
 
   IUnknown_Release( context->wpd_manager );
   IUnknown_Release( context->wpd_values_request );
 
   CoTaskMemFree( context );
   CoUninitialize();
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  PLAINMTP(finish_alloc_accounting());
+#endif
 }}
 
 struct plainmtp_device_s* plainmtp_device_start( struct plainmtp_context_s* context,
@@ -402,15 +695,34 @@ struct plainmtp_device_s* plainmtp_device_start( struct plainmtp_context_s* cont
 ) {
   HRESULT hr;
   struct plainmtp_device_s* device = NULL;  /* STAGER requires all variables to be initialized. */
+  uint64_t start_time = 0;
   int i;
 {
   assert( context != NULL );
   assert( endpoint_index < context->origin.endpoints.count );
 
+  device = PLAINMTP(take_pooled_session( &context->sessions,
+    context->origin.endpoints.keys[endpoint_index], read_only ));
+
+  if (device != NULL) {
+    ZeroMemory( &device->stats, sizeof(device->stats) );
+    RESET_ALLOCS(device);
+    PLAINMTP(account_operation( &device->stats, PLAINMTP_OPERATION_STARTUP,
+      context->startup_time, PLAINMTP_TRUE ));
+    return device;
+  }
+
   STAGER_BLOCK(i) {
     STAGER_PHASE(1, {
       device = CoTaskMemAlloc( sizeof(*device) );
       if (device == NULL) break;
+
+      ZeroMemory( &device->stats, sizeof(device->stats) );
+      ZeroMemory( &device->trace, sizeof(device->trace) );
+      RESET_ALLOCS(device);
+      PLAINMTP(account_operation( &device->stats, PLAINMTP_OPERATION_STARTUP,
+        context->startup_time, PLAINMTP_TRUE ));
+      start_time = PLAINMTP(get_monotonic_time());
     },{
       CoTaskMemFree( device );
     });
@@ -445,10 +757,36 @@ struct plainmtp_device_s* plainmtp_device_start( struct plainmtp_context_s* cont
       IUnknown_Release( device->wpd_properties );
     });
 
+    STAGER_PHASE(6, {
+      if (!PLAINMTP(cursor_pool_start( &device->cursors, sizeof(struct plainmtp_cursor_s) ))) {
+        break;
+      }
+    },{
+      PLAINMTP(cursor_pool_finish( &device->cursors ));
+    });
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+    STAGER_PHASE(7, {
+      device->lock = PLAINMTP(mutex_create());
+      if (device->lock == NULL) break;
+    },{
+      PLAINMTP(mutex_destroy( device->lock ));
+    });
+#endif
+
     STAGER_SUCCESS({
+      PLAINMTP(account_device_call( &device->stats, &device->trace,
+        PLAINMTP_OPERATION_DEVICE_OPEN, "IPortableDevice_Open", start_time, PLAINMTP_TRUE ));
+
       /* As this instance is identical across all the devices, we just obtain a reference to it. */
       device->values_request = context->wpd_values_request;
       (void)IUnknown_AddRef( context->wpd_values_request );
+
+      /* If the key can't be copied, the session is just not pooled. */
+      device->pool = &context->sessions;
+      device->pool_key = (context->sessions.idle_time != 0)
+        ? make_device_id_copy( context->origin.endpoints.keys[endpoint_index] ) : NULL;
+      device->read_only = read_only;
       return device;
     });
   }
@@ -460,16 +798,100 @@ void plainmtp_device_finish( struct plainmtp_device_s* device ) {
 {
   assert( device != NULL );
 
-  IUnknown_Release( device->values_request );
+  /* Wait for the operation that may still be in progress in another thread. */
+  LOCK_DEVICE(device);
+  (void)PLAINMTP(stop_device_trace( &device->trace, NULL ));
+  UNLOCK_DEVICE(device);
 
-  IUnknown_Release( device->wpd_properties );
-  IUnknown_Release( device->wpd_resources );
-  IUnknown_Release( device->wpd_content );
+  if (!PLAINMTP(keep_pooled_session( device->pool, device, device->pool_key, device->read_only ))) {
+    release_device( device );
+  }
+}}
 
-  /*IPortableDevice_Close( device->wpd_socket );*/
-  IUnknown_Release( device->wpd_socket );
+plainmtp_bool plainmtp_device_acquire( struct plainmtp_device_s* device, plainmtp_bool wait ) {
+{
+  assert( device != NULL );
 
-  CoTaskMemFree( device );
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  if (!wait) { return PLAINMTP(mutex_try_lock( device->lock )); }
+#else
+  (void)device;
+  (void)wait;
+#endif
+
+  LOCK_DEVICE(device);
+  return PLAINMTP_TRUE;
+}}
+
+void plainmtp_device_release( struct plainmtp_device_s* device ) {
+{
+  assert( device != NULL );
+
+#ifndef CC_PLAINMTP_THREAD_SAFE
+  (void)device;
+#endif
+
+  UNLOCK_DEVICE(device);
+}}
+
+void plainmtp_device_get_stats( struct plainmtp_device_s* device, plainmtp_stats_s* OUT_stats ) {
+{
+  assert( device != NULL );
+  assert( OUT_stats != NULL );
+
+  LOCK_DEVICE(device);
+  *OUT_stats = device->stats;
+  UNLOCK_DEVICE(device);
+}}
+
+void plainmtp_device_reset_stats( struct plainmtp_device_s* device ) {
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  ZeroMemory( &device->stats, sizeof(device->stats) );
+  UNLOCK_DEVICE(device);
+}}
+
+plainmtp_bool plainmtp_device_start_trace( struct plainmtp_device_s* device, size_t capacity ) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  result = PLAINMTP(start_device_trace( &device->trace, capacity ));
+  UNLOCK_DEVICE(device);
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_device_stop_trace( struct plainmtp_device_s* device, const wchar_t* path ) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  LOCK_DEVICE(device);
+  result = PLAINMTP(stop_device_trace( &device->trace, path ));
+  UNLOCK_DEVICE(device);
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_device_get_alloc_stats( struct plainmtp_device_s* device,
+  const char* api_name, plainmtp_alloc_stats_s* OUT_stats
+) {
+{
+  assert( OUT_stats != NULL );
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  return PLAINMTP(get_alloc_stats( (device != NULL) ? &device->allocs : NULL, api_name,
+    OUT_stats ));
+#else
+  (void)device;
+  (void)api_name;
+  (void)OUT_stats;
+  return PLAINMTP_FALSE;
+#endif
 }}
 
 /**************************************************************************************************/
@@ -481,6 +903,30 @@ PLAINMTP_INTERNAL void wipe_object_image( zz_plainmtp_cursor_s* object ) {
   CoTaskMemFree( (void*)object->name );
 }}
 
+/* NB: This must be used instead of wipe_object_image() for the current and the shadowed objects of
+  the cursor, as they may refer to the strings in the storage of a pooled cursor. */
+#define wipe_cursor_image ZZ_PLAINMTP(wipe_cursor_image)
+PLAINMTP_INTERNAL void wipe_cursor_image( struct plainmtp_cursor_s* cursor,
+  zz_plainmtp_cursor_s* object
+) {
+{
+  if (object->id != cursor->pooled_id) { CoTaskMemFree( (void*)object->id ); }
+  if (object->name != cursor->pooled_name) { CoTaskMemFree( (void*)object->name ); }
+}}
+
+#define get_object_format ZZ_PLAINMTP(get_object_format)
+PLAINMTP_INTERNAL plainmtp_format_e get_object_format( REFGUID content_type ) {
+{
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_FOLDER )) { return PLAINMTP_FORMAT_FOLDER; }
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_IMAGE )) { return PLAINMTP_FORMAT_IMAGE; }
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_AUDIO )) { return PLAINMTP_FORMAT_AUDIO; }
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_VIDEO )) { return PLAINMTP_FORMAT_VIDEO; }
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_PLAYLIST )) { return PLAINMTP_FORMAT_PLAYLIST; }
+  if (IsEqualGUID( content_type, &WPD_CONTENT_TYPE_DOCUMENT )) { return PLAINMTP_FORMAT_DOCUMENT; }
+
+  return PLAINMTP_FORMAT_UNDEFINED;
+}}
+
 #define obtain_object_image ZZ_PLAINMTP(obtain_object_image)
 PLAINMTP_INTERNAL plainmtp_bool obtain_object_image( zz_plainmtp_cursor_s* object,
   IPortableDeviceValues* values
@@ -489,11 +935,33 @@ PLAINMTP_INTERNAL plainmtp_bool obtain_object_image( zz_plainmtp_cursor_s* objec
   LPWSTR tempstr;
   PROPVARIANT propvar;
   SYSTEMTIME systime;
+  ULONGLONG size;
+  GUID content_type;
 {
   hr = IPortableDeviceValues_GetStringValue( values, &WPD_OBJECT_PERSISTENT_UNIQUE_ID, &tempstr );
   if (FAILED(hr)) { return PLAINMTP_FALSE; }
   object->id = tempstr;
 
+  /* NB: Only the IDs in the GUID form have the binary one, so this failure is not an error. */
+  (void)plainmtp_binary_id_parse( &object->binary_id, tempstr );
+
+  /* WPD provides the names in UTF-16 natively, so the 'utf8_names' option is ignored. */
+  object->name_u8 = NULL;
+
+  /* The device root and storages are functional objects, which are containers as well. */
+  hr = IPortableDeviceValues_GetGuidValue( values, &WPD_OBJECT_CONTENT_TYPE, &content_type );
+  if (SUCCEEDED(hr)) {
+    object->format = get_object_format( &content_type );
+    object->is_container = (object->format == PLAINMTP_FORMAT_FOLDER)
+      || IsEqualGUID( &content_type, &WPD_CONTENT_TYPE_FUNCTIONAL_OBJECT );
+  } else {
+    object->format = PLAINMTP_FORMAT_UNDEFINED;
+    object->is_container = PLAINMTP_FALSE;
+  }
+
+  hr = IPortableDeviceValues_GetUnsignedLargeIntegerValue( values, &WPD_OBJECT_SIZE, &size );
+  object->size = ( SUCCEEDED(hr) && !object->is_container ) ? size : PLAINMTP_SIZE_UNKNOWN;
+
   PropVariantInit( &propvar );
   hr = IPortableDeviceValues_GetValue( values, &WPD_OBJECT_DATE_MODIFIED, &propvar );
 
@@ -546,11 +1014,11 @@ quit:
 #define clear_cursor ZZ_PLAINMTP(clear_cursor)
 PLAINMTP_INTERNAL void clear_cursor( struct plainmtp_cursor_s* cursor ) {
 {
-  wipe_object_image( &cursor->current_object );
+  wipe_cursor_image( cursor, &cursor->current_object );
   IUnknown_Release( cursor->current_values );
 
   if (cursor->parent_values != NULL) {
-    wipe_object_image( &cursor->parent_object );
+    wipe_cursor_image( cursor, &cursor->parent_object );
     IUnknown_Release( cursor->parent_values );
   }
 
@@ -559,6 +1027,37 @@ PLAINMTP_INTERNAL void clear_cursor( struct plainmtp_cursor_s* cursor ) {
   }
 }}
 
+#define release_cursor ZZ_PLAINMTP(release_cursor)
+PLAINMTP_INTERNAL void release_cursor( struct plainmtp_cursor_s* cursor ) {
+{
+  clear_cursor( cursor );
+
+  if (cursor->pool != NULL) {
+    PLAINMTP(keep_pooled_cursor( cursor->pool, cursor ));
+  } else {
+    CoTaskMemFree( cursor );
+  }
+}}
+
+/* NB: The cursor must be pooled and already cleared, and the strings of the source object must fit
+  into its storage. */
+#define fill_pooled_cursor ZZ_PLAINMTP(fill_pooled_cursor)
+PLAINMTP_INTERNAL void fill_pooled_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_cursor_s* source
+) {
+{
+  cursor->current_object = source->current_object;
+  PLAINMTP(copy_pooled_strings( POOLED_CURSOR_STRINGS(cursor), &cursor->current_object ));
+
+  cursor->pooled_id = cursor->current_object.id;
+  cursor->pooled_name = cursor->current_object.name;
+
+  cursor->current_values = source->current_values;
+  (void)IUnknown_AddRef( source->current_values );
+  cursor->parent_values = NULL;
+  cursor->enumerator = NULL;
+}}
+
 /* NB: This enforces atomic one-time change to preserve cursor initial state in case of error. */
 #define setup_cursor_by_values ZZ_PLAINMTP(setup_cursor_by_values)
 PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_values(
@@ -574,6 +1073,10 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_values(
       wipe_object_image( &object );
       return NULL;
     }
+
+    cursor->pool = NULL;
+    cursor->pooled_id = NULL;
+    cursor->pooled_name = NULL;
   } else {
     clear_cursor( cursor );
   }
@@ -592,9 +1095,12 @@ PLAINMTP_INTERNAL struct plainmtp_cursor_s* setup_cursor_by_handle(
 ) {
   HRESULT hr;
   IPortableDeviceValues* values;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   hr = IPortableDeviceProperties_GetValues( device->wpd_properties, handle, device->values_request,
     &values );
+  PLAINMTP(account_device_call( &device->stats, &device->trace, PLAINMTP_OPERATION_OBJECT_INFO,
+    "IPortableDeviceProperties_GetValues", start_time, SUCCEEDED(hr) ));
   if (FAILED(hr)) { return NULL; }
 
   cursor = setup_cursor_by_values( cursor, values );
@@ -608,11 +1114,19 @@ struct plainmtp_cursor_s* plainmtp_cursor_assign( struct plainmtp_cursor_s* curs
 {
   if (cursor != source) {
     if (source == NULL) {
-      clear_cursor( cursor );
-      CoTaskMemFree( cursor );
+      release_cursor( cursor );
       return NULL;
     }
 
+    /* Copying the strings into the storage of a pooled cursor can't fail, so it's done in place. */
+    if ( (cursor != NULL) && (cursor->pool != NULL)
+      && PLAINMTP(fit_pooled_strings( &source->current_object ))
+    ) {
+      clear_cursor( cursor );
+      fill_pooled_cursor( cursor, source );
+      return cursor;
+    }
+
     cursor = setup_cursor_by_values( cursor, source->current_values );
     if (cursor != NULL) { (void)IUnknown_AddRef( source->current_values ); }
   }
@@ -620,7 +1134,42 @@ struct plainmtp_cursor_s* plainmtp_cursor_assign( struct plainmtp_cursor_s* curs
   return cursor;
 }}
 
-struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* cursor,
+struct plainmtp_cursor_s* plainmtp_cursor_copy( struct plainmtp_cursor_s* source,
+  struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s* cursor;
+  zz_plainmtp_cursor_s object;
+{
+  assert( source != NULL );
+  assert( device != NULL );
+
+  cursor = PLAINMTP(take_pooled_cursor( &device->cursors ));
+  if (cursor == NULL) { return NULL; }
+
+  cursor->pool = &device->cursors;
+  cursor->pooled_id = NULL;
+  cursor->pooled_name = NULL;
+
+  if (PLAINMTP(fit_pooled_strings( &source->current_object ))) {
+    fill_pooled_cursor( cursor, source );
+    return cursor;
+  }
+
+  if ( obtain_object_image( &object, source->current_values ) ) {
+    cursor->current_object = object;
+    cursor->current_values = source->current_values;
+    (void)IUnknown_AddRef( source->current_values );
+    cursor->parent_values = NULL;
+    cursor->enumerator = NULL;
+    return cursor;
+  }
+
+  PLAINMTP(keep_pooled_cursor( cursor->pool, cursor ));
+  return NULL;
+}}
+
+#define switch_cursor ZZ_PLAINMTP(switch_cursor)
+PLAINMTP_INTERNAL struct plainmtp_cursor_s* switch_cursor( struct plainmtp_cursor_s* cursor,
   const wchar_t* entity_id, struct plainmtp_device_s* device
 ) {
   LPWSTR handle;
@@ -642,7 +1191,38 @@ struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* curs
   return cursor;
 }}
 
-plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
+struct plainmtp_cursor_s* plainmtp_cursor_switch( struct plainmtp_cursor_s* cursor,
+  const wchar_t* entity_id, struct plainmtp_device_s* device
+) {
+  struct plainmtp_cursor_s* result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_switch" );
+  result = switch_cursor( cursor, entity_id, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+struct plainmtp_cursor_s* plainmtp_cursor_switch_binary( struct plainmtp_cursor_s* cursor,
+  const plainmtp_binary_id_s* entity_id, struct plainmtp_device_s* device
+) {
+  wchar_t id_string[PLAINMTP_BINARY_ID_STRING_SIZE];
+{
+  assert( entity_id != NULL );
+  assert( !PLAINMTP(is_nil_wpd_plain_guid( entity_id->bytes )) );
+
+  /* The root and storages have the nil ID, so it never identifies a single entity. */
+  if ( PLAINMTP(is_nil_wpd_plain_guid( entity_id->bytes )) ) { return NULL; }
+
+  /* WPD accepts only the string form of the persistent unique ID. */
+  plainmtp_binary_id_format( entity_id, id_string );
+  return plainmtp_cursor_switch( cursor, id_string, device );
+}}
+
+#define update_cursor ZZ_PLAINMTP(update_cursor)
+PLAINMTP_INTERNAL plainmtp_bool update_cursor( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device
 ) {
   HRESULT hr;
@@ -660,7 +1240,22 @@ plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
   return (cursor != NULL);
 }}
 
-plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
+plainmtp_bool plainmtp_cursor_update( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_update" );
+  result = update_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define return_cursor ZZ_PLAINMTP(return_cursor)
+PLAINMTP_INTERNAL plainmtp_bool return_cursor( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device
 ) {
   HRESULT hr;
@@ -702,12 +1297,28 @@ plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
   return (cursor != NULL) || is_root;
 }}
 
-plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
+plainmtp_bool plainmtp_cursor_return( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  if (device == NULL) { return return_cursor( cursor, NULL ); }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_return" );
+  result = return_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+#define select_cursor ZZ_PLAINMTP(select_cursor)
+PLAINMTP_INTERNAL plainmtp_bool select_cursor( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device
 ) {
   HRESULT hr;
   IPortableDeviceValues* values;
   LPWSTR handle;
+  uint64_t start_time;
 {
   assert( cursor != NULL );
 
@@ -717,7 +1328,7 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
       IUnknown_Release( cursor->enumerator );
       cursor->enumerator = NULL;
 
-      wipe_object_image( &cursor->parent_object );
+      wipe_cursor_image( cursor, &cursor->parent_object );
       IUnknown_Release( cursor->parent_values );
       cursor->parent_values = NULL;
     }
@@ -725,6 +1336,8 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
     return PLAINMTP_FALSE;
   }
 
+  start_time = PLAINMTP(get_monotonic_time());
+
   if (cursor->parent_values == NULL) {
     if (cursor->enumerator != NULL) {
       hr = IEnumPortableDeviceObjectIDs_Reset( cursor->enumerator );
@@ -746,9 +1359,17 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
   }
 
   hr = IEnumPortableDeviceObjectIDs_Next( cursor->enumerator, 1, &handle, NULL );
+  PLAINMTP(account_device_call( &device->stats, &device->trace,
+    PLAINMTP_OPERATION_FOLDER_LISTING, "IEnumPortableDeviceObjectIDs_Next", start_time,
+    SUCCEEDED(hr) ));
+
   if (hr == S_OK) {
+    start_time = PLAINMTP(get_monotonic_time());
     hr = IPortableDeviceProperties_GetValues( device->wpd_properties, handle,
       device->values_request, &values );
+    PLAINMTP(account_device_call( &device->stats, &device->trace,
+      PLAINMTP_OPERATION_OBJECT_INFO, "IPortableDeviceProperties_GetValues", start_time,
+      SUCCEEDED(hr) ));
     CoTaskMemFree( handle );
 
     if (SUCCEEDED(hr)) {
@@ -773,6 +1394,20 @@ plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
   return PLAINMTP_FALSE;
 }}
 
+plainmtp_bool plainmtp_cursor_select( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device
+) {
+  plainmtp_bool result;
+{
+  if (device == NULL) { return select_cursor( cursor, NULL ); }
+
+  ENTER_DEVICE( device, "plainmtp_cursor_select" );
+  result = select_cursor( cursor, device );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 /**************************************************************************************************/
 
 #define make_transfer_stream ZZ_PLAINMTP(make_transfer_stream)
@@ -827,31 +1462,44 @@ PLAINMTP_INTERNAL size_t stream_write( IStream* stream, const char* data, size_t
   return result;
 }}
 
-plainmtp_bool plainmtp_cursor_receive( struct plainmtp_cursor_s* cursor,
-  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
-  void* custom_state
+#define receive_resource ZZ_PLAINMTP(receive_resource)
+PLAINMTP_INTERNAL plainmtp_bool receive_resource( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, REFPROPERTYKEY resource, const uint64_t* range,
+  size_t chunk_limit, plainmtp_data_f callback, void* custom_state, digest_state_s* digest
 ) {
   HRESULT hr;
   IStream* stream;
   LPWSTR handle;
+  LARGE_INTEGER position;
   DWORD optimal_chunk_size;
   void* buffer;
+  uint64_t length = UINT64_MAX, callback_time = 0, bytes = 0, callback_start;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
-  assert( cursor != NULL );
-  assert( device != NULL );
-  assert( callback != NULL );
-
   hr = IPortableDeviceValues_GetStringValue( cursor->current_values, &WPD_OBJECT_ID, &handle );
   if (FAILED(hr)) { return PLAINMTP_FALSE; }
 
-  hr = IPortableDeviceResources_GetStream( device->wpd_resources, handle, &WPD_RESOURCE_DEFAULT,
-    STGM_READ, &optimal_chunk_size, &stream );
+  hr = IPortableDeviceResources_GetStream( device->wpd_resources, handle, resource, STGM_READ,
+    &optimal_chunk_size, &stream );
   CoTaskMemFree( handle );
   if (FAILED(hr)) { return PLAINMTP_FALSE; }
 
   /* NB: The IStream::Stat() method is not implemented for IPortableDeviceDataStream (returns
     E_NOTIMPL), making it impossible to obtain a guaranteed actual object size to be received. */
 
+  if (range != NULL) {
+    /* NB: Seeking is implemented with the GetPartialObject operation, so it fails if the device
+      doesn't support it. Reading after the end of the stream just returns no data. */
+    position.QuadPart = (LONGLONG)range[0];
+    hr = IStream_Seek( stream, position, STREAM_SEEK_SET, NULL );
+    if (FAILED(hr)) {
+      IUnknown_Release( stream );
+      return PLAINMTP_FALSE;
+    }
+
+    length = range[1];
+  }
+
   if ( (chunk_limit == 0) || (optimal_chunk_size < chunk_limit) ) {
     chunk_limit = optimal_chunk_size;
   }
@@ -867,36 +1515,144 @@ plainmtp_bool plainmtp_cursor_receive( struct plainmtp_cursor_s* cursor,
       specification, which requires S_FALSE to be returned if fewer bytes than requested have been
       read without any errors due to the end of the stream. In this case, it still returns S_OK. */
 
-    while (
+    while ( (length > 0) && (
       bytes_read = 0,  /* NB: IPortableDeviceDataStream::Read() does not set this to 0 on error. */
-      hr = ISequentialStream_Read( stream, chunk, (ULONG)chunk_limit, &bytes_read ),
+      hr = ISequentialStream_Read( stream, chunk,
+        (ULONG)( (length < chunk_limit) ? length : chunk_limit ), &bytes_read ),
       bytes_read != 0
-    ) {
+    ) ) {
+      PLAINMTP(digest_update( digest, chunk, bytes_read ));
+
       /* NB: If the callback unexpectedly returns NULL, this will lead to STG_E_INVALIDPOINTER. */
+      callback_start = PLAINMTP(get_monotonic_time());
       chunk = callback( chunk, bytes_read, custom_state );
+      callback_time += PLAINMTP(get_monotonic_time()) - callback_start;
+      bytes += bytes_read;
+      length -= bytes_read;
     }
 
     (void)callback( buffer, 0, custom_state );
   }
 
+  /* The whole exchange through the stream is traced as a single call. */
+  (void)PLAINMTP(trace_device_call( &device->stats, &device->trace,
+    "IPortableDeviceResources_GetStream", start_time, SUCCEEDED(hr) ));
   IUnknown_Release( stream );
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_RECEIVE, start_time,
+    callback_time, bytes, SUCCEEDED(hr) ));
   return SUCCEEDED(hr);
 }}
 
+plainmtp_bool plainmtp_cursor_receive( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state
+) {
+{
+  return plainmtp_cursor_receive_digest( cursor, device, chunk_limit, callback, custom_state,
+    NULL );
+}}
+
+plainmtp_bool plainmtp_cursor_receive_digest( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state, plainmtp_digest_s* digest
+) {
+  digest_state_s digest_state;
+  plainmtp_bool result;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  PLAINMTP(digest_start( &digest_state,
+    (digest != NULL) ? digest->algorithm : PLAINMTP_DIGEST_NONE ));
+  if (digest != NULL) { digest->size = 0; }  /* For the case of an early failure. */
+
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_digest" );
+  result = receive_resource( cursor, device, &WPD_RESOURCE_DEFAULT, NULL, chunk_limit, callback,
+    custom_state, &digest_state );
+  LEAVE_DEVICE( device );
+
+  if (digest != NULL) { PLAINMTP(digest_finish( &digest_state, digest )); }
+  return result;
+}}
+
+plainmtp_bool plainmtp_cursor_receive_range( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, uint64_t offset, size_t length, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  digest_state_s digest_state;
+  uint64_t range[2];
+  plainmtp_bool result;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  range[0] = offset;
+  range[1] = length;
+
+  PLAINMTP(digest_start( &digest_state, PLAINMTP_DIGEST_NONE ));
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_range" );
+  result = receive_resource( cursor, device, &WPD_RESOURCE_DEFAULT, range, chunk_limit, callback,
+    custom_state, &digest_state );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_cursor_receive_thumbnail( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, size_t chunk_limit, plainmtp_data_f callback,
+  void* custom_state
+) {
+  digest_state_s digest_state;
+  plainmtp_bool result;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  PLAINMTP(digest_start( &digest_state, PLAINMTP_DIGEST_NONE ));
+  ENTER_DEVICE( device, "plainmtp_cursor_receive_thumbnail" );
+  result = receive_resource( cursor, device, &WPD_RESOURCE_THUMBNAIL, NULL, chunk_limit, callback,
+    custom_state, &digest_state );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
 plainmtp_bool plainmtp_cursor_transfer( struct plainmtp_cursor_s* parent,
   struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
   plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor
 ) {
+{
+  return plainmtp_cursor_transfer_digest( parent, device, name, size, chunk_limit, callback,
+    custom_state, SET_cursor, NULL );
+}}
+
+#define transfer_object ZZ_PLAINMTP(transfer_object)
+PLAINMTP_INTERNAL plainmtp_bool transfer_object( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest
+) {
+  digest_state_s digest_state;
   plainmtp_bool result = PLAINMTP_FALSE;
   HRESULT hr;
   IStream* stream;
   LPWSTR handle;
   DWORD optimal_chunk_size;
   void* buffer;
+  uint64_t callback_time = 0, bytes = 0, callback_start;
+  const uint64_t start_time = PLAINMTP(get_monotonic_time());
 {
   assert( parent != NULL );
   assert( device != NULL );
 
+  PLAINMTP(digest_start( &digest_state,
+    (digest != NULL) ? digest->algorithm : PLAINMTP_DIGEST_NONE ));
+  if (digest != NULL) { digest->size = 0; }  /* For the case of an early failure. */
+
   stream = make_transfer_stream( parent, device, name, size, &optimal_chunk_size );
   if (stream == NULL) { return PLAINMTP_FALSE; }
 
@@ -906,18 +1662,25 @@ plainmtp_bool plainmtp_cursor_transfer( struct plainmtp_cursor_s* parent,
     }
 
     /*if (size < chunk_limit) { chunk_limit = (size_t)size; }*/
+    callback_start = PLAINMTP(get_monotonic_time());
     buffer = callback( NULL, chunk_limit, custom_state );
+    callback_time += PLAINMTP(get_monotonic_time()) - callback_start;
 
     if (buffer != NULL) {
       void* chunk = buffer;
 
       while (
         chunk_limit = stream_write( stream, chunk, chunk_limit ),
+        PLAINMTP(digest_update( &digest_state, chunk, chunk_limit )),
+        bytes += chunk_limit,
         size -= chunk_limit,
         (size > 0) && (chunk_limit > 0)
       ) {
         if (size < chunk_limit) { chunk_limit = (size_t)size; }
+
+        callback_start = PLAINMTP(get_monotonic_time());
         chunk = callback( chunk, chunk_limit, custom_state );
+        callback_time += PLAINMTP(get_monotonic_time()) - callback_start;
       }
 
       (void)callback( buffer, 0, custom_state );
@@ -930,6 +1693,8 @@ plainmtp_bool plainmtp_cursor_transfer( struct plainmtp_cursor_s* parent,
   }
 
   hr = IStream_Commit( stream, STGC_DEFAULT );
+  (void)PLAINMTP(trace_device_call( &device->stats, &device->trace,
+    "IPortableDeviceContent_CreateObjectWithPropertiesAndData", start_time, SUCCEEDED(hr) ));
   if (FAILED(hr)) { goto cleanup; }
 
   if (SET_cursor != NULL) {
@@ -952,6 +1717,53 @@ no_cursor:
   result = PLAINMTP_TRUE;
 cleanup:
   IUnknown_Release( stream );
+  if (digest != NULL) { PLAINMTP(digest_finish( &digest_state, digest )); }
+
+  PLAINMTP(account_data_exchange( &device->stats, PLAINMTP_OPERATION_TRANSFER, start_time,
+    callback_time, bytes, result ));
+  return result;
+}}
+
+plainmtp_bool plainmtp_cursor_transfer_digest( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest
+) {
+  plainmtp_bool result;
+{
+  assert( device != NULL );
+
+  ENTER_DEVICE( device, "plainmtp_cursor_transfer_digest" );
+  result = transfer_object( parent, device, name, size, chunk_limit, callback,
+    custom_state, SET_cursor, digest );
+  LEAVE_DEVICE( device );
+
+  return result;
+}}
+
+plainmtp_bool plainmtp_cursor_transfer_u8( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const char* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor
+) {
+  plainmtp_bool result;
+  LPWSTR wide_name;
+  int length;
+{
+  assert( name != NULL );
+
+  length = MultiByteToWideChar( CP_UTF8, MB_ERR_INVALID_CHARS, name, -1, NULL, 0 );
+  if (length == 0) { return PLAINMTP_FALSE; }
+
+  wide_name = CoTaskMemAlloc( length * sizeof(*wide_name) );
+  if (wide_name == NULL) { return PLAINMTP_FALSE; }
+
+  result = PLAINMTP_FALSE;
+  if (MultiByteToWideChar( CP_UTF8, MB_ERR_INVALID_CHARS, name, -1, wide_name, length ) == length) {
+    result = plainmtp_cursor_transfer( parent, device, wide_name, size, chunk_limit, callback,
+      custom_state, SET_cursor );
+  }
+
+  CoTaskMemFree( wide_name );
   return result;
 }}
 
@@ -27,6 +27,55 @@
 #include <Windows.h>
 #include <PortableDeviceApi.h>
 
+#include "wpd_puid.c.h"
+#include "data_digest.c.h"
+#include "threads.c.h"
+#include "device_filters.c.h"
+#include "session_pool.c.h"
+#include "cursor_pool.c.h"
+#include "device_stats.c.h"
+#include "alloc_stats.c.h"
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  #define CLSID_PORTABLE_DEVICE CLSID_PortableDeviceFTM
+  #define LOCK_DEVICE( Device ) PLAINMTP(mutex_lock( (Device)->lock ))
+  #define UNLOCK_DEVICE( Device ) PLAINMTP(mutex_unlock( (Device)->lock ))
+#else
+  #define CLSID_PORTABLE_DEVICE CLSID_PortableDevice
+  #define LOCK_DEVICE( Device ) ((void)0)
+  #define UNLOCK_DEVICE( Device ) ((void)0)
+#endif
+
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  #define ENTER_ALLOCS( Device, Api_Name ) \
+    PLAINMTP(enter_alloc_scope( &(Device)->allocs, Api_Name ))
+  #define LEAVE_ALLOCS( Device ) PLAINMTP(leave_alloc_scope( &(Device)->allocs ))
+  #define RESET_ALLOCS( Device ) PLAINMTP(reset_alloc_scope( &(Device)->allocs ))
+#else
+  #define ENTER_ALLOCS( Device, Api_Name ) ((void)0)
+  #define LEAVE_ALLOCS( Device ) ((void)0)
+  #define RESET_ALLOCS( Device ) ((void)0)
+#endif
+
+/* NB: The backend manages its memory with the COM allocator, so it's accounted too. The memory that
+  WPD allocates by itself is unknown to the accounting, so freeing it is accounted as nothing. */
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  #include <ObjBase.h>  /* The original declarations must precede the macros. */
+  #define CoTaskMemAlloc( Size ) ZZ_PLAINMTP(accounted_co_task_mem_alloc( Size ))
+  #define CoTaskMemFree( Pointer ) ZZ_PLAINMTP(accounted_co_task_mem_free( Pointer ))
+#endif
+
+/* The API calls that communicate with the device are bracketed with these instead, so the trace
+  attributes the calls to WPD to them, and the heap usage is accounted per API call. */
+#define ENTER_DEVICE( Device, Api_Name ) ( LOCK_DEVICE(Device), \
+  PLAINMTP(enter_api_call( &(Device)->trace, Api_Name )), ENTER_ALLOCS(Device, Api_Name) )
+#define LEAVE_DEVICE( Device ) ( LEAVE_ALLOCS(Device), \
+  PLAINMTP(leave_api_call( &(Device)->trace )), UNLOCK_DEVICE(Device) )
+
+/* The strings of an object copied into a pooled cursor are stored right after the cursor. */
+#define POOLED_CURSOR_STRINGS( Cursor ) \
+  ( (wchar_t*)( (Cursor) + 1 ) )
+
 #else
 #undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
 #endif
@@ -40,6 +89,16 @@ enum { FILE_SHARE_EXCLUSIVE = 0 };
 PLAINMTP_SUBCLASS( struct plainmtp_context_s, origin ) (
   IPortableDeviceManager* wpd_manager;
   IPortableDeviceKeyCollection* wpd_values_request;
+  uint64_t startup_time;
+  session_pool_s sessions;
+
+  /* Writable views of the endpoint strings. They all reside in a single block starting with the
+    keys, which is replaced on every refresh. */
+  LPCWSTR* endpoint_keys;
+  LPCWSTR* endpoint_names;
+  LPCWSTR* endpoint_captions;
+  LPCWSTR* endpoint_vendors;
+  LPCWSTR* endpoint_serials;
 );
 
 struct plainmtp_device_s {
@@ -48,6 +107,25 @@ struct plainmtp_device_s {
   IPortableDeviceResources* wpd_resources;
   IPortableDeviceProperties* wpd_properties;
   IPortableDeviceKeyCollection* values_request;
+  plainmtp_stats_s stats;
+  device_trace_s trace;
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+  alloc_scope_s allocs;
+#endif
+
+  /* Pool of the context the device was started from, and the copy of the endpoint key to keep the
+    session in it when the device is finished. The latter is NULL if the pool is disabled. */
+  session_pool_s* pool;
+  LPWSTR pool_key;
+  plainmtp_bool read_only;
+
+  /* Pool of the cursors made by plainmtp_cursor_copy(). */
+  cursor_pool_s cursors;
+
+#ifdef CC_PLAINMTP_THREAD_SAFE
+  /* Serializes the operations, since MTP allows only one of them to be in progress at a time. */
+  mutex_s* lock;
+#endif
 };
 
 /* TODO: IPortableDeviceValues is used to achieve cost-free reference counting semantics (which is
@@ -65,11 +143,23 @@ PLAINMTP_SUBCLASS( struct plainmtp_cursor_s, current_object ) (
 
   /* If NULL, the current object was never enumerated, or enumeration has ended with an error. */
   IEnumPortableDeviceObjectIDs* enumerator;
+
+  /* Pool the cursor was taken from, or NULL if it was allocated on its own. The strings that were
+    copied into the storage of a pooled cursor are referred by 'pooled_id' and 'pooled_name', and
+    must not be freed. They remain valid until the next copy into the same cursor. */
+  cursor_pool_s* pool;
+  LPCWSTR pooled_id;
+  LPCWSTR pooled_name;
 );
 
 /**************************************************************************************************/
 #ifndef CC_PLAINMTP_NO_INTERNAL_API
 
+#ifdef CC_PLAINMTP_ALLOC_ACCOUNTING
+PLAINMTP_EXTERN LPVOID ZZ_PLAINMTP(accounted_co_task_mem_alloc( SIZE_T size ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(accounted_co_task_mem_free( LPVOID pointer ));
+#endif
+
 PLAINMTP_EXTERN LPWSTR ZZ_PLAINMTP(make_device_string( IPortableDeviceManager* wpd_manager,
   LPCWSTR device_id, wpd_device_string_f method ));
 PLAINMTP_EXTERN HRESULT ZZ_PLAINMTP(obtain_wpd_device_ids( IPortableDeviceManager* wpd_manager,
@@ -78,22 +168,55 @@ PLAINMTP_EXTERN LPWSTR ZZ_PLAINMTP(make_object_handle_from_puid(
   IPortableDeviceContent* wpd_content, LPCWSTR object_puid ));
 
 PLAINMTP_EXTERN IPortableDeviceKeyCollection* ZZ_PLAINMTP(make_values_request(void));
-PLAINMTP_EXTERN struct plainmtp_context_s* ZZ_PLAINMTP(make_library_context(void));
+PLAINMTP_EXTERN uint16_t ZZ_PLAINMTP(get_device_id_field( LPCWSTR device_id, LPCWSTR prefix ));
+PLAINMTP_EXTERN LPWSTR ZZ_PLAINMTP(make_device_serial( LPCWSTR device_id ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(match_device_id( LPCWSTR device_id, LPCWSTR serial,
+  const plainmtp_startup_s* options ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_device_ids( LPWSTR* device_ids, size_t device_count ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_endpoint_strings( struct plainmtp_context_s* context,
+  size_t endpoint_index ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(adopt_device_ids( struct plainmtp_context_s* context,
+  LPWSTR* device_ids, size_t device_count, const plainmtp_startup_s* options ));
+PLAINMTP_EXTERN LPWSTR ZZ_PLAINMTP(make_device_id_copy( LPCWSTR device_id ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_device( struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN struct plainmtp_context_s* ZZ_PLAINMTP(make_library_context(
+  const plainmtp_startup_s* options ));
 PLAINMTP_EXTERN IPortableDevice* ZZ_PLAINMTP(make_connection_socket( LPCWSTR device_id,
   plainmtp_bool read_only ));
 
 PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_object_image( zz_plainmtp_cursor_s* object ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(wipe_cursor_image( struct plainmtp_cursor_s* cursor,
+  zz_plainmtp_cursor_s* object ));
+PLAINMTP_EXTERN plainmtp_format_e ZZ_PLAINMTP(get_object_format( REFGUID content_type ));
 PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(obtain_object_image( zz_plainmtp_cursor_s* object,
   IPortableDeviceValues* values ));
 PLAINMTP_EXTERN void ZZ_PLAINMTP(clear_cursor( struct plainmtp_cursor_s* cursor ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_cursor( struct plainmtp_cursor_s* cursor ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(fill_pooled_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_cursor_s* source ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_by_values(
   struct plainmtp_cursor_s* cursor, IPortableDeviceValues* values ));
 PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(setup_cursor_by_handle(
   struct plainmtp_cursor_s* cursor, struct plainmtp_device_s* device, LPCWSTR handle ));
+PLAINMTP_EXTERN struct plainmtp_cursor_s* ZZ_PLAINMTP(switch_cursor(
+  struct plainmtp_cursor_s* cursor, const wchar_t* entity_id, struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(update_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(return_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(select_cursor( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device ));
 
 PLAINMTP_EXTERN IStream* ZZ_PLAINMTP(make_transfer_stream( struct plainmtp_cursor_s* cursor,
   struct plainmtp_device_s* device, const wchar_t* name, uint64_t size,
   DWORD* OUT_optimal_chunk_size ));
 PLAINMTP_EXTERN size_t ZZ_PLAINMTP(stream_write( IStream* stream, const char* data, size_t size ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(receive_resource( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, REFPROPERTYKEY resource, const uint64_t* range,
+  size_t chunk_limit, plainmtp_data_f callback, void* custom_state, digest_state_s* digest ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(transfer_object( struct plainmtp_cursor_s* parent,
+  struct plainmtp_device_s* device, const wchar_t* name, uint64_t size, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state, struct plainmtp_cursor_s** SET_cursor,
+  plainmtp_digest_s* digest ));
 
 #endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -0,0 +1,158 @@
+#include "session_pool.h.c"
+
+#include <stdlib.h>
+
+/* NB: These must be called with the pool locked, while the sessions are released after unlocking
+  it, since that may wait for the operations that are still in progress on the devices. */
+
+#define detach_expired_sessions ZZ_PLAINMTP(detach_expired_sessions)
+PLAINMTP_INTERNAL pooled_session_s* detach_expired_sessions( session_pool_s* pool ) {
+  pooled_session_s *result, **link = &pool->sessions;
+  const uint64_t now = PLAINMTP(get_monotonic_time());
+{
+  /* The sessions are ordered by their finish time, so all the expired ones are at the end. */
+  while ( (*link != NULL) && (now - (*link)->finish_time < pool->idle_time) ) {
+    link = &(*link)->next;
+  }
+
+  result = *link;
+  *link = NULL;
+
+  return result;
+}}
+
+#define release_detached_sessions ZZ_PLAINMTP(release_detached_sessions)
+PLAINMTP_INTERNAL void release_detached_sessions( session_pool_s* pool,
+  pooled_session_s* chain
+) {
+  pooled_session_s* next;
+{
+  while (chain != NULL) {
+    next = chain->next;
+    pool->release( chain->device );
+    free( chain );
+    chain = next;
+  }
+}}
+
+#define session_pool_start PLAINMTP(session_pool_start)
+plainmtp_bool session_pool_start( session_pool_s* pool, uint64_t idle_time,
+  session_release_f release
+) {
+{
+  pool->sessions = NULL;
+  pool->idle_time = idle_time;
+  pool->release = release;
+
+  pool->lock = NULL;
+  if (idle_time == 0) { return PLAINMTP_TRUE; }
+
+  pool->lock = PLAINMTP(mutex_create());
+  return (pool->lock != NULL);
+}}
+
+#define session_pool_finish PLAINMTP(session_pool_finish)
+void session_pool_finish( session_pool_s* pool ) {
+{
+  release_detached_sessions( pool, pool->sessions );
+  pool->sessions = NULL;
+
+  if (pool->lock != NULL) { PLAINMTP(mutex_destroy( pool->lock )); }
+}}
+
+#define take_pooled_session PLAINMTP(take_pooled_session)
+struct plainmtp_device_s* take_pooled_session( session_pool_s* pool, const wchar_t* key,
+  plainmtp_bool read_only
+) {
+  pooled_session_s *expired, *node = NULL, **link = &pool->sessions;
+  struct plainmtp_device_s* result = NULL;
+{
+  if ( (pool->idle_time == 0) || (key == NULL) ) { return NULL; }
+
+  LOCK_POOL(pool);
+  expired = detach_expired_sessions( pool );
+
+  while (*link != NULL) {
+    node = *link;
+
+    if ( (node->read_only == read_only) && (wcscmp( node->key, key ) == 0) ) {
+      *link = node->next;
+      result = node->device;
+      break;
+    }
+
+    link = &node->next;
+  }
+
+  UNLOCK_POOL(pool);
+
+  if (result != NULL) { free( node ); }
+  release_detached_sessions( pool, expired );
+
+  return result;
+}}
+
+#define keep_pooled_session PLAINMTP(keep_pooled_session)
+plainmtp_bool keep_pooled_session( session_pool_s* pool, struct plainmtp_device_s* device,
+  const wchar_t* key, plainmtp_bool read_only
+) {
+  pooled_session_s *expired, *node;
+{
+  if ( (pool->idle_time == 0) || (key == NULL) ) { return PLAINMTP_FALSE; }
+
+  node = malloc( sizeof(*node) );
+  if (node == NULL) { return PLAINMTP_FALSE; }
+
+  node->device = device;
+  node->key = key;
+  node->read_only = read_only;
+  node->finish_time = PLAINMTP(get_monotonic_time());
+
+  LOCK_POOL(pool);
+  node->next = pool->sessions;
+  pool->sessions = node;
+  expired = detach_expired_sessions( pool );
+  UNLOCK_POOL(pool);
+
+  release_detached_sessions( pool, expired );
+  return PLAINMTP_TRUE;
+}}
+
+#define retain_pooled_sessions PLAINMTP(retain_pooled_sessions)
+void retain_pooled_sessions( session_pool_s* pool, const wchar_t* const* keys,
+  size_t key_count
+) {
+  pooled_session_s *expired, *dropped = NULL, *node, **link = &pool->sessions;
+  size_t i;
+{
+  if (pool->idle_time == 0) { return; }
+
+  LOCK_POOL(pool);
+  expired = detach_expired_sessions( pool );
+
+  while (*link != NULL) {
+    node = *link;
+
+    for (i = 0; i < key_count; ++i) {
+      if ( (keys[i] != NULL) && (wcscmp( node->key, keys[i] ) == 0) ) { break; }
+    }
+
+    if (i < key_count) {
+      link = &node->next;
+      continue;
+    }
+
+    *link = node->next;
+    node->next = dropped;
+    dropped = node;
+  }
+
+  UNLOCK_POOL(pool);
+
+  release_detached_sessions( pool, expired );
+  release_detached_sessions( pool, dropped );
+}}
+
+#ifdef PP_PLAINMTP_SESSION_POOL_C_EX
+#include PP_PLAINMTP_SESSION_POOL_C_EX
+#endif
@@ -0,0 +1,50 @@
+#ifndef ZZ_PLAINMTP_SESSION_POOL_C_IG
+#define ZZ_PLAINMTP_SESSION_POOL_C_IG
+#include "common.i.h"
+
+#include <wchar.h>
+
+#include "plainmtp.h"
+
+typedef void (*session_release_f) ( struct plainmtp_device_s* device );
+
+typedef struct ZZ_PLAINMTP(pooled_session_s) {
+  struct plainmtp_device_s* device;
+  const wchar_t* key;  /* Owned by the device. */
+  plainmtp_bool read_only;
+  uint64_t finish_time;
+  struct ZZ_PLAINMTP(pooled_session_s)* next;
+} pooled_session_s;
+
+/* Finished sessions that are kept open to be reused, the most recently finished ones first. The
+  sessions that have been idle for too long are released lazily, whenever the pool is accessed. If
+  the idle time is 0, the pool is disabled and never keeps any sessions. */
+typedef struct ZZ_PLAINMTP(session_pool_s) {
+  pooled_session_s* sessions;
+  uint64_t idle_time;
+  session_release_f release;
+
+  /* NB: The pool is shared by all the devices of the context, which the engine starts and finishes
+    in its worker threads even without the CC_PLAINMTP_THREAD_SAFE option, so it's always locked.
+    NULL if the pool is disabled. */
+  struct ZZ_PLAINMTP(mutex_s)* lock;  /* See threads.c.h */
+} session_pool_s;
+
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(session_pool_start( session_pool_s* pool,
+  uint64_t idle_time, session_release_f release ));
+PLAINMTP_EXTERN void PLAINMTP(session_pool_finish( session_pool_s* pool ));
+
+/* The session is taken out of the pool, so it's not shared with anyone else. If the pool couldn't
+  keep the session, it's up to the caller to release it. */
+PLAINMTP_EXTERN struct plainmtp_device_s* PLAINMTP(take_pooled_session( session_pool_s* pool,
+  const wchar_t* key, plainmtp_bool read_only ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(keep_pooled_session( session_pool_s* pool,
+  struct plainmtp_device_s* device, const wchar_t* key, plainmtp_bool read_only ));
+
+/* Releases the sessions whose keys are not among the specified ones. */
+PLAINMTP_EXTERN void PLAINMTP(retain_pooled_sessions( session_pool_s* pool,
+  const wchar_t* const* keys, size_t key_count ));
+
+#else
+#error ZZ_PLAINMTP_SESSION_POOL_C_IG
+#endif
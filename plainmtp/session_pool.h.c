@@ -0,0 +1,24 @@
+#include "session_pool.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include "device_stats.c.h"
+#include "threads.c.h"
+
+#define LOCK_POOL( Pool ) PLAINMTP(mutex_lock( (Pool)->lock ))
+#define UNLOCK_POOL( Pool ) PLAINMTP(mutex_unlock( (Pool)->lock ))
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN pooled_session_s* ZZ_PLAINMTP(detach_expired_sessions( session_pool_s* pool ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(release_detached_sessions( session_pool_s* pool,
+  pooled_session_s* chain ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
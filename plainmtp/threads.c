@@ -0,0 +1,241 @@
+/* NB: Recursive mutexes are an XSI extension of POSIX threads, so they have to be requested
+  explicitly. */
+#ifndef _WIN32
+  #define _XOPEN_SOURCE 500
+#endif
+
+#include "threads.h.c"
+
+#include <stdlib.h>
+
+#define mutex_create PLAINMTP(mutex_create)
+mutex_s* mutex_create(void) {
+  mutex_s* mutex;
+#ifndef _WIN32
+  pthread_mutexattr_t attributes;
+  int status;
+#endif
+{
+  mutex = malloc( sizeof(*mutex) );
+  if (mutex == NULL) { return NULL; }
+
+#ifdef _WIN32
+  InitializeCriticalSection( &mutex->handle );
+#else
+  if (pthread_mutexattr_init( &attributes ) != 0) { goto failed; }
+
+  status = pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+  if (status == 0) { status = pthread_mutex_init( &mutex->handle, &attributes ); }
+
+  (void)pthread_mutexattr_destroy( &attributes );
+  if (status != 0) { goto failed; }
+#endif
+
+  return mutex;
+
+#ifndef _WIN32
+failed:
+  free( mutex );
+  return NULL;
+#endif
+}}
+
+#define mutex_destroy PLAINMTP(mutex_destroy)
+void mutex_destroy( mutex_s* mutex ) {
+{
+#ifdef _WIN32
+  DeleteCriticalSection( &mutex->handle );
+#else
+  (void)pthread_mutex_destroy( &mutex->handle );
+#endif
+
+  free( mutex );
+}}
+
+#define mutex_lock PLAINMTP(mutex_lock)
+void mutex_lock( mutex_s* mutex ) {
+{
+#ifdef _WIN32
+  EnterCriticalSection( &mutex->handle );
+#else
+  (void)pthread_mutex_lock( &mutex->handle );
+#endif
+}}
+
+#define mutex_try_lock PLAINMTP(mutex_try_lock)
+plainmtp_bool mutex_try_lock( mutex_s* mutex ) {
+{
+#ifdef _WIN32
+  return (TryEnterCriticalSection( &mutex->handle ) != 0);
+#else
+  return (pthread_mutex_trylock( &mutex->handle ) == 0);
+#endif
+}}
+
+#define mutex_unlock PLAINMTP(mutex_unlock)
+void mutex_unlock( mutex_s* mutex ) {
+{
+#ifdef _WIN32
+  LeaveCriticalSection( &mutex->handle );
+#else
+  (void)pthread_mutex_unlock( &mutex->handle );
+#endif
+}}
+
+/**************************************************************************************************/
+
+#define condition_create PLAINMTP(condition_create)
+condition_s* condition_create(void) {
+  condition_s* condition;
+{
+  condition = malloc( sizeof(*condition) );
+  if (condition == NULL) { return NULL; }
+
+#ifdef _WIN32
+  InitializeConditionVariable( &condition->handle );
+#else
+  if (pthread_cond_init( &condition->handle, NULL ) != 0) {
+    free( condition );
+    return NULL;
+  }
+#endif
+
+  return condition;
+}}
+
+#define condition_destroy PLAINMTP(condition_destroy)
+void condition_destroy( condition_s* condition ) {
+{
+#ifndef _WIN32
+  (void)pthread_cond_destroy( &condition->handle );
+#endif
+
+  free( condition );
+}}
+
+#define condition_wait PLAINMTP(condition_wait)
+void condition_wait( condition_s* condition, mutex_s* mutex ) {
+{
+#ifdef _WIN32
+  (void)SleepConditionVariableCS( &condition->handle, &mutex->handle, INFINITE );
+#else
+  (void)pthread_cond_wait( &condition->handle, &mutex->handle );
+#endif
+}}
+
+#define condition_broadcast PLAINMTP(condition_broadcast)
+void condition_broadcast( condition_s* condition ) {
+{
+#ifdef _WIN32
+  WakeAllConditionVariable( &condition->handle );
+#else
+  (void)pthread_cond_broadcast( &condition->handle );
+#endif
+}}
+
+/**************************************************************************************************/
+
+#define CB_thread_entry ZZ_PLAINMTP(cb_thread_entry)
+#ifdef _WIN32
+PLAINMTP_INTERNAL DWORD WINAPI CB_thread_entry( LPVOID thread ) {
+#else
+PLAINMTP_INTERNAL void* CB_thread_entry( void* thread ) {
+#endif
+{
+  ((thread_s*)thread)->routine( ((thread_s*)thread)->argument );
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}}
+
+#define thread_start PLAINMTP(thread_start)
+thread_s* thread_start( thread_f routine, void* argument ) {
+  thread_s* thread;
+{
+  thread = malloc( sizeof(*thread) );
+  if (thread == NULL) { return NULL; }
+
+  thread->routine = routine;
+  thread->argument = argument;
+
+#ifdef _WIN32
+  thread->handle = CreateThread( NULL, 0, &CB_thread_entry, thread, 0, NULL );
+  if (thread->handle != NULL) { return thread; }
+#else
+  if (pthread_create( &thread->handle, NULL, &CB_thread_entry, thread ) == 0) { return thread; }
+#endif
+
+  free( thread );
+  return NULL;
+}}
+
+#define thread_join PLAINMTP(thread_join)
+void thread_join( thread_s* thread ) {
+{
+#ifdef _WIN32
+  (void)WaitForSingleObject( thread->handle, INFINITE );
+  (void)CloseHandle( thread->handle );
+#else
+  (void)pthread_join( thread->handle, NULL );
+#endif
+
+  free( thread );
+}}
+
+/**************************************************************************************************/
+
+#define thread_local_create PLAINMTP(thread_local_create)
+thread_local_s* thread_local_create(void) {
+  thread_local_s* variable;
+{
+  variable = malloc( sizeof(*variable) );
+  if (variable == NULL) { return NULL; }
+
+#ifdef _WIN32
+  variable->handle = TlsAlloc();
+  if (variable->handle != TLS_OUT_OF_INDEXES) { return variable; }
+#else
+  if (pthread_key_create( &variable->handle, NULL ) == 0) { return variable; }
+#endif
+
+  free( variable );
+  return NULL;
+}}
+
+#define thread_local_destroy PLAINMTP(thread_local_destroy)
+void thread_local_destroy( thread_local_s* variable ) {
+{
+#ifdef _WIN32
+  (void)TlsFree( variable->handle );
+#else
+  (void)pthread_key_delete( variable->handle );
+#endif
+
+  free( variable );
+}}
+
+#define thread_local_get PLAINMTP(thread_local_get)
+void* thread_local_get( thread_local_s* variable ) {
+{
+#ifdef _WIN32
+  return TlsGetValue( variable->handle );
+#else
+  return pthread_getspecific( variable->handle );
+#endif
+}}
+
+#define thread_local_set PLAINMTP(thread_local_set)
+plainmtp_bool thread_local_set( thread_local_s* variable, void* value ) {
+{
+#ifdef _WIN32
+  return (TlsSetValue( variable->handle, value ) != 0);
+#else
+  return (pthread_setspecific( variable->handle, value ) == 0);
+#endif
+}}
+
+#ifdef PP_PLAINMTP_THREADS_C_EX
+#include PP_PLAINMTP_THREADS_C_EX
+#endif
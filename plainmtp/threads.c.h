@@ -0,0 +1,40 @@
+#ifndef ZZ_PLAINMTP_THREADS_C_IG
+#define ZZ_PLAINMTP_THREADS_C_IG
+#include "common.i.h"
+
+/* NB: The mutex is recursive, so the same thread can lock it multiple times, e.g. when an API
+  function that locks the device is called from a data callback of another one. */
+typedef struct ZZ_PLAINMTP(mutex_s) mutex_s;
+
+PLAINMTP_EXTERN mutex_s* PLAINMTP(mutex_create(void));
+PLAINMTP_EXTERN void PLAINMTP(mutex_destroy( mutex_s* mutex ));
+PLAINMTP_EXTERN void PLAINMTP(mutex_lock( mutex_s* mutex ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(mutex_try_lock( mutex_s* mutex ));
+PLAINMTP_EXTERN void PLAINMTP(mutex_unlock( mutex_s* mutex ));
+
+/* NB: The mutex passed to the waiting function must be locked exactly once by the calling thread.
+  Spurious wakeups are possible, so the condition has to be checked again in a loop. */
+typedef struct ZZ_PLAINMTP(condition_s) condition_s;
+
+PLAINMTP_EXTERN condition_s* PLAINMTP(condition_create(void));
+PLAINMTP_EXTERN void PLAINMTP(condition_destroy( condition_s* condition ));
+PLAINMTP_EXTERN void PLAINMTP(condition_wait( condition_s* condition, mutex_s* mutex ));
+PLAINMTP_EXTERN void PLAINMTP(condition_broadcast( condition_s* condition ));
+
+typedef struct ZZ_PLAINMTP(thread_s) thread_s;
+typedef void (*thread_f) ( void* argument );
+
+PLAINMTP_EXTERN thread_s* PLAINMTP(thread_start( thread_f routine, void* argument ));
+PLAINMTP_EXTERN void PLAINMTP(thread_join( thread_s* thread ));
+
+/* A pointer that has its own value in every thread, which is NULL initially. */
+typedef struct ZZ_PLAINMTP(thread_local_s) thread_local_s;
+
+PLAINMTP_EXTERN thread_local_s* PLAINMTP(thread_local_create(void));
+PLAINMTP_EXTERN void PLAINMTP(thread_local_destroy( thread_local_s* variable ));
+PLAINMTP_EXTERN void* PLAINMTP(thread_local_get( thread_local_s* variable ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(thread_local_set( thread_local_s* variable, void* value ));
+
+#else
+#error ZZ_PLAINMTP_THREADS_C_IG
+#endif
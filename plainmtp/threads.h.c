@@ -0,0 +1,62 @@
+#include "threads.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <Windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+struct ZZ_PLAINMTP(mutex_s) {
+#ifdef _WIN32
+  CRITICAL_SECTION handle;  /* Always recursive. */
+#else
+  pthread_mutex_t handle;
+#endif
+};
+
+struct ZZ_PLAINMTP(condition_s) {
+#ifdef _WIN32
+  CONDITION_VARIABLE handle;
+#else
+  pthread_cond_t handle;
+#endif
+};
+
+struct ZZ_PLAINMTP(thread_s) {
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif
+
+  thread_f routine;
+  void* argument;
+};
+
+struct ZZ_PLAINMTP(thread_local_s) {
+#ifdef _WIN32
+  DWORD handle;
+#else
+  pthread_key_t handle;
+#endif
+};
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+#ifdef _WIN32
+PLAINMTP_EXTERN DWORD WINAPI ZZ_PLAINMTP(cb_thread_entry( LPVOID thread ));
+#else
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_thread_entry( void* thread ));
+#endif
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
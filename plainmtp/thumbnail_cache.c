@@ -0,0 +1,219 @@
+#include "thumbnail_cache.h.c"
+
+#include <stdlib.h>
+#include <wchar.h>
+#include <assert.h>
+
+#include "data_digest.c.h"
+#include "host_files.c.h"
+
+#define compose_cache_name ZZ_PLAINMTP(compose_cache_name)
+PLAINMTP_INTERNAL plainmtp_bool compose_cache_name( struct plainmtp_cursor_s* cursor,
+  wchar_t* OUT_name
+) {
+  static const wchar_t hex_digits[] = L"0123456789abcdef";
+  plainmtp_cursor_s* const image = (plainmtp_cursor_s*)cursor;
+  digest_state_s state;
+  plainmtp_digest_s key;
+  int datetime[6];
+  uint64_t size = image->size;
+  size_t i;
+{
+  if (image->datetime.tm_mday == 0) { return PLAINMTP_FALSE; }
+
+  /* NB: Other fields of 'struct tm' are derived ones, so they're not taken into account. */
+  datetime[0] = image->datetime.tm_year;
+  datetime[1] = image->datetime.tm_mon;
+  datetime[2] = image->datetime.tm_mday;
+  datetime[3] = image->datetime.tm_hour;
+  datetime[4] = image->datetime.tm_min;
+  datetime[5] = image->datetime.tm_sec;
+
+  PLAINMTP(digest_start( &state, PLAINMTP_DIGEST_SHA256 ));
+  PLAINMTP(digest_update( &state, image->id, (wcslen( image->id ) + 1) * sizeof(*image->id) ));
+  PLAINMTP(digest_update( &state, datetime, sizeof(datetime) ));
+  PLAINMTP(digest_update( &state, &size, sizeof(size) ));
+  PLAINMTP(digest_finish( &state, &key ));
+
+  for (i = 0; i < CACHE_NAME_LENGTH / 2; ++i) {
+    OUT_name[i*2] = hex_digits[key.value[i] >> 4];
+    OUT_name[i*2 + 1] = hex_digits[key.value[i] & 0x0F];
+  }
+
+  OUT_name[CACHE_NAME_LENGTH] = L'\0';
+  return PLAINMTP_TRUE;
+}}
+
+/* The name of the temporary file is composed after the name of the cache file, and is made unique
+  among the calls in progress by the address of their state. This way the threads that receive the
+  same thumbnail at once don't write into the same file. */
+#define compose_temporary_name ZZ_PLAINMTP(compose_temporary_name)
+PLAINMTP_INTERNAL void compose_temporary_name( const void* owner, wchar_t* OUT_name ) {
+  static const wchar_t hex_digits[] = L"0123456789abcdef";
+  uintptr_t value = (uintptr_t)owner;
+  size_t i;
+{
+  OUT_name[CACHE_NAME_LENGTH] = L'.';
+
+  for (i = CACHE_TAG_LENGTH - 1; i > 0; --i) {
+    OUT_name[CACHE_NAME_LENGTH + i] = hex_digits[value & 0x0F];
+    value >>= 4;
+  }
+
+  (void)wcscpy( &OUT_name[CACHE_NAME_LENGTH + CACHE_TAG_LENGTH], CACHE_TEMPORARY_SUFFIX );
+}}
+
+#define deliver_cached_file ZZ_PLAINMTP(deliver_cached_file)
+PLAINMTP_INTERNAL plainmtp_bool deliver_cached_file( FILE* file, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  void* buffer;
+  size_t bytes_read;
+  plainmtp_bool result = PLAINMTP_TRUE;
+{
+  if ( (chunk_limit == 0) || (chunk_limit > CACHE_CHUNK_SIZE) ) { chunk_limit = CACHE_CHUNK_SIZE; }
+
+  buffer = malloc( chunk_limit );
+  if (buffer == NULL) { return PLAINMTP_FALSE; }
+
+  while ( (bytes_read = fread( buffer, 1, chunk_limit, file )) != 0 ) {
+    if (callback( buffer, bytes_read, custom_state ) == NULL) {
+      result = PLAINMTP_FALSE;
+      break;
+    }
+  }
+
+  if (ferror( file )) { result = PLAINMTP_FALSE; }
+  (void)callback( NULL, 0, custom_state );
+
+  free( buffer );
+  return result;
+}}
+
+#define CB_thumbnail_exchange ZZ_PLAINMTP(cb_thumbnail_exchange)
+PLAINMTP_INTERNAL void* CB_thumbnail_exchange( void* data, size_t size, void* custom_state ) {
+  thumbnail_exchange_s* context = custom_state;
+{
+  /* The data is stored before the callback, since it may reuse the buffer in "active" mode. */
+  if ( (context->file != NULL) && (data != NULL) && (size != 0) ) {
+    if (fwrite( data, 1, size, context->file ) != size) {
+      (void)fclose( context->file );
+      context->file = NULL;
+    }
+  }
+
+  return context->callback( data, size, context->custom_state );
+}}
+
+/**************************************************************************************************/
+
+struct plainmtp_thumbnail_cache_s* plainmtp_thumbnail_cache_open( const wchar_t* directory ) {
+  struct plainmtp_thumbnail_cache_s* cache;
+  size_t length;
+{
+  assert( directory != NULL );
+
+  cache = malloc( sizeof(*cache) );
+  if (cache == NULL) { return NULL; }
+
+  length = wcslen( directory );
+
+  cache->directory = malloc( (length + 2) * sizeof(*cache->directory) );
+  if (cache->directory == NULL) {
+    free( cache );
+    return NULL;
+  }
+
+  (void)wmemcpy( cache->directory, directory, length );
+  if ( (length > 0) && (directory[length-1] != PATH_DELIMITER) ) {
+    cache->directory[length++] = PATH_DELIMITER;
+  }
+
+  cache->directory[length] = L'\0';
+  cache->length = length;
+
+  return cache;
+}}
+
+void plainmtp_thumbnail_cache_close( struct plainmtp_thumbnail_cache_s* cache ) {
+{
+  assert( cache != NULL );
+
+  free( cache->directory );
+  free( cache );
+}}
+
+plainmtp_bool plainmtp_cursor_receive_thumbnail_cached( struct plainmtp_cursor_s* cursor,
+  struct plainmtp_device_s* device, struct plainmtp_thumbnail_cache_s* cache, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state
+) {
+  thumbnail_exchange_s context;
+  plainmtp_bool result;
+  wchar_t *path, *temporary_path;
+  size_t path_size;
+  FILE* file;
+{
+  assert( cursor != NULL );
+  assert( device != NULL );
+  assert( callback != NULL );
+
+  if (cache == NULL) {
+    return plainmtp_cursor_receive_thumbnail( cursor, device, chunk_limit, callback,
+      custom_state );
+  }
+
+  /* Both paths are kept in the same memory block, and 'path' points to its beginning. */
+  path_size = cache->length + CACHE_NAME_LENGTH + CACHE_TAG_LENGTH
+    + sizeof(CACHE_TEMPORARY_SUFFIX) / sizeof(wchar_t);
+
+  path = malloc( path_size * 2 * sizeof(*path) );
+  if (path == NULL) { return PLAINMTP_FALSE; }
+
+  if (!compose_cache_name( cursor, &path[cache->length] )) {
+    free( path );
+    return plainmtp_cursor_receive_thumbnail( cursor, device, chunk_limit, callback,
+      custom_state );
+  }
+
+  (void)wmemcpy( path, cache->directory, cache->length );
+
+  file = PLAINMTP(open_host_file( path, PLAINMTP_FALSE ));
+  if (file != NULL) {
+    result = deliver_cached_file( file, chunk_limit, callback, custom_state );
+    (void)fclose( file );
+    goto quit;
+  }
+
+  /* The thumbnail is written into a temporary file first, so an incomplete one is never cached. */
+  temporary_path = &path[path_size];
+  (void)wmemcpy( temporary_path, path, cache->length + CACHE_NAME_LENGTH );
+  compose_temporary_name( &context, &temporary_path[cache->length] );
+
+  file = PLAINMTP(open_host_file( temporary_path, PLAINMTP_TRUE ));
+
+  context.callback = callback;
+  context.custom_state = custom_state;
+  context.file = file;
+
+  result = plainmtp_cursor_receive_thumbnail( cursor, device, chunk_limit,
+    &CB_thumbnail_exchange, &context );
+
+  /* NB: The file is already closed here if it couldn't be written. The renaming can also fail if
+    the same thumbnail has been cached meanwhile by another instance, which is fine as well. */
+  if (file != NULL) {
+    /* BEWARE: Short-circuit evaluation matters here! */
+    if ( !( (context.file != NULL) && (fclose( context.file ) == 0) && result
+      && PLAINMTP(rename_host_file( temporary_path, path )) )
+    ) {
+      PLAINMTP(remove_host_file( temporary_path ));
+    }
+  }
+
+quit:
+  free( path );
+  return result;
+}}
+
+#ifdef PP_PLAINMTP_THUMBNAIL_CACHE_C_EX
+#include PP_PLAINMTP_THUMBNAIL_CACHE_C_EX
+#endif
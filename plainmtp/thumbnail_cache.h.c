@@ -0,0 +1,56 @@
+#include "plainmtp.h"
+#include "common.i.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+#include <stdio.h>
+
+#ifdef _WIN32
+  #define PATH_DELIMITER L'\\'
+#else
+  #define PATH_DELIMITER L'/'
+#endif
+
+/* Names of the cache files are hexadecimal digits of the first 16 bytes of the SHA-256 key hash. */
+#define CACHE_NAME_LENGTH (16 * 2)
+#define CACHE_TEMPORARY_SUFFIX L".tmp"
+
+/* Temporary files also have the hexadecimal digits of an address in their names, with a dot. */
+#define CACHE_TAG_LENGTH (sizeof(uintptr_t) * 2 + 1)
+
+/* Thumbnails are usually well below this size, so they are delivered at once. */
+#define CACHE_CHUNK_SIZE (64 * 1024)
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+struct plainmtp_thumbnail_cache_s {
+  /* Path to the cache directory with the delimiter. Paths to the files are composed on demand, so
+    the cache can be used by several threads at once. */
+  wchar_t* directory;
+  size_t length;
+};
+
+typedef struct ZZ_PLAINMTP(thumbnail_exchange_s) {
+  plainmtp_data_f callback;
+  void* custom_state;
+
+  /* If NULL, the thumbnail is not being stored in the cache. */
+  FILE* file;
+} thumbnail_exchange_s;
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(compose_cache_name( struct plainmtp_cursor_s* cursor,
+  wchar_t* OUT_name ));
+PLAINMTP_EXTERN void ZZ_PLAINMTP(compose_temporary_name( const void* owner, wchar_t* OUT_name ));
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(deliver_cached_file( FILE* file, size_t chunk_limit,
+  plainmtp_data_f callback, void* custom_state ));
+PLAINMTP_EXTERN void* ZZ_PLAINMTP(cb_thumbnail_exchange( void* data, size_t size,
+  void* custom_state ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
@@ -1,95 +1,193 @@
-#include "utf8_wchar.c.h"
+#include "utf8_wchar.h.c"
 
 #include <stdlib.h>
+#include <string.h>
 
-#define utf8_strlen PLAINMTP(utf8_strlen)
-size_t utf8_strlen( const char* utf8_string ) {
-  size_t result = 0;
+#define is_ascii_block ZZ_PLAINMTP(is_ascii_block)
+PLAINMTP_INTERNAL plainmtp_bool is_ascii_block( const char* units ) {
+#if !defined(ASCII_BLOCK_SSE2) && !defined(ASCII_BLOCK_NEON)
+  size_t word;
+#endif
 {
-  for (;;) {
-    const char unit = *utf8_string;
-
-    if ('\0' == unit) {
-      return result;
-    } else if ( (0xF8 & unit) == 0xF0 ) {
-      utf8_string += 4;
-    } else if ( (0xF0 & unit) == 0xE0 ) {
-      utf8_string += 3;
-    } else if ( (0xE0 & unit) == 0xC0 ) {
-      utf8_string += 2;
-    } else {
-      utf8_string += 1;
+#if defined(ASCII_BLOCK_SSE2)
+  return _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)units ) ) == 0;
+#elif defined(ASCII_BLOCK_NEON)
+  return vmaxvq_u8( vld1q_u8( (const uint8_t*)units ) ) < 0x80;
+#else
+  /* NB: memcpy() is the only portable way to read a word at an arbitrary address. */
+  memcpy( &word, units, sizeof(word) );
+  return (word & ((size_t)-1 / 0xFF * 0x80)) == 0;
+#endif
+}}
+
+/* Malformed sequences are substituted by U+FFFD, one per the maximal subpart of a valid sequence,
+  as recommended by the Unicode Standard. Surrogates and overlong forms are malformed as well. The
+  terminator is never a part of a sequence, so this never reads past the end of the string. */
+#define read_utf8_codepoint PLAINMTP(read_utf8_codepoint)
+unsigned long read_utf8_codepoint( const char** utf8_string ) {
+  const unsigned char* const units = (const unsigned char*)*utf8_string;
+  unsigned long codepoint;
+  unsigned char lower = 0x80, upper = 0xBF;
+  size_t count, i;
+{
+  if (units[0] < 0x80) {
+    *utf8_string += 1;
+    return units[0];
+  }
+
+  if ( (units[0] >= 0xC2) && (units[0] <= 0xDF) ) {
+    count = 1;
+    codepoint = 0x1F & units[0];
+  } else if ( (0xF0 & units[0]) == 0xE0 ) {
+    count = 2;
+    codepoint = 0x0F & units[0];
+    if (units[0] == 0xE0) { lower = 0xA0; } else if (units[0] == 0xED) { upper = 0x9F; }
+  } else if ( (units[0] >= 0xF0) && (units[0] <= 0xF4) ) {
+    count = 3;
+    codepoint = 0x07 & units[0];
+    if (units[0] == 0xF0) { lower = 0x90; } else if (units[0] == 0xF4) { upper = 0x8F; }
+  } else {
+    *utf8_string += 1;
+    return UTF8_REPLACEMENT_CODEPOINT;
+  }
+
+  for (i = 1; i <= count; ++i) {
+    if ( (units[i] < lower) || (units[i] > upper) ) {
+      *utf8_string += i;
+      return UTF8_REPLACEMENT_CODEPOINT;
     }
 
-    ++result;
+    codepoint = (codepoint << 6) | (0x3F & units[i]);
+    lower = 0x80;
+    upper = 0xBF;
   }
+
+  *utf8_string += count + 1;
+  return codepoint;
 }}
 
 #define make_wide_string_from_utf8 PLAINMTP(make_wide_string_from_utf8)
 wchar_t* make_wide_string_from_utf8( const char* utf8_string, size_t* OUT_length ) {
-  wchar_t* result;
+  const size_t size = strlen( utf8_string );
+  const char* const end = utf8_string + size;
+  wchar_t *result, *shrunk;
   unsigned long codepoint;
-  size_t length, i;
+  size_t length = 0, i;
 {
-  /*if (utf8_string == NULL) { return NULL; }*/
-
-  length = utf8_strlen( utf8_string );
-  if (OUT_length != NULL) { *OUT_length = length; }
-
-  result = malloc( (length+1) * sizeof(*result) );
+  /* No character takes less bytes in UTF-8 than the units it takes in the wide string (even if
+    it's a surrogate pair), so the number of bytes is enough. */
+  result = malloc( (size+1) * sizeof(*result) );
   if (result == NULL) { return NULL; }
 
-  for (i = 0; i < length; ++i) {
-    if ( (0xF8 & utf8_string[0]) == 0xF0 ) {
-      codepoint = (0x07 & utf8_string[0]) << 18
-                | (0x3F & utf8_string[1]) << 12
-                | (0x3F & utf8_string[2]) << 6
-                | (0x3F & utf8_string[3]);
-      utf8_string += 4;
-
-    } else if ( (0xF0 & utf8_string[0]) == 0xE0 ) {
-      codepoint = (0x0F & utf8_string[0]) << 12
-                | (0x3F & utf8_string[1]) << 6
-                | (0x3F & utf8_string[2]);
-      utf8_string += 3;
-
-    } else if ( (0xE0 & utf8_string[0]) == 0xC0 ) {
-      codepoint = (0x1F & utf8_string[0]) << 6
-                | (0x3F & utf8_string[1]);
-      utf8_string += 2;
+  while (utf8_string != end) {
+    /* Runs of ASCII characters are the most common in file names. */
+    while ( ((size_t)(end - utf8_string) >= ASCII_BLOCK_SIZE) && is_ascii_block( utf8_string ) ) {
+      for (i = 0; i < ASCII_BLOCK_SIZE; ++i) { result[length+i] = (wchar_t)utf8_string[i]; }
+      length += ASCII_BLOCK_SIZE;
+      utf8_string += ASCII_BLOCK_SIZE;
+    }
 
-    } else {
-      codepoint = utf8_string[0];
-      utf8_string += 1;
+    if (utf8_string == end) { break; }
+    codepoint = read_utf8_codepoint( &utf8_string );
+
+#if (WCHAR_MAX <= 0xFFFF)
+    if (codepoint > 0xFFFF) {
+      codepoint -= 0x10000;
+      result[length++] = (wchar_t)( 0xD800 | (codepoint >> 10) );
+      codepoint = 0xDC00 | (0x3FF & codepoint);
     }
+#endif
 
-    /* NB: Range of wchar_t is implementation-defined; this is possibly a narrowing conversion. */
-    result[i] = (wchar_t)codepoint;
+    result[length++] = (wchar_t)codepoint;
   }
 
   result[length] = L'\0';
+  if (OUT_length != NULL) { *OUT_length = length; }
+
+  if (length < size) {
+    /* Try to reduce memory usage. */
+    shrunk = realloc( result, (length+1) * sizeof(*result) );
+    if (shrunk != NULL) { result = shrunk; }
+  }
+
   return result;
 }}
 
-/* TODO: This implementation is locale-dependent, should we do anything about it? */
-#define make_multibyte_string PLAINMTP(make_multibyte_string)
-char* make_multibyte_string( const wchar_t* source ) {
-  char* result;
-  size_t length;
-  mbstate_t state = {0};
+#define compare_utf8_with_wide PLAINMTP(compare_utf8_with_wide)
+int compare_utf8_with_wide( const char* utf8_string, const wchar_t* wide_string, size_t length ) {
+  unsigned long codepoint;
+  size_t i;
 {
-  length = wcsrtombs( NULL, &source, 0, &state );
-  if (length == (size_t)-1) { return NULL; }
+  for (i = 0; i < length; ++i) {
+    if (*utf8_string == '\0') { return -1; }
+
+    /* NB: The characters beyond the BMP aren't split into surrogate pairs here, since the names
+      are provided in UTF-8 only on the platforms where wchar_t is wide enough for them. */
+    codepoint = (unsigned long)(wchar_t)read_utf8_codepoint( &utf8_string );
+    if (codepoint != (unsigned long)wide_string[i]) {
+      return (codepoint < (unsigned long)wide_string[i]) ? -1 : 1;
+    }
+  }
+
+  return (*utf8_string == '\0') ? 0 : 1;
+}}
 
-  ++length;
-  result = malloc( length );
+/* NB: This doesn't depend on the locale, unlike wcsrtombs(). Unpaired surrogates and the values
+  beyond the Unicode range can't be encoded, so they are treated as an error, like there. */
+#define make_utf8_string PLAINMTP(make_utf8_string)
+char* make_utf8_string( const wchar_t* source ) {
+  const size_t length = wcslen( source );
+  char* result;
+  unsigned long codepoint;
+  size_t size = 0, i;
+{
+  /* No character takes more than 3 bytes per unit of the wide string, except the ones beyond the
+    BMP, which take 4 bytes, but these are surrogate pairs if wchar_t is 16-bit. The result is
+    never kept for long by the callers, so it's not worth shrinking afterwards. */
+#if (WCHAR_MAX <= 0xFFFF)
+  result = malloc( length*3 + 1 );
+#else
+  result = malloc( length*4 + 1 );
+#endif
   if (result == NULL) { return NULL; }
 
-  length = wcsrtombs( result, &source, length, &state );
-  if (length != (size_t)-1) { return result; }
+  for (i = 0; i < length; ++i) {
+    codepoint = (unsigned long)source[i];
 
-  free( result );
-  return NULL;
+    if (codepoint < 0x80) {
+      result[size++] = (char)codepoint;
+      continue;
+    }
+
+#if (WCHAR_MAX <= 0xFFFF)
+    if ( (codepoint >= 0xD800) && (codepoint <= 0xDBFF)
+      && ((unsigned long)source[i+1] >= 0xDC00) && ((unsigned long)source[i+1] <= 0xDFFF)
+    ) {
+      codepoint = 0x10000 + ( (0x3FF & codepoint) << 10 | (0x3FF & (unsigned long)source[++i]) );
+    }
+#endif
+
+    if ( ( (codepoint >= 0xD800) && (codepoint <= 0xDFFF) ) || (codepoint > 0x10FFFF) ) {
+      free( result );
+      return NULL;
+    }
+
+    if (codepoint < 0x800) {
+      result[size++] = (char)( 0xC0 | (codepoint >> 6) );
+    } else if (codepoint < 0x10000) {
+      result[size++] = (char)( 0xE0 | (codepoint >> 12) );
+      result[size++] = (char)( 0x80 | (0x3F & (codepoint >> 6)) );
+    } else {
+      result[size++] = (char)( 0xF0 | (codepoint >> 18) );
+      result[size++] = (char)( 0x80 | (0x3F & (codepoint >> 12)) );
+      result[size++] = (char)( 0x80 | (0x3F & (codepoint >> 6)) );
+    }
+
+    result[size++] = (char)( 0x80 | (0x3F & codepoint) );
+  }
+
+  result[size] = '\0';
+  return result;
 }}
 
 #ifdef PP_PLAINMTP_UTF8_WCHAR_C_EX
@@ -4,10 +4,15 @@
 
 #include <wchar.h>
 
-PLAINMTP_EXTERN size_t PLAINMTP(utf8_strlen( const char* utf8_string ));
+PLAINMTP_EXTERN unsigned long PLAINMTP(read_utf8_codepoint( const char** utf8_string ));
 PLAINMTP_EXTERN wchar_t* PLAINMTP(make_wide_string_from_utf8( const char* utf8_string,
   size_t* OUT_length ));
-PLAINMTP_EXTERN char* PLAINMTP(make_multibyte_string( const wchar_t* source ));
+PLAINMTP_EXTERN char* PLAINMTP(make_utf8_string( const wchar_t* source ));
+
+/* Compares the strings by code points, like wcsncmp() does, but the wide one is not terminated and
+  has exactly 'length' characters, so the UTF-8 one must be exactly as long to be equal. */
+PLAINMTP_EXTERN int PLAINMTP(compare_utf8_with_wide( const char* utf8_string,
+  const wchar_t* wide_string, size_t length ));
 
 #else
 #error ZZ_PLAINMTP_UTF8_WCHAR_C_IG
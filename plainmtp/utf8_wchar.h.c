@@ -0,0 +1,33 @@
+#include "utf8_wchar.c.h"
+
+/**************************************************************************************************/
+#ifndef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+
+/* Runs of ASCII characters are checked by blocks of this size, using SIMD instructions if they're
+  available for sure, or machine words otherwise. */
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && (_M_IX86_FP >= 2) )
+  #include <emmintrin.h>
+  #define ASCII_BLOCK_SSE2
+  #define ASCII_BLOCK_SIZE 16
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+  #define ASCII_BLOCK_NEON
+  #define ASCII_BLOCK_SIZE 16
+#else
+  #define ASCII_BLOCK_SIZE sizeof(size_t)
+#endif
+
+/* Substitutes the malformed sequences. */
+#define UTF8_REPLACEMENT_CODEPOINT 0xFFFDUL
+
+#else
+#undef PP_PLAINMTP_CONFLICTING_DIRECTIVES
+#endif
+/**************************************************************************************************/
+
+/**************************************************************************************************/
+#ifndef CC_PLAINMTP_NO_INTERNAL_API
+
+PLAINMTP_EXTERN plainmtp_bool ZZ_PLAINMTP(is_ascii_block( const char* units ));
+
+#endif /* CC_PLAINMTP_NO_INTERNAL_API */
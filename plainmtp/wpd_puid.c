@@ -1,84 +1,181 @@
 #include "wpd_puid.h.c"
 
 #include <stdlib.h>
+#include <string.h>
 
 #define wpd_root_persistent_id PLAINMTP(wpd_root_persistent_id)
 const wchar_t wpd_root_persistent_id[] = L"DEVICE";
 
-/* NB: We assume 'unsigned int' here because pstdint.h doesn't provide PRINTF_INT8_MODIFIER. */
-#define wpd_guid_format_string ZZ_PLAINMTP(wpd_guid_format_string)
-PLAINMTP_INTERNAL const wchar_t wpd_guid_format_string[] =
-  L"{%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X}";
+#define wpd_hex_digits ZZ_PLAINMTP(wpd_hex_digits)
+PLAINMTP_INTERNAL const char wpd_hex_digits[] = "0123456789ABCDEF";
+
+/* NB: Only ASCII characters may be digits, so the table doesn't cover the rest. */
+#define wpd_hex_digit_values ZZ_PLAINMTP(wpd_hex_digit_values)
+PLAINMTP_INTERNAL const unsigned char wpd_hex_digit_values[0x80] = {
+# define I WPD_HEX_DIGIT_INVALID
+  I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I,
+  I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I, 0,1,2,3,4,5,6,7, 8,9,I,I,I,I,I,I,
+  I,10,11,12,13,14,15,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I,
+  I,10,11,12,13,14,15,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I, I,I,I,I,I,I,I,I
+# undef I
+};
+
+#define read_wpd_hex_digit ZZ_PLAINMTP(read_wpd_hex_digit)
+PLAINMTP_INTERNAL unsigned int read_wpd_hex_digit( wchar_t digit ) {
+{
+  /* NB: The terminator isn't a digit, so the callers never read past the end of the string. */
+  return ( (unsigned long)digit < 0x80 ) ? wpd_hex_digit_values[digit] : WPD_HEX_DIGIT_INVALID;
+}}
+
+/* The digits are written backwards, right before the end of the buffer, without a terminator. */
+#define format_wpd_number ZZ_PLAINMTP(format_wpd_number)
+PLAINMTP_INTERNAL const char* format_wpd_number( char* buffer_end, uint64_t value,
+  unsigned int base
+) {
+{
+  do {
+    *--buffer_end = wpd_hex_digits[value % base];
+    value /= base;
+  } while (value != 0);
+
+  return buffer_end;
+}}
+
+#define copy_wpd_narrow_string ZZ_PLAINMTP(copy_wpd_narrow_string)
+PLAINMTP_INTERNAL wchar_t* copy_wpd_narrow_string( wchar_t* result, const char* source,
+  size_t length
+) {
+  size_t i;
+{
+  for (i = 0; i < length; ++i) { result[i] = (wchar_t)source[i]; }
+  return result + length;
+}}
+
+/**************************************************************************************************/
 
 #define make_wpd_storage_unique_id PLAINMTP(make_wpd_storage_unique_id)
 wchar_t* make_wpd_storage_unique_id( uint32_t storage_id, uint64_t capacity,
   const wchar_t* volume_string, size_t volume_string_length
 ) {
-  wchar_t *buffer, *result;
-  int length;
-
-  /* Unfortunately, swprintf() does not allow to calculate the required size of the buffer that is
-    allocated to store the result, like C99 snprintf() does, so we had to use the maximum possible.
-    https://stackoverflow.com/questions/67510981/why-the-different-behavior-of-snprintf-vs-swprintf
-    https://stackoverflow.com/questions/3693479/why-does-c-not-have-an-snwprintf-function */
-  size_t length_limit
-    = 8  /* Number of identifier syntax characters ('SID-{,,}'). */
-    + 8  /* Length of the UINT32_MAX value hexadecimal representation ('FFFFFFFF'). */
-    + 20  /* Length of the UINT64_MAX value decimal representation ('18446744073709551615'). */
-    + 1;  /* For the resulting null-terminator. */
+  /* The buffers fit the UINT32_MAX value in hexadecimal ('FFFFFFFF') and the UINT64_MAX value in
+    decimal ('18446744073709551615'), respectively. */
+  char storage_digits[8], capacity_digits[20];
+  const char *storage_string, *capacity_string;
+  size_t storage_length, capacity_length;
+  wchar_t *result, *position;
 {
   if (volume_string == NULL) {
-    volume_string = L"";
-  } else {
-    /* 254 is the maximum length of PTP/MTP protocol strings (excluding the null-terminator). */
-    length_limit += (volume_string_length > 0) ? volume_string_length : 254;
+    volume_string_length = 0;
+  } else if (volume_string_length == 0) {
+    volume_string_length = wcslen( volume_string );
   }
 
-  buffer = malloc( length_limit * sizeof(*buffer) );
-  if (buffer == NULL) { return NULL; }
+  storage_string = format_wpd_number( storage_digits + sizeof(storage_digits), storage_id, 16 );
+  storage_length = storage_digits + sizeof(storage_digits) - storage_string;
+
+  capacity_string = format_wpd_number( capacity_digits + sizeof(capacity_digits), capacity, 10 );
+  capacity_length = capacity_digits + sizeof(capacity_digits) - capacity_string;
 
-  length = swprintf( buffer, length_limit,
-    WPD_STORAGE_ID_FORMAT_PREFIX L"%ls,%"WPRINTF_INT64_MODIFIER L"u}",
-    storage_id, volume_string, capacity );
+  /* The size is known exactly, so there's nothing to reduce afterwards. */
+  result = malloc( ( sizeof(WPD_STORAGE_ID_PREFIX) + storage_length + volume_string_length
+    + capacity_length + 3 ) * sizeof(*result) );
+  if (result == NULL) { return NULL; }
 
-  if (length > 0) {
-    /* Try to reduce memory usage. */
-    result = realloc( buffer, (length+1) * sizeof(*buffer) );
-    return (result != NULL) ? result : buffer;
+  position = copy_wpd_narrow_string( result, WPD_STORAGE_ID_PREFIX,
+    sizeof(WPD_STORAGE_ID_PREFIX) - 1 );
+  position = copy_wpd_narrow_string( position, storage_string, storage_length );
+  *position++ = L',';
+
+  if (volume_string_length > 0) {
+    position = wmemcpy( position, volume_string, volume_string_length ) + volume_string_length;
   }
 
-  free( buffer );
-  return NULL;
+  *position++ = L',';
+  position = copy_wpd_narrow_string( position, capacity_string, capacity_length );
+  *position++ = L'}';
+  *position = L'\0';
+
+  return result;
 }}
 
 #define parse_wpd_storage_unique_id PLAINMTP(parse_wpd_storage_unique_id)
 plainmtp_bool parse_wpd_storage_unique_id( const wchar_t* source, uint32_t* OUT_storage_id ) {
+  uint32_t storage_id = 0;
+  unsigned int digit;
+  size_t i;
 {
-  return ( swscanf( source, WPD_STORAGE_ID_FORMAT_PREFIX, OUT_storage_id ) == 1 );
+  for (i = 0; i < sizeof(WPD_STORAGE_ID_PREFIX) - 1; ++i) {
+    if (source[i] != (wchar_t)WPD_STORAGE_ID_PREFIX[i]) { return PLAINMTP_FALSE; }
+  }
+
+  source += i;
+
+  for (i = 0; i < 8; ++i) {
+    digit = read_wpd_hex_digit( source[i] );
+    if (digit == WPD_HEX_DIGIT_INVALID) { break; }
+    storage_id = (storage_id << 4) | digit;
+  }
+
+  if ( (i == 0) || (source[i] != L',') ) { return PLAINMTP_FALSE; }
+
+  *OUT_storage_id = storage_id;
+  return PLAINMTP_TRUE;
 }}
 
+/* NB: Anything after the closing brace is ignored, the same way as swscanf() used to do here. */
 #define read_wpd_plain_guid PLAINMTP(read_wpd_plain_guid)
 plainmtp_bool read_wpd_plain_guid( wpd_guid_plain_i result, const wchar_t* source ) {
-  int filled;
-  unsigned int values[WPD_GUID_FORMAT_COUNT];
+  unsigned int digit, nibble = 0;
+  size_t i;
 {
-# define X(i) &values[i]
-  filled = swscanf( source, wpd_guid_format_string, WPD_GUID_FORMAT_LIST );
-# undef X
-  if (filled != WPD_GUID_FORMAT_COUNT) { return PLAINMTP_FALSE; }
-
-# define X(i) result[i] = (uint8_t)values[i]
-  (WPD_GUID_FORMAT_LIST);
-# undef X
+  for (i = 0; i < sizeof(WPD_GUID_PATTERN) - 1; ++i) {
+    if (WPD_GUID_PATTERN[i] != 'x') {
+      if (source[i] != (wchar_t)WPD_GUID_PATTERN[i]) { return PLAINMTP_FALSE; }
+      continue;
+    }
+
+    digit = read_wpd_hex_digit( source[i] );
+    if (digit == WPD_HEX_DIGIT_INVALID) { return PLAINMTP_FALSE; }
+
+    if (nibble % 2 == 0) {
+      result[nibble / 2] = (uint8_t)(digit << 4);
+    } else {
+      result[nibble / 2] |= (uint8_t)digit;
+    }
+
+    ++nibble;
+  }
+
   return PLAINMTP_TRUE;
 }}
 
 #define write_wpd_plain_guid PLAINMTP(write_wpd_plain_guid)
 void write_wpd_plain_guid( const wpd_guid_plain_i source, wchar_t* result ) {
+  unsigned int nibble = 0, shift;
+  size_t i;
+{
+  /* NB: The pattern includes the terminator. */
+  for (i = 0; i < sizeof(WPD_GUID_PATTERN); ++i) {
+    if (WPD_GUID_PATTERN[i] != 'x') {
+      result[i] = (wchar_t)WPD_GUID_PATTERN[i];
+      continue;
+    }
+
+    shift = (nibble % 2 == 0) ? 4 : 0;
+    result[i] = (wchar_t)wpd_hex_digits[ 0xF & (source[nibble / 2] >> shift) ];
+    ++nibble;
+  }
+}}
+
+#define is_nil_wpd_plain_guid PLAINMTP(is_nil_wpd_plain_guid)
+plainmtp_bool is_nil_wpd_plain_guid( const wpd_guid_plain_i source ) {
+  size_t i;
 {
-# define X(i) (unsigned int)(source[i])
-  (void)swprintf( result, WPD_GUID_STRING_SIZE, wpd_guid_format_string, WPD_GUID_FORMAT_LIST );
-# undef X
+  for (i = 0; i < sizeof(wpd_guid_plain_i); ++i) {
+    if (source[i] != 0) { return PLAINMTP_FALSE; }
+  }
+
+  return PLAINMTP_TRUE;
 }}
 
 /*
@@ -111,21 +208,32 @@ void write_wpd_plain_guid( const wpd_guid_plain_i source, wchar_t* result ) {
     );
 
   NB: In PTP, object size is only 32-bit wide, not 64-bit, so it's applicable here.
+
+  The name is folded separately by fold_wpd_object_name(), so the caller may fold it right from the
+  encoding it has the name in.
 */
 
-#define get_wpd_fallback_object_id PLAINMTP(get_wpd_fallback_object_id)
-void get_wpd_fallback_object_id( wpd_guid_plain_i result, const wchar_t* name, uint32_t handle,
-  uint32_t parent, uint32_t storage, uint32_t size
-) {
-  uint16_t units[8] = {0};
+#define fold_wpd_object_name PLAINMTP(fold_wpd_object_name)
+void fold_wpd_object_name( uint16_t name_units[8], const wchar_t* name ) {
   size_t i = 0;
 {
-  /* First, do all the arithmetic, because byte order doesn't affect the result here. */
+  memset( name_units, 0, 8 * sizeof(*name_units) );
 
   if (name != NULL) while (name[i] != L'\0') {
-    units[i % 8] ^= (uint16_t)name[i];
+    name_units[i % 8] ^= (uint16_t)name[i];
     ++i;
   }
+}}
+
+#define get_wpd_fallback_object_id PLAINMTP(get_wpd_fallback_object_id)
+void get_wpd_fallback_object_id( wpd_guid_plain_i result, const uint16_t name_units[8],
+  uint32_t handle, uint32_t parent, uint32_t storage, uint32_t size
+) {
+  uint16_t units[8];
+{
+  /* First, do all the arithmetic, because byte order doesn't affect the result here. */
+
+  memcpy( units, name_units, sizeof(units) );
 
   units[0] ^= (uint16_t) handle;
   units[1] ^= (uint16_t)(handle >> 16);
@@ -26,9 +26,12 @@ PLAINMTP_EXTERN plainmtp_bool PLAINMTP(read_wpd_plain_guid( wpd_guid_plain_i res
   const wchar_t* source ));
 PLAINMTP_EXTERN void PLAINMTP(write_wpd_plain_guid( const wpd_guid_plain_i source,
   wchar_t* result ));
+PLAINMTP_EXTERN plainmtp_bool PLAINMTP(is_nil_wpd_plain_guid( const wpd_guid_plain_i source ));
 
+PLAINMTP_EXTERN void PLAINMTP(fold_wpd_object_name( uint16_t name_units[8], const wchar_t* name ));
 PLAINMTP_EXTERN void PLAINMTP(get_wpd_fallback_object_id( wpd_guid_plain_i result,
-  const wchar_t* name, uint32_t handle, uint32_t parent, uint32_t storage, uint32_t size ));
+  const uint16_t name_units[8], uint32_t handle, uint32_t parent, uint32_t storage,
+  uint32_t size ));
 
 #else
 #error ZZ_PLAINMTP_WPD_PUID_C_IG